@@ -7,15 +7,47 @@ in vec4 vertexColor; // Now interpolated across face
 in vec4 interPos;
 in vec3 interNormal;
 
+#ifdef USE_MATERIALS
+// Per-draw material (batched draws only; see MaterialGL.hpp)
+in vec2 interUV;
+in vec3 interTangent;
+flat in int materialIndex;
+
+struct Material
+{
+	vec4 baseColor;
+	float metallic;		// Negative = use MaterialBlock
+	float roughness;
+	int albedoLayer;	// Negative = no texture
+	int normalLayer;
+};
+
+layout(std430, binding=8) readonly buffer MaterialBuffer
+{
+	Material materials[];
+};
+
+layout(binding=0) uniform sampler2DArray albedoTextures;
+layout(binding=1) uniform sampler2DArray normalTextures;
+#endif
+
 struct PointLight
 {
 	vec4 pos;
 	vec4 color;
 };
 
-uniform PointLight light;
-uniform float metallic;
-uniform float roughness;
+// Updated once per frame (UniformRingGL)
+layout(std140, binding=1) uniform LightBlock
+{
+	PointLight light;	// View space
+};
+
+layout(std140, binding=2) uniform MaterialBlock
+{
+	float metallic;
+	float roughness;
+};
 #define PI 3.14159265359
 
 vec3 getFresnelAtAngleZero(vec3 albedo, float metallic)
@@ -74,18 +106,39 @@ void main()
 	out_color = vec4(vec3(diffColor + specularColor ), 1.0);
 	*/
 	vec3 N = vec3(normalize(interNormal));
+	vec3 albedo = vec3(vertexColor);
+	float matMetallic = metallic;
+	float matRoughness = roughness;
+#ifdef USE_MATERIALS
+	Material mat = materials[materialIndex];
+	if (mat.albedoLayer >= 0)
+		albedo = texture(albedoTextures, vec3(interUV, mat.albedoLayer)).rgb;
+	albedo *= mat.baseColor.rgb;
+	if (mat.metallic >= 0.0) matMetallic = mat.metallic;
+	if (mat.roughness >= 0.0) matRoughness = mat.roughness;
+	if (mat.normalLayer >= 0)
+	{
+		// BC5: only xy is stored
+		vec3 texN;
+		texN.xy = texture(normalTextures, vec3(interUV, mat.normalLayer)).rg * 2.0 - 1.0;
+		texN.z = sqrt(max(0.0, 1.0 - dot(texN.xy, texN.xy)));
+		vec3 T = normalize(interTangent - dot(interTangent, N) * N);
+		vec3 B = cross(N, T);
+		N = normalize(mat3(T, B, N) * texN);
+	}
+#endif
 	vec3 L = normalize(vec3(light.pos-interPos));
 	vec3 V = normalize(-1 * vec3(interPos));
-	vec3 F0 = getFresnelAtAngleZero(vec3(vertexColor), metallic);
+	vec3 F0 = getFresnelAtAngleZero(albedo, matMetallic);
 	vec3 H = normalize(V+L);
 	vec3 F = getFresnel(F0, L, H);
 	vec3 kS = F;
 		vec3 kD = 1.0 - kS;
-		kD *= (1.0 - metallic);
-		kD *= vec3(vertexColor);
+		kD *= (1.0 - matMetallic);
+		kD *= albedo;
 		kD = kD / PI;
-	float NDF = getNDF(H, N, roughness);
-	float G = getGF(L, V, N, roughness);
+	float NDF = getNDF(H, N, matRoughness);
+	float G = getGF(L, V, N, matRoughness);
 	kS = kS * NDF * G;
 	kS = kS / ((4.0 * max(0, dot(N, L)) * max(0, dot(N, V))) + 0.0001);
 	vec3 finalColor = (kD + kS) * vec3(light.color) * max(0, dot(N,L));
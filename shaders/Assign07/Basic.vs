@@ -6,10 +6,15 @@ layout(location=1) in vec4 color;
 layout(location=2) in vec3 normal;
 
 uniform mat4 modelMat;
-uniform mat4 viewMat;
-uniform mat4 projMat;
 uniform mat3 normMat;
 
+// Updated once per frame (UniformRingGL)
+layout(std140, binding=0) uniform CameraBlock
+{
+	mat4 viewMat;
+	mat4 projMat;
+};
+
 out vec4 vertexColor;
 out vec4 interPos;
 out vec3 interNormal;
@@ -0,0 +1,54 @@
+#version 430 core
+// Change to 410 for macOS (no SSBOs or multi-draw indirect there, though)
+
+layout(location=0) in vec3 position;
+layout(location=1) in vec4 color;
+layout(location=2) in vec3 normal;
+layout(location=3) in vec2 texcoord;
+layout(location=4) in vec3 tangent;
+layout(location=5) in uint drawID;
+
+struct DrawData
+{
+	mat4 modelMat;
+	mat4 normalMat;
+	ivec4 material;		// x = index into MaterialBuffer (Basic.fs)
+};
+
+layout(std430, binding=0) readonly buffer DrawBuffer
+{
+	DrawData draws[];
+};
+
+// Updated once per frame (UniformRingGL)
+layout(std140, binding=0) uniform CameraBlock
+{
+	mat4 viewMat;
+	mat4 projMat;
+};
+
+out vec4 vertexColor;
+out vec4 interPos;
+out vec3 interNormal;
+out vec2 interUV;
+out vec3 interTangent;
+flat out int materialIndex;
+
+void main()
+{
+	// Per-draw matrices come from the SSBO instead of uniforms
+	mat4 modelMat = draws[drawID].modelMat;
+	mat3 normMat = mat3(draws[drawID].normalMat);
+
+	interPos = viewMat * modelMat * vec4(position, 1.0);
+	gl_Position = projMat * interPos;
+	interNormal = normMat * normal;
+
+	// normalMat has no dequantization scale, so it also works for tangents
+	interUV = texcoord;
+	interTangent = normMat * tangent;
+	materialIndex = draws[drawID].material.x;
+
+	// Output per-vertex color
+	vertexColor = color;
+}
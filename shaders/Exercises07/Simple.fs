@@ -27,10 +27,10 @@ void main()
     T = normalize(T - dot(T,N) * N);
     vec3 B = normalize(cross(N, T));
 
-    vec3 texN = vec3(texture(normalTexture, interUV));
-    texN.x = (texN.x - 0.5) * 2.0;
-    texN.y = (texN.y - 0.5) * 2.0;
-    texN = normalize(texN);
+    // Only RG is stored (BC5), so rebuild z from the unit length
+    vec3 texN;
+    texN.xy = texture(normalTexture, interUV).rg * 2.0 - 1.0;
+    texN.z = sqrt(max(0.0, 1.0 - dot(texN.xy, texN.xy)));
     mat3 toView = mat3(T,B,N);
     N = normalize(toView * texN);
 
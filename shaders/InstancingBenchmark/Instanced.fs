@@ -0,0 +1,17 @@
+#version 430 core
+// Change to 410 for macOS
+
+layout(location=0) out vec4 out_color;
+
+in vec4 vertexColor;
+in vec3 interPos;
+in vec3 interNormal;
+
+void main()
+{
+	// Headlight: cheap on purpose, so the numbers are about vertex/draw throughput
+	vec3 N = normalize(interNormal);
+	vec3 V = normalize(-interPos);
+	float diffuse = max(dot(N, V), 0.0);
+	out_color = vec4(vec3(vertexColor) * (0.2 + 0.8 * diffuse), 1.0);
+}
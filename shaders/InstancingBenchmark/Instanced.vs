@@ -0,0 +1,44 @@
+#version 430 core
+// Change to 410 for macOS (no SSBO path there)
+
+layout(location=0) in vec3 position;
+layout(location=1) in vec4 color;
+layout(location=2) in vec3 normal;
+
+// Where the model matrix comes from is picked with a define (see InstancingBenchmark.cpp)
+#if defined(INSTANCE_ATTRIBUTE)
+layout(location=6) in mat4 instanceModelMat;	// Locations 6..9, divisor 1
+#elif defined(INSTANCE_SSBO)
+layout(std430, binding=9) readonly buffer InstanceBuffer
+{
+	mat4 instanceMats[];
+};
+#else
+uniform mat4 modelMat;							// One draw call per instance
+#endif
+
+uniform mat4 viewMat;
+uniform mat4 projMat;
+
+out vec4 vertexColor;
+out vec3 interPos;
+out vec3 interNormal;
+
+void main()
+{
+#if defined(INSTANCE_ATTRIBUTE)
+	mat4 M = instanceModelMat;
+#elif defined(INSTANCE_SSBO)
+	mat4 M = instanceMats[gl_InstanceID];
+#else
+	mat4 M = modelMat;
+#endif
+
+	// Instances are rotation + uniform scale only, so the model-view matrix works for normals
+	mat4 modelViewMat = viewMat * M;
+	vec4 viewPos = modelViewMat * vec4(position, 1.0);
+	gl_Position = projMat * viewPos;
+	interPos = vec3(viewPos);
+	interNormal = mat3(modelViewMat) * normal;
+	vertexColor = color;
+}
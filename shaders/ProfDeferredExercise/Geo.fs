@@ -1,9 +1,15 @@
 #version 430 core
 // 410 mac
 
+#ifdef COMPACT_GBUFFER
+// Position comes back from the depth buffer
+layout(location=0) out vec2 gNormal;
+layout(location=1) out vec4 gAlbedoSpec;
+#else
 layout(location=0) out vec3 gPosition;
 layout(location=1) out vec3 gNormal;
 layout(location=2) out vec4 gAlbedoSpec;
+#endif
 
 in vec4 interColor;
 in vec3 interPos;
@@ -14,16 +20,29 @@ in vec3 interTangent;
 uniform sampler2D diffuseTexture;
 uniform sampler2D normalTexture;
 
+#ifdef COMPACT_GBUFFER
+vec2 signNotZero(vec2 v) {
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Unit vector -> octahedron folded onto [-1,1]^2, then remapped to [0,1] for RG16
+vec2 encodeNormalOct(vec3 n) {
+    n /= (abs(n.x) + abs(n.y) + abs(n.z));
+    vec2 e = (n.z >= 0.0) ? n.xy : (1.0 - abs(n.yx))*signNotZero(n.xy);
+    return e*0.5 + 0.5;
+}
+#endif
+
 void main() {
     vec3 N = normalize(interNormal);
     vec3 T = normalize(interTangent);
     T = normalize(T - dot(T,N)*N);
     vec3 B = normalize(cross(N,T));
 
-    vec3 texN = vec3(texture(normalTexture, interUV));
-    texN.x = (texN.x - 0.5)*2.0;
-    texN.y = (texN.y - 0.5)*2.0;
-    texN = normalize(texN);
+    // Only RG is stored (BC5), so rebuild z from the unit length
+    vec3 texN;
+    texN.xy = texture(normalTexture, interUV).rg*2.0 - 1.0;
+    texN.z = sqrt(max(0.0, 1.0 - dot(texN.xy, texN.xy)));
 
     mat3 toView = mat3(T,B,N);
 
@@ -34,8 +53,12 @@ void main() {
 
     vec3 albedo = vertColor; //texColor; // texColor*vertColor;
 
+#ifdef COMPACT_GBUFFER
+    gNormal = encodeNormalOct(N);
+#else
     gPosition = interPos;
     gNormal = N;
+#endif
     gAlbedoSpec.rgb = albedo;
     gAlbedoSpec.a = 1;
 }
@@ -8,10 +8,16 @@ layout(location=3) in vec2 texcoord;
 layout(location=4) in vec3 tangent;
 
 uniform mat4 modelMat;
-uniform mat4 viewMat;
-uniform mat4 projMat;
 uniform mat3 normalMat;
 
+// Updated once per frame (UniformRingGL)
+layout(std140, binding=0) uniform FrameBlock {
+    mat4 viewMat;
+    mat4 projMat;
+    mat4 invProjMat;
+    ivec4 tileInfo;     // x = tiles per row
+};
+
 out vec4 interColor;
 out vec3 interPos;
 out vec3 interNormal;
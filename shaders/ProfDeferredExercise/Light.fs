@@ -5,42 +5,103 @@ layout(location=0) out vec4 out_color;
 
 in vec2 interUV;
 
+#ifdef COMPACT_GBUFFER
+uniform sampler2D gNormal;
+uniform sampler2D gAlbedoSpec;
+uniform sampler2D gDepth;
+#else
 uniform sampler2D gPosition;
 uniform sampler2D gNormal;
 uniform sampler2D gAlbedoSpec;
+#endif
+
+#define TILE_SIZE 16
+#define MAX_LIGHTS_PER_TILE 255
 
 struct PointLight {
-    vec4 pos;
+    vec4 pos;       // xyz = view-space position, w = radius
     vec4 color;
 };
 
-const int LIGHT_CNT = 10;
+layout(std430, binding=1) readonly buffer LightBuffer {
+    PointLight lights[];
+};
+
+// Filled in by LightCull.comp
+layout(std430, binding=2) readonly buffer TileBuffer {
+    uint tileData[];
+};
+
+// Updated once per frame (UniformRingGL)
+layout(std140, binding=0) uniform FrameBlock {
+    mat4 viewMat;
+    mat4 projMat;
+    mat4 invProjMat;
+    ivec4 tileInfo;     // x = tiles per row
+};
+
+#ifdef COMPACT_GBUFFER
+vec2 signNotZero(vec2 v) {
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Inverse of encodeNormalOct() in Geo.fs
+vec3 decodeNormalOct(vec2 e) {
+    e = e*2.0 - 1.0;
+    vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    if(n.z < 0.0) {
+        n.xy = (1.0 - abs(n.yx))*signNotZero(n.xy);
+    }
+    return normalize(n);
+}
 
-uniform PointLight lights[LIGHT_CNT];
+// Undo the projection: screen UV + depth -> view-space position
+vec3 reconstructViewPos(vec2 uv, float depth) {
+    vec4 ndc = vec4(uv*2.0 - 1.0, depth*2.0 - 1.0, 1.0);
+    vec4 viewPos = invProjMat*ndc;
+    return viewPos.xyz / viewPos.w;
+}
+#endif
 
 void main() {
+#ifdef COMPACT_GBUFFER
+    float depth = texture(gDepth, interUV).r;
+    vec3 interPos = reconstructViewPos(interUV, depth);
+    vec3 N = decodeNormalOct(texture(gNormal, interUV).rg);
+#else
     vec3 interPos = vec3(texture(gPosition, interUV));
     vec3 N = vec3(texture(gNormal, interUV));
+#endif
     vec4 albedoSpec = texture(gAlbedoSpec, interUV);
     vec3 albedo = albedoSpec.rgb;
     float shininess = albedoSpec.a;
 
     vec3 finalColor = vec3(0,0,0);
 
-    for(int i = 0; i < LIGHT_CNT; i++) {
-        vec3 lightPos = vec3(lights[i].pos);
-        vec3 lightColor = vec3(lights[i].color);
+    // Only the lights binned into this pixel's tile
+    ivec2 tile = ivec2(gl_FragCoord.xy) / TILE_SIZE;
+    uint base = uint(tile.y*tileInfo.x + tile.x)*uint(MAX_LIGHTS_PER_TILE + 1);
+    uint cnt = tileData[base];
+
+    for(uint i = 0; i < cnt; i++) {
+        PointLight light = lights[tileData[base + 1 + i]];
+        vec3 lightPos = light.pos.xyz;
+        float radius = light.pos.w;
+        vec3 lightColor = vec3(light.color);
 
         vec3 L = lightPos - interPos;
-        L = normalize(L);
+        float dist = length(L);
+        L = L / max(dist, 0.0001);
+
+        // Smooth falloff that reaches exactly zero at the radius
+        float window = clamp(1.0 - pow(dist/radius, 4.0), 0.0, 1.0);
+        float atten = window*window / (1.0 + dist*dist);
 
         float diff = max(0, dot(L,N));
-        vec3 diffColor = diff*albedo;
+        vec3 diffColor = diff*albedo*lightColor*atten;
         finalColor += diffColor;
     }
 
     finalColor = finalColor / (finalColor + vec3(1.0));
     out_color = vec4(finalColor, 1.0);
-    //vec3 color = albedo*vec3(lights[0].color);
-    //out_color = vec4(color, 1);
 }
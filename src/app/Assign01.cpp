@@ -10,6 +10,7 @@
 #include "MeshGLData.hpp"
 #include "GLSetup.hpp"
 #include "Shader.hpp"
+#include "FramePacer.hpp"
 using namespace std;
 
 // Create very simple mesh: a quad (4 vertices, 6 indices, 2 triangles)
@@ -104,6 +105,10 @@ int main(int argc, char **argv) {
 	// Enable depth testing
 	glEnable(GL_DEPTH_TEST);
 
+	// Frame pacing
+	FramePacer pacer;
+	createFramePacer(pacer, window);
+
 	while (!glfwWindowShouldClose(window)) {
 		// Set viewport size
 		int fwidth, fheight;
@@ -120,11 +125,11 @@ int main(int argc, char **argv) {
 		drawMesh(mgl);	
 
 		// Swap buffers and poll for window events		
-		glfwSwapBuffers(window);
+		swapFrameBuffers(pacer, window);
 		glfwPollEvents();
 
-		// Sleep for 15 ms
-		this_thread::sleep_for(chrono::milliseconds(15));
+		// Wait for next frame (vsync by default; see FramePacer.hpp)
+		waitForNextFrame(pacer);
 	}
 
 	// Clean up mesh
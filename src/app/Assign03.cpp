@@ -10,6 +10,7 @@
 #include "MeshGLData.hpp"
 #include "GLSetup.hpp"
 #include "Shader.hpp"
+#include "FramePacer.hpp"
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -212,6 +213,10 @@ int main(int argc, char **argv) {
 
 ///////////////////////////////////////////////////////////////////////////////////////
 
+	// Frame pacing
+	FramePacer pacer;
+	createFramePacer(pacer, window);
+
 	while (!glfwWindowShouldClose(window)) {
 		// Set viewport size
 		int fwidth, fheight;
@@ -233,11 +238,11 @@ int main(int argc, char **argv) {
 		}
 
 		// Swap buffers and poll for window events		
-		glfwSwapBuffers(window);
+		swapFrameBuffers(pacer, window);
 		glfwPollEvents();
 
-		// Sleep for 15 ms
-		this_thread::sleep_for(chrono::milliseconds(15));
+		// Wait for next frame (vsync by default; see FramePacer.hpp)
+		waitForNextFrame(pacer);
 	}
 
 	// Clean up mesh
@@ -10,6 +10,7 @@
 #include "MeshGLData.hpp"
 #include "GLSetup.hpp"
 #include "Shader.hpp"
+#include "FramePacer.hpp"
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -21,6 +22,7 @@
 #include "glm/gtx/string_cast.hpp"
 #include "glm/gtc/type_ptr.hpp"
 #include "Utility.hpp"
+#include "SceneGraph.hpp"
 
 using namespace std;
 
@@ -35,25 +37,24 @@ glm::mat4 makeRotateZ(glm::vec3 offset)
 }
 
 
-void renderScene(vector<MeshGL> &allMeshes, aiNode *node, glm::mat4 parentMat, GLint modelMatLoc, int level)
+void renderScene(vector<MeshGL> &allMeshes, SceneGraph &sg, GLint modelMatLoc)
 {
-	glm::mat4 nodeT;
-	aiMatToGLM4(node->mTransformation, nodeT);
-	glm::mat4 modelMat = parentMat * nodeT;
-	glm::vec3 pos = modelMat[3];
-	glm::mat4 R = makeRotateZ(pos);
-	glm::mat4 tmpModel = R * modelMat;
-	glUniformMatrix4fv(modelMatLoc, 1, false, glm::value_ptr(tmpModel));
-	//glUniformMatrix4fv(modelMatLoc, 1, false, glm::value_ptr(modelMat));
-
-	for (int i = 0; i < node->mNumMeshes; i++)
+	int nodeCnt = getNodeCount(sg);
+	for (int n = 0; n < nodeCnt; n++)
 	{
-		int index = node->mMeshes[i];
-		drawMesh(allMeshes.at(index));
-	}
-	for (int i = 0; i < node->mNumChildren; i++)
-	{
-		renderScene(allMeshes, node->mChildren[i], modelMat, modelMatLoc, level + 1);
+		if (sg.meshCounts[n] == 0) continue;
+
+		glm::mat4 &modelMat = sg.worldMats[n];
+		glm::vec3 pos = modelMat[3];
+		glm::mat4 R = makeRotateZ(pos);
+		glm::mat4 tmpModel = R * modelMat;
+		glUniformMatrix4fv(modelMatLoc, 1, false, glm::value_ptr(tmpModel));
+
+		for (unsigned int i = 0; i < sg.meshCounts[n]; i++)
+		{
+			int index = sg.meshIndices[sg.meshStarts[n] + i];
+			drawMesh(allMeshes.at(index));
+		}
 	}
 }
 
@@ -277,11 +278,19 @@ int main(int argc, char **argv) {
 		myVector.push_back(mg);
 	}
 
+	// Flatten node hierarchy once; world matrices are only recomputed when dirty
+	SceneGraph sg;
+	flattenSceneGraph(scene->mRootNode, sg);
+
 ///////////////////////////////////////////////////////////////////////////////////////
 
 	GLint modelMatLoc = glGetUniformLocation(programID, "modelMat");
 
 
+	// Frame pacing
+	FramePacer pacer;
+	createFramePacer(pacer, window);
+
 	while (!glfwWindowShouldClose(window)) {
 		// Set viewport size
 		int fwidth, fheight;
@@ -297,14 +306,15 @@ int main(int argc, char **argv) {
 		// Draw object
 		//drawMesh(mgl);	
 
-		renderScene(myVector, scene->mRootNode, glm::mat4(1.0), modelMatLoc, 0);
+		updateSceneGraph(sg);
+		renderScene(myVector, sg, modelMatLoc);
 
 		// Swap buffers and poll for window events		
-		glfwSwapBuffers(window);
+		swapFrameBuffers(pacer, window);
 		glfwPollEvents();
 
-		// Sleep for 15 ms
-		this_thread::sleep_for(chrono::milliseconds(15));
+		// Wait for next frame (vsync by default; see FramePacer.hpp)
+		waitForNextFrame(pacer);
 	}
 
 	// Clean up mesh
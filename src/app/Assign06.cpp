@@ -10,6 +10,7 @@
 #include "MeshGLData.hpp"
 #include "GLSetup.hpp"
 #include "Shader.hpp"
+#include "FramePacer.hpp"
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -21,6 +22,7 @@
 #include "glm/gtx/string_cast.hpp"
 #include "glm/gtc/type_ptr.hpp"
 #include "Utility.hpp"
+#include "SceneGraph.hpp"
 
 using namespace std;
 
@@ -70,28 +72,30 @@ glm::mat4 makeRotateZ(glm::vec3 offset)
 }
 
 
-void renderScene(vector<MeshGL> &allMeshes, aiNode *node, glm::mat4 parentMat, GLint modelMatLoc, int level,
+void renderScene(vector<MeshGL> &allMeshes, SceneGraph &sg, GLint modelMatLoc,
 					GLint normMatLoc, glm::mat4 viewMat)
 {
-	glm::mat4 nodeT;
-	aiMatToGLM4(node->mTransformation, nodeT);
-	glm::mat4 modelMat = parentMat * nodeT;
-	glm::vec3 pos = modelMat[3];
-	glm::mat4 R = makeRotateZ(pos);
-	glm::mat4 tmpModel = R * modelMat;
-	glUniformMatrix4fv(modelMatLoc, 1, false, glm::value_ptr(tmpModel));
-	//glUniformMatrix4fv(modelMatLoc, 1, false, glm::value_ptr(modelMat));
-	glm::mat3 normalMat = glm::transpose(glm::inverse(glm::mat3(viewMat * tmpModel)));
-	glUniformMatrix3fv(normMatLoc, 1, false, glm::value_ptr(normalMat));
-
-	for (int i = 0; i < node->mNumMeshes; i++)
+	// View and R are both rigid, so their inverse-transpose is themselves
+	// and the cached normal matrix only needs rotating.
+	glm::mat3 viewRot = glm::mat3(viewMat);
+	int nodeCnt = getNodeCount(sg);
+	for (int n = 0; n < nodeCnt; n++)
 	{
-		int index = node->mMeshes[i];
-		drawMesh(allMeshes.at(index));
-	}
-	for (int i = 0; i < node->mNumChildren; i++)
-	{
-		renderScene(allMeshes, node->mChildren[i], modelMat, modelMatLoc, level + 1, normMatLoc, viewMat);
+		if (sg.meshCounts[n] == 0) continue;
+
+		glm::mat4 &modelMat = sg.worldMats[n];
+		glm::vec3 pos = modelMat[3];
+		glm::mat4 R = makeRotateZ(pos);
+		glm::mat4 tmpModel = R * modelMat;
+		glUniformMatrix4fv(modelMatLoc, 1, false, glm::value_ptr(tmpModel));
+		glm::mat3 normalMat = viewRot * glm::mat3(R) * sg.normalMats[n];
+		glUniformMatrix3fv(normMatLoc, 1, false, glm::value_ptr(normalMat));
+
+		for (unsigned int i = 0; i < sg.meshCounts[n]; i++)
+		{
+			int index = sg.meshIndices[sg.meshStarts[n] + i];
+			drawMesh(allMeshes.at(index));
+		}
 	}
 }
 
@@ -364,6 +368,10 @@ int main(int argc, char **argv) {
 		myVector.push_back(mg);
 	}
 
+	// Flatten node hierarchy once; world matrices are only recomputed when dirty
+	SceneGraph sg;
+	flattenSceneGraph(scene->mRootNode, sg);
+
 ///////////////////////////////////////////////////////////////////////////////////////
 
 	GLint modelMatLoc = glGetUniformLocation(programID, "modelMat");
@@ -387,6 +395,10 @@ int main(int argc, char **argv) {
 	GLint normMatLoc = glGetUniformLocation(programID, "normMat");
 
 
+	// Frame pacing
+	FramePacer pacer;
+	createFramePacer(pacer, window);
+
 	while (!glfwWindowShouldClose(window)) {
 		// Set viewport size
 		int fwidth, fheight;
@@ -423,14 +435,15 @@ int main(int argc, char **argv) {
 		glUniform4fv(lightColLoc, 1, glm::value_ptr(light.color));
 		/////////////////////////////////////////////////////////////
 
-		renderScene(myVector, scene->mRootNode, glm::mat4(1.0), modelMatLoc, 0, normMatLoc, viewMat);
+		updateSceneGraph(sg);
+		renderScene(myVector, sg, modelMatLoc, normMatLoc, viewMat);
 
 		// Swap buffers and poll for window events		
-		glfwSwapBuffers(window);
+		swapFrameBuffers(pacer, window);
 		glfwPollEvents();
 
-		// Sleep for 15 ms
-		this_thread::sleep_for(chrono::milliseconds(15));
+		// Wait for next frame (vsync by default; see FramePacer.hpp)
+		waitForNextFrame(pacer);
 	}
 
 	// Clean up mesh
@@ -3,6 +3,7 @@
 #include <sstream>
 #include <thread>
 #include <vector>
+#include <cfloat>
 #include <GL/glew.h>					
 #include <GLFW/glfw3.h>
 #include "glm/glm.hpp"
@@ -10,6 +11,7 @@
 #include "MeshGLData.hpp"
 #include "GLSetup.hpp"
 #include "Shader.hpp"
+#include "FramePacer.hpp"
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -21,6 +23,15 @@
 #include "glm/gtx/string_cast.hpp"
 #include "glm/gtc/type_ptr.hpp"
 #include "Utility.hpp"
+#include "SceneGraph.hpp"
+#include "MeshBatchGLData.hpp"
+#include "MeshCache.hpp"
+#include "MeshExtract.hpp"
+#include "MeshLOD.hpp"
+#include "MaterialGL.hpp"
+#include "UniformRingGL.hpp"
+#include "Benchmark.hpp"
+#include "HiZGL.hpp"
 
 using namespace std;
 
@@ -37,6 +48,47 @@ struct PointLight
 
 PointLight light;
 
+// Per-frame state lives in std140 uniform blocks (binding points must match the shaders)
+#define CAMERA_BLOCK_BINDING 0
+#define LIGHT_BLOCK_BINDING 1
+#define MATERIAL_BLOCK_BINDING 2
+
+struct CameraBlock
+{
+	glm::mat4 viewMat;
+	glm::mat4 projMat;
+};
+
+struct MaterialBlock
+{
+	float metallic;
+	float roughness;
+	float padding[2];
+};
+
+// Uniform locations for one shader program (per-object state only)
+struct SceneUniforms
+{
+	GLint modelMat = -1;
+	GLint normMat = -1;
+};
+
+// Draw the whole scene with one multi-draw call (toggle with I)
+bool useBatch = true;
+
+// Frustum cull batched draws on the GPU (toggle with C)
+bool useGPUCulling = true;
+
+// Also cull batched draws against the Hi-Z depth pyramid (toggle with O; needs C)
+bool useOcclusionCulling = true;
+
+// Pick a simplified LOD per batched draw from its projected error (toggle with L)
+bool useLOD = true;
+float lodPixelError = 1.0f;
+
+// Give batched draws different materials from one texture-array library (toggle with T)
+bool useMaterials = true;
+
 float rotAngle = 0.0f;
 glm::vec3 eye = glm::vec3(0,0,1);
 glm::vec3 lookAt = glm::vec3(0,0,0);
@@ -75,29 +127,144 @@ glm::mat4 makeRotateZ(glm::vec3 offset)
 }
 
 
-void renderScene(vector<MeshGL> &allMeshes, aiNode *node, glm::mat4 parentMat, GLint modelMatLoc, int level,
+void renderScene(vector<MeshGL> &allMeshes, SceneGraph &sg, GLint modelMatLoc,
 					GLint normMatLoc, glm::mat4 viewMat)
 {
-	glm::mat4 nodeT;
-	aiMatToGLM4(node->mTransformation, nodeT);
-	glm::mat4 modelMat = parentMat * nodeT;
-	glm::vec3 pos = modelMat[3];
-	glm::mat4 R = makeRotateZ(pos);
-	glm::mat4 tmpModel = R * modelMat;
-	glUniformMatrix4fv(modelMatLoc, 1, false, glm::value_ptr(tmpModel));
-	//glUniformMatrix4fv(modelMatLoc, 1, false, glm::value_ptr(modelMat));
-	glm::mat3 normalMat = glm::transpose(glm::inverse(glm::mat3(viewMat * tmpModel)));
-	glUniformMatrix3fv(normMatLoc, 1, false, glm::value_ptr(normalMat));
-
-	for (int i = 0; i < node->mNumMeshes; i++)
+	// View and R are both rigid, so their inverse-transpose is themselves
+	// and the cached normal matrix only needs rotating.
+	glm::mat3 viewRot = glm::mat3(viewMat);
+	int nodeCnt = getNodeCount(sg);
+	for (int n = 0; n < nodeCnt; n++)
 	{
-		int index = node->mMeshes[i];
-		drawMesh(allMeshes.at(index));
+		if (sg.meshCounts[n] == 0) continue;
+
+		glm::mat4 &modelMat = sg.worldMats[n];
+		glm::vec3 pos = modelMat[3];
+		glm::mat4 R = makeRotateZ(pos);
+		glm::mat4 tmpModel = R * modelMat;
+		glUniformMatrix4fv(modelMatLoc, 1, false, glm::value_ptr(tmpModel));
+		glm::mat3 normalMat = viewRot * glm::mat3(R) * sg.normalMats[n];
+		glUniformMatrix3fv(normMatLoc, 1, false, glm::value_ptr(normalMat));
+
+		for (unsigned int i = 0; i < sg.meshCounts[n]; i++)
+		{
+			int index = sg.meshIndices[sg.meshStarts[n] + i];
+			drawMesh(allMeshes.at(index));
+		}
 	}
-	for (int i = 0; i < node->mNumChildren; i++)
+}
+
+// Same as renderScene(), but matrices go to an SSBO and everything is drawn at once
+void renderSceneBatch(MeshBatchGL &batch, SceneGraph &sg, glm::mat4 viewMat, glm::mat4 projMat,
+						float viewportHeight, HiZBuffer &hz, GLuint depthTexID, int materialCnt)
+{
+	glm::mat3 viewRot = glm::mat3(viewMat);
+	clearBatchDraws(batch);
+	int nodeCnt = getNodeCount(sg);
+	for (int n = 0; n < nodeCnt; n++)
 	{
-		renderScene(allMeshes, node->mChildren[i], modelMat, modelMatLoc, level + 1, normMatLoc, viewMat);
+		if (sg.meshCounts[n] == 0) continue;
+
+		glm::mat4 &modelMat = sg.worldMats[n];
+		glm::vec3 pos = modelMat[3];
+		glm::mat4 R = makeRotateZ(pos);
+		glm::mat4 tmpModel = R * modelMat;
+		glm::mat3 normalMat = viewRot * glm::mat3(R) * sg.normalMats[n];
+
+		// Material 0 is the plain vertex-color look; the rest are handed out per node
+		int material = 0;
+		if (useMaterials && materialCnt > 1)
+			material = 1 + (n % (materialCnt - 1));
+
+		for (unsigned int i = 0; i < sg.meshCounts[n]; i++)
+		{
+			int index = sg.meshIndices[sg.meshStarts[n] + i];
+			int lod = 0;
+			if (useLOD)
+				lod = selectBatchLOD(batch, index, viewMat * tmpModel, projMat, viewportHeight, lodPixelError);
+			addBatchDraw(batch, index, tmpModel, normalMat, lod, material);
+		}
 	}
+	if (useGPUCulling && useOcclusionCulling)
+		drawMeshBatchOcclusionCulled(batch, hz, depthTexID, viewMat, projMat);
+	else if (useGPUCulling)
+		drawMeshBatchCulled(batch, viewMat, projMat);
+	else
+		drawMeshBatch(batch);
+}
+
+// A handful of materials mixing the sample textures, so the batch has something to switch between
+void setupSceneMaterials(MaterialLibraryGL &materials, ThreadPool &pool)
+{
+	createMaterialLibraryGL(materials);
+
+	GPUMaterial plain;
+	addMaterial(materials, plain);
+
+	GPUMaterial checker;
+	checker.albedoLayer = addMaterialTexture(materials, "test.png");
+	checker.normalLayer = addMaterialTexture(materials, "normal.png", true);
+	addMaterial(materials, checker);
+
+	GPUMaterial smile;
+	smile.albedoLayer = addMaterialTexture(materials, "image01.png");
+	smile.normalLayer = addMaterialTexture(materials, "normalSmile.png", true);
+	smile.roughness = 0.3f;
+	addMaterial(materials, smile);
+
+	GPUMaterial metal;
+	metal.albedoLayer = addMaterialTexture(materials, "test_old.png");
+	metal.metallic = 0.8f;
+	metal.roughness = 0.25f;
+	addMaterial(materials, metal);
+
+	GPUMaterial bumpyRed;
+	bumpyRed.baseColor = glm::vec4(0.8f, 0.2f, 0.2f, 1.0f);
+	bumpyRed.normalLayer = addMaterialTexture(materials, "normal.png", true);
+	bumpyRed.metallic = 0.0f;
+	bumpyRed.roughness = 0.6f;
+	addMaterial(materials, bumpyRed);
+
+	uploadMaterialLibraryGL(materials, pool);
+}
+
+// Bounding sphere of the whole scene (world space), used to frame the benchmark camera.
+// Built from each mesh's bounding sphere in the batch, so it works without host-side meshes.
+void computeSceneBounds(MeshBatchGL &batch, SceneGraph &sg, glm::vec3 &center, float &radius)
+{
+	glm::vec3 minPos(FLT_MAX);
+	glm::vec3 maxPos(-FLT_MAX);
+	int nodeCnt = getNodeCount(sg);
+	for (int n = 0; n < nodeCnt; n++)
+	{
+		for (unsigned int i = 0; i < sg.meshCounts[n]; i++)
+		{
+			BatchMeshRange &range = batch.meshes.at(sg.meshIndices[sg.meshStarts[n] + i]);
+			glm::mat4 vertToWorldMat = sg.worldMats[n] * range.dequantMat;
+			glm::vec3 sphereCenter = glm::vec3(vertToWorldMat * glm::vec4(glm::vec3(range.boundingSphere), 1.0f));
+			float sphereRadius = range.boundingSphere.w * getMatrixMaxScale(vertToWorldMat);
+			minPos = glm::min(minPos, sphereCenter - glm::vec3(sphereRadius));
+			maxPos = glm::max(maxPos, sphereCenter + glm::vec3(sphereRadius));
+		}
+	}
+
+	if (minPos.x > maxPos.x)
+	{
+		center = glm::vec3(0,0,0);
+		radius = 1.0f;
+		return;
+	}
+	center = 0.5f * (minPos + maxPos);
+	radius = max(0.5f * glm::length(maxPos - minPos), 0.001f);
+}
+
+// Locations come from the shader cache's reflection table (refresh after a reload)
+SceneUniforms getSceneUniforms(ShaderCache &shaders, int handle)
+{
+	SceneUniforms u;
+	u.modelMat = getShaderUniform(shaders, handle, "modelMat");
+	u.normMat = getShaderUniform(shaders, handle, "normMat");
+	return u;
 }
 
 static void key_callback(GLFWwindow *window,
@@ -118,6 +285,31 @@ static void key_callback(GLFWwindow *window,
 		{
             rotAngle -= 1.0;
         }
+		else if(key == GLFW_KEY_I && action == GLFW_PRESS)
+		{
+			useBatch = !useBatch;
+			cout << "Batched drawing: " << (useBatch ? "ON" : "OFF") << endl;
+		}
+		else if(key == GLFW_KEY_C && action == GLFW_PRESS)
+		{
+			useGPUCulling = !useGPUCulling;
+			cout << "GPU frustum culling: " << (useGPUCulling ? "ON" : "OFF") << endl;
+		}
+		else if(key == GLFW_KEY_O && action == GLFW_PRESS)
+		{
+			useOcclusionCulling = !useOcclusionCulling;
+			cout << "Hi-Z occlusion culling: " << (useOcclusionCulling ? "ON" : "OFF") << endl;
+		}
+		else if(key == GLFW_KEY_L && action == GLFW_PRESS)
+		{
+			useLOD = !useLOD;
+			cout << "LOD selection: " << (useLOD ? "ON" : "OFF") << endl;
+		}
+		else if(key == GLFW_KEY_T && action == GLFW_PRESS)
+		{
+			useMaterials = !useMaterials;
+			cout << "Per-node materials: " << (useMaterials ? "ON" : "OFF") << endl;
+		}
 		if (key == GLFW_KEY_W)
 		{
 			glm::vec3 change = lookAt - eye;
@@ -289,42 +481,27 @@ void createSimplePentagon(Mesh &m) {
 }
 
 
-void extractMeshData(aiMesh *mesh, Mesh &m)
-{
-	m.vertices.clear();
-	m.indices.clear();
-	for (int i = 0; i < mesh->mNumVertices; i++)
-	{
-		Vertex v;
-		v.position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
-		//v.color = glm::vec4(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z, 1.0);
-		v.color = glm::vec4(1.0, 1.0, 0, 1.0);
-		v.normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
-		m.vertices.push_back(v);
-	}
-
-	for (int i = 0; i < mesh -> mNumFaces; i++)
-	{
-		aiFace f = mesh->mFaces[i];
-		for (int j = 0; j < f.mNumIndices; j++)
-		{
-			m.indices.push_back(f.mIndices[j]);
-		}
-	}
-}
-
 // Main 
 int main(int argc, char **argv) {
 
-	// Are we in debugging mode?
-	bool DEBUG_MODE = true;
+	// Benchmark options (see Benchmark.hpp); the first other argument is the model path
+	BenchmarkSettings benchSettings;
+	vector<string> otherArgs;
+	if (!parseBenchmarkArgs(argc, argv, benchSettings, otherArgs)) exit(EXIT_FAILURE);
+
+	// Are we in debugging mode? (never while benchmarking)
+	bool DEBUG_MODE = !benchSettings.enabled;
 
 	// GLFW setup
 	// Switch to 4.1 if necessary for macOS
-	GLFWwindow* window = setupGLFW("Assign07: barteldf", 4, 3, 800, 800, DEBUG_MODE);
+	GLFWwindow* window = NULL;
+	if (benchSettings.enabled)
+		window = setupGLFWHeadless("Assign07: barteldf", 4, 3, benchSettings.width, benchSettings.height, DEBUG_MODE);
+	else
+		window = setupGLFW("Assign07: barteldf", 4, 3, 800, 800, DEBUG_MODE);
 
 	// GLEW setup
-	setupGLEW(window);
+	setupGLEW(window, benchSettings.enabled);
 
 	// Check OpenGL version
 	checkOpenGLVersion();
@@ -337,18 +514,38 @@ int main(int argc, char **argv) {
 
 	glfwSetKeyCallback(window, key_callback);
 
-	// Create and load shaders
+	// Create and load shaders (linked binaries are cached on disk; .vs/.fs edits reload live)
+	ShaderCache shaders;
+	createShaderCache(shaders);
+	int basicShader = -1;
+	int batchShader = -1;
 	GLuint programID = 0;
+	GLuint batchProgramID = 0;
+	GLuint cullProgramID = 0;
+	GLuint hiZProgramID = 0;
 	try {		
-		// Load vertex shader code and fragment shader code
-		string vertexCode = readFileToString("./shaders/Assign07/Basic.vs");
-		string fragCode = readFileToString("./shaders/Assign07/Basic.fs");
-
 		// Print out shader code, just to check
-		if(DEBUG_MODE) printShaderCode(vertexCode, fragCode);
+		if(DEBUG_MODE)
+		{
+			string vertexCode = readFileToString("./shaders/Assign07/Basic.vs");
+			string fragCode = readFileToString("./shaders/Assign07/Basic.fs");
+			printShaderCode(vertexCode, fragCode);
+		}
 
-		// Create shader program from code
-		programID = initShaderProgramFromSource(vertexCode, fragCode);
+		// Create shader programs
+		basicShader = loadShaderProgram(shaders, { "./shaders/Assign07/Basic.vs", "./shaders/Assign07/Basic.fs" });
+		batchShader = loadShaderProgram(shaders, { "./shaders/Assign07/Batch.vs", "./shaders/Assign07/Basic.fs" },
+										"#define USE_MATERIALS\n");
+		programID = getShaderProgramID(shaders, basicShader);
+		batchProgramID = getShaderProgramID(shaders, batchShader);
+
+		// Compute programs are referenced by the batch/Hi-Z setup, so they aren't hot-reloaded
+		cullProgramID = getShaderProgramID(shaders,
+			loadShaderProgram(shaders, { "./shaders/Assign07/FrustumCull.comp" }, "", false));
+		hiZProgramID = getShaderProgramID(shaders,
+			loadShaderProgram(shaders, { "./shaders/Assign07/HiZBuild.comp" }, "", false));
+		cout << "Shader binaries from cache: " << shaders.binaryHitCnt << " of ";
+		cout << (shaders.binaryHitCnt + shaders.binaryMissCnt) << endl;
 	}
 	catch (exception e) {		
 		// Close program
@@ -371,72 +568,187 @@ int main(int argc, char **argv) {
 ////////////////////////////////////////////////////////////////////////////////////
 
 	string modelPath = "sampleModels/sphere.obj";
-	if (argc >= 2)
+	if (!otherArgs.empty())
 	{
-		modelPath = (string)argv[1];
+		modelPath = otherArgs[0];
 	}
 
-	Assimp::Importer importer;
-	unsigned int flags = aiProcess_Triangulate | aiProcess_FlipUVs
-					| aiProcess_GenNormals | aiProcess_JoinIdenticalVertices;
-	const aiScene *scene = importer.ReadFile(modelPath, flags);
+	// Processed meshes are cached next to the model; a changed model invalidates the cache
+	string cachePath = modelPath + ".meshcache";
+	uint64_t sourceHash = hashFile(modelPath);
 
-	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+	// Per-mesh VAOs for the plain path, plus the same meshes packed into shared buffers
+	// for multi-draw indirect. Both get the same layouts whether or not the cache exists.
+	const VertexFormat meshFormat = VERTEX_FORMAT_PACKED;
+	const VertexFormat batchFormat = VERTEX_FORMAT_PACKED_QUANT;
+	vector<MeshGL> myVector;
+	MeshBatchGL batch;
+	SceneGraph sg;
+	MeshCache cache;
+
+	if (openMeshCache(cachePath, sourceHash, cache))
 	{
-		cerr << "Error: " << importer.GetErrorString() << endl;
-		exit(1);
+		// Warm start: skip Assimp entirely, and pack straight from the mapped file
+		// (no host copy of the meshes)
+		cout << "Loading from mesh cache: " << cachePath << endl;
+		int meshCnt = getCachedMeshCount(cache);
+		for (int i = 0; i < meshCnt; i++)
+		{
+			MeshGL mg;
+			createMeshGLFromCache(cache, i, mg, meshFormat);
+			myVector.push_back(mg);
+		}
+		createMeshBatchGLFromCache(cache, batch, batchFormat);
+		getSceneGraphFromCache(cache, sg);
+		closeMeshCache(cache);
 	}
+	else
+	{
+		Assimp::Importer importer;
+		unsigned int flags = aiProcess_Triangulate | aiProcess_FlipUVs
+						| aiProcess_GenNormals | aiProcess_JoinIdenticalVertices;
+		const aiScene *scene = importer.ReadFile(modelPath, flags);
 
-	vector<MeshGL> myVector;
-	for (int i = 0; i < scene->mNumMeshes; i++)
+		if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+		{
+			cerr << "Error: " << importer.GetErrorString() << endl;
+			exit(1);
+		}
+
+		// Convert meshes in parallel; only the GL upload stays on this thread
+		vector<Mesh> allMeshData;
+		ThreadPool pool;
+		createThreadPool(pool);
+		extractAllMeshData(scene, allMeshData, pool, glm::vec4(1.0, 1.0, 0, 1.0));
+
+		// Simplified versions share each mesh's vertices and end up in the cache too
+		generateAllMeshLODs(allMeshData, pool);
+		cleanupThreadPool(pool);
+
+		for (int i = 0; i < (int)allMeshData.size(); i++)
+		{
+			MeshGL mg;
+			createMeshGL(allMeshData[i], mg, meshFormat);
+			myVector.push_back(mg);
+		}
+		createMeshBatchGL(allMeshData, batch, batchFormat);
+
+		// Flatten node hierarchy once; world matrices are only recomputed when dirty
+		flattenSceneGraph(scene->mRootNode, sg);
+
+		if (sourceHash != 0 && writeMeshCache(cachePath, sourceHash, allMeshData, sg))
+		{
+			cout << "Wrote mesh cache: " << cachePath << endl;
+		}
+	}
+
+	setupBatchCulling(batch, cullProgramID);
+
+	// Every material's textures live in two texture arrays, so the batch needs no rebinds
+	MaterialLibraryGL materials;
 	{
-		Mesh m;
-		MeshGL mg;
-		extractMeshData(scene->mMeshes[i], m);
-		createMeshGL(m, mg);
-		myVector.push_back(mg);
+		ThreadPool pool;
+		createThreadPool(pool);
+		setupSceneMaterials(materials, pool);
+		cleanupThreadPool(pool);
 	}
 
 ///////////////////////////////////////////////////////////////////////////////////////
 
-	GLint modelMatLoc = glGetUniformLocation(programID, "modelMat");
+	SceneUniforms allUniforms[2] = { getSceneUniforms(shaders, basicShader), getSceneUniforms(shaders, batchShader) };
 
 /////////////////////////////////////////////////////////////////////////////
 	// assign05 stuff here
-	double mx, my;
-	glfwGetCursorPos(window, &mx, &my);
-	mousePos = glm::vec2(mx, my);
-	glfwSetCursorPosCallback(window, mouse_position_callback);
-	glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-
-	GLint viewMatLoc = glGetUniformLocation(programID, "viewMat");
-	GLint projMatLoc = glGetUniformLocation(programID, "projMat");
+	if (!benchSettings.enabled)
+	{
+		double mx, my;
+		glfwGetCursorPos(window, &mx, &my);
+		mousePos = glm::vec2(mx, my);
+		glfwSetCursorPosCallback(window, mouse_position_callback);
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+	}
 
 	light.pos = glm::vec4(0.5, 0.5, 0.5, 1);
 	light.color = glm::vec4(1,1,1,1);
 
-	GLint lightPosLoc = glGetUniformLocation(programID, "light.pos");
-	GLint lightColLoc = glGetUniformLocation(programID, "light.color");
-	GLint normMatLoc = glGetUniformLocation(programID, "normMat");
 
-	GLint roughnessLoc = glGetUniformLocation(programID, "roughness");
-	GLint metallicLoc = glGetUniformLocation(programID, "metallic");
 
+	// Camera, light and material blocks for every frame in flight
+	UniformRingGL uniformRing;
+	createUniformRingGL(uniformRing, 1024);
+
+	// Frame pacing
+	FramePacer pacer;
+	createFramePacer(pacer, window);
+
+	// Occlusion culling reads the depth buffer back, so the window renders into
+	// its own offscreen target (depth texture) and blits the color to the screen
+	OffscreenTarget viewTarget;
+	HiZBuffer hiZ;
+
+	// Headless benchmark: offscreen target, fixed orbit around the scene, no frame cap
+	BenchmarkRun bench;
+	glm::vec3 benchCenter;
+	float benchRadius = 1.0f;
+	if (benchSettings.enabled)
+	{
+		createBenchmarkRun(bench, benchSettings);
+		setFramePacingMode(pacer, FRAME_PACING_UNCAPPED);
+		updateSceneGraph(sg);
+		computeSceneBounds(batch, sg, benchCenter, benchRadius);
+		createHiZBuffer(hiZ, hiZProgramID, bench.target.width, bench.target.height);
+	}
+	else
+	{
+		int fwidth, fheight;
+		glfwGetFramebufferSize(window, &fwidth, &fheight);
+		createOffscreenTarget(viewTarget, max(fwidth, 1), max(fheight, 1));
+		createHiZBuffer(hiZ, hiZProgramID, viewTarget.width, viewTarget.height);
+	}
 
 	while (!glfwWindowShouldClose(window)) {
+		if (benchSettings.enabled && isBenchmarkDone(bench)) break;
+
 		// Set viewport size
 		int fwidth, fheight;
-		glfwGetFramebufferSize(window, &fwidth, &fheight);
-		glViewport(0, 0, fwidth, fheight);
+		if (benchSettings.enabled)
+		{
+			beginBenchmarkFrame(bench);
+			fwidth = bench.target.width;
+			fheight = bench.target.height;
+			getBenchmarkCamera(bench, benchCenter, 1.5f * benchRadius, eye, lookAt);
+		}
+		else
+		{
+			glfwGetFramebufferSize(window, &fwidth, &fheight);
+			if (fwidth > 0 && fheight > 0 && (fwidth != viewTarget.width || fheight != viewTarget.height))
+			{
+				cleanupOffscreenTarget(viewTarget);
+				createOffscreenTarget(viewTarget, fwidth, fheight);
+				resizeHiZBuffer(hiZ, fwidth, fheight);
+			}
+			glBindFramebuffer(GL_FRAMEBUFFER, viewTarget.fbo);
+			glViewport(0, 0, viewTarget.width, viewTarget.height);
+		}
 
 		// Clear the framebuffer
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+		// Pick up edited shader files
+		if (reloadChangedShaders(shaders))
+		{
+			programID = getShaderProgramID(shaders, basicShader);
+			batchProgramID = getShaderProgramID(shaders, batchShader);
+			allUniforms[0] = getSceneUniforms(shaders, basicShader);
+			allUniforms[1] = getSceneUniforms(shaders, batchShader);
+		}
+
 		// Use shader program
-		glUseProgram(programID);
+		GLuint currentProgID = useBatch ? batchProgramID : programID;
+		SceneUniforms &u = allUniforms[useBatch ? 1 : 0];
+		glUseProgram(currentProgID);
 
 		glm::mat4 viewMat = glm::lookAt(eye, lookAt, glm::vec3(0,1,0));
-		glUniformMatrix4fv(viewMatLoc, 1, false, glm::value_ptr(viewMat));
 		float aspectRatio;
 		if ((fwidth == 0) || (fheight == 0))
 		{
@@ -444,7 +756,13 @@ int main(int argc, char **argv) {
 		}
 		else aspectRatio = float(fwidth) / (float)fheight;
 		glm::mat4 projMat = glm::perspective(glm::radians(90.0f), aspectRatio, 0.01f, 50.0f);
-		glUniformMatrix4fv(projMatLoc, 1, false, glm::value_ptr(projMat));
+
+		// Written once per frame; any program using these blocks sees them without re-sending
+		beginUniformFrame(uniformRing);
+		CameraBlock camera;
+		camera.viewMat = viewMat;
+		camera.projMat = projMat;
+		pushAndBindUniformData(uniformRing, CAMERA_BLOCK_BINDING, &camera, sizeof(camera));
 
 
 
@@ -453,26 +771,61 @@ int main(int argc, char **argv) {
 
 		//////////////////////////////////////////////////////////////
 		// assign06
-		glm::vec4 eyeLightPos = glm::lookAt(eye, lookAt, glm::vec3(0,1,0)) * light.pos;
-
-		glUniform4fv(lightPosLoc, 1, glm::value_ptr(eyeLightPos));
-		glUniform4fv(lightColLoc, 1, glm::value_ptr(light.color));
+		PointLight eyeLight;
+		eyeLight.pos = viewMat * light.pos;
+		eyeLight.color = light.color;
+		pushAndBindUniformData(uniformRing, LIGHT_BLOCK_BINDING, &eyeLight, sizeof(eyeLight));
 		/////////////////////////////////////////////////////////////
 		// assign07
-		glUniform1f(metallicLoc, metallic);
-		glUniform1f(roughnessLoc, roughness);
+		MaterialBlock material;
+		material.metallic = metallic;
+		material.roughness = roughness;
+		pushAndBindUniformData(uniformRing, MATERIAL_BLOCK_BINDING, &material, sizeof(material));
 
 		/////////////////////////////////////////////////////////////
 
-		renderScene(myVector, scene->mRootNode, glm::mat4(1.0), modelMatLoc, 0, normMatLoc, viewMat);
+		updateSceneGraph(sg);
+		if (useBatch)
+		{
+			bindMaterialLibraryGL(materials);
+			renderSceneBatch(batch, sg, viewMat, projMat, (float)fheight, hiZ,
+								benchSettings.enabled ? bench.target.depthTexID : viewTarget.depthTexID,
+								getMaterialCount(materials));
+		}
+		else
+			renderScene(myVector, sg, u.modelMat, u.normMat, viewMat);
+		endUniformFrame(uniformRing);
 
 		// Swap buffers and poll for window events		
-		glfwSwapBuffers(window);
+		if (benchSettings.enabled)
+			endBenchmarkFrame(bench);
+		else
+		{
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, viewTarget.fbo);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+			glBlitFramebuffer(0, 0, viewTarget.width, viewTarget.height,
+								0, 0, viewTarget.width, viewTarget.height,
+								GL_COLOR_BUFFER_BIT, GL_NEAREST);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			swapFrameBuffers(pacer, window);
+		}
 		glfwPollEvents();
 
-		// Sleep for 15 ms
-		this_thread::sleep_for(chrono::milliseconds(15));
+		// Wait for next frame (vsync by default; see FramePacer.hpp)
+		waitForNextFrame(pacer);
+	}
+
+	if (benchSettings.enabled)
+	{
+		finishBenchmark(bench, modelPath);
+		cleanupBenchmarkRun(bench);
+	}
+	else
+	{
+		cleanupOffscreenTarget(viewTarget);
 	}
+	cleanupHiZBuffer(hiZ);
+	cleanupUniformRingGL(uniformRing);
 
 	// Clean up mesh
 	//cleanupMesh(mgl);
@@ -481,10 +834,11 @@ int main(int argc, char **argv) {
 		cleanupMesh(myVector[i]);
 	}
 	myVector.clear();
+	cleanupMeshBatch(batch);
+	cleanupMaterialLibraryGL(materials);
 
 	// Clean up shader programs
-	glUseProgram(0);
-	glDeleteProgram(programID);
+	cleanupShaderCache(shaders);
 		
 	// Destroy window and stop GLFW
 	cleanupGLFW(window);
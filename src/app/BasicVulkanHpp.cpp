@@ -1,3 +1,280 @@
+#include "VulkanSetup.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+using namespace std;
+
+#ifdef NDEBUG
+vector<const char*> validationLayers = {};
+#else
+vector<const char*> validationLayers = { "VK_LAYER_KHRONOS_validation" };
+#endif
+
+// Uniform blocks (std140-compatible; match shader.vert/shader.frag)
+struct CameraUniforms {
+    glm::mat4 viewMat;
+    glm::mat4 projMat;
+};
+
+struct LightUniforms {
+    glm::vec4 pos;      // View space
+    glm::vec4 color;
+};
+
+// Default grid of copies drawn with one push constant update each (--grid N)
+const int DEFAULT_GRID_SIZE = 16;
+
+// Frames per thread count in --record-bench
+const int RECORD_BENCH_WARMUP = 30;
+const int RECORD_BENCH_FRAMES = 120;
+
+void createTriangle(HostMesh &m) {
+    // Y-up and counter-clockwise, same as Assimp meshes
+    glm::vec3 n(0.0f, 0.0f, 1.0f);
+    m.vertices = {
+        {{ 0.0f,  0.5f, 0.0f}, {1.0f, 0.0f, 0.0f, 1.0f}, n},
+        {{ 0.5f, -0.5f, 0.0f}, {0.0f, 1.0f, 0.0f, 1.0f}, n},
+        {{-0.5f, -0.5f, 0.0f}, {0.0f, 0.0f, 1.0f, 1.0f}, n}
+    };
+    m.indices = { 0, 2, 1 };
+}
+
+// Write this frame's camera and light into the uniform ring; returns their dynamic offsets
+vector<uint32_t> updateUniforms(VulkanUniformRing &ring, SwapChainData &swapChainData, int gridSize) {
+    CameraUniforms camera;
+    camera.viewMat = glm::lookAt(glm::vec3(0.0f, 0.0f, (float)gridSize), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    float aspect = (float)swapChainData.extents.width / (float)max(1u, swapChainData.extents.height);
+    camera.projMat = glm::perspective(glm::radians(60.0f), aspect, 0.1f, 4.0f*gridSize);
+    camera.projMat[1][1] *= -1.0f;     // Vulkan's clip space Y points down
+
+    LightUniforms light;
+    light.pos = camera.viewMat * glm::vec4(0.0f, 0.0f, 4.0f, 1.0f);
+    light.color = glm::vec4(1.0f);
+
+    uint32_t cameraOffset = pushVulkanUniformData(ring, &camera, sizeof(camera));
+    uint32_t lightOffset = pushVulkanUniformData(ring, &light, sizeof(light));
+    return { cameraOffset, lightOffset };
+}
+
+// Record grid cells [first, last) into one secondary command buffer
+void recordDraws(vk::CommandBuffer &commandBuffer, int first, int last,
+                    SwapChainData &swapChainData, PipelineData &pipelineData,
+                    VulkanUniformRing &uniformRing, const vector<uint32_t> &uniformOffsets,
+                    VulkanMesh &mesh, int gridSize, float time) {
+    // Secondary command buffers don't inherit any state, so set everything up again
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelineData.graphicsPipeline);
+
+    // Viewport and scissor are dynamic, so they follow the swap chain size
+    vk::Viewport viewport(0, 0, (float)swapChainData.extents.width, (float)swapChainData.extents.height, 0.0f, 1.0f);
+    commandBuffer.setViewport(0, viewport);
+    vk::Rect2D scissor({0,0}, swapChainData.extents);
+    commandBuffer.setScissor(0, scissor);
+
+    // Camera and light are bound once; each copy only pushes its model matrix
+    bindVulkanUniformRing(commandBuffer, pipelineData.pipelineLayout, uniformRing, uniformOffsets);
+    bindVulkanMesh(commandBuffer, mesh);
+    for(int i = first; i < last; i++) {
+        int x = i % gridSize;
+        int y = i / gridSize;
+        glm::vec3 pos(x - (gridSize - 1)*0.5f, y - (gridSize - 1)*0.5f, 0.0f);
+        glm::mat4 modelMat = glm::translate(glm::mat4(1.0f), pos);
+        modelMat = glm::rotate(modelMat, time + 0.1f*(x + y), glm::vec3(0.0f, 0.0f, 1.0f));
+        pushVulkanDrawConstants(commandBuffer, pipelineData.pipelineLayout, modelMat);
+        drawBoundVulkanMesh(commandBuffer, mesh);
+    }
+}
+
+void recordCommandBuffer(vk::CommandBuffer &commandBuffer,
+                        vk::RenderPass &renderPass, vk::Framebuffer &framebuffer,
+                        SwapChainData &swapChainData, vk::Device &device,
+                        ThreadPool &threadPool, VulkanParallelRecorder &recorder,
+                        uint32_t frameIndex, int threadCnt,
+                        int drawCnt, VulkanRecordFunc recordFunc) {
+    vk::ClearValue clearColor(vk::ClearColorValue(array<float, 4>({0.0f, 0.0f, 0.2f, 1.0f})));
+    vk::RenderPassBeginInfo renderPassInfo(renderPass, framebuffer,
+                                            vk::Rect2D({0,0}, swapChainData.extents),
+                                            clearColor);
+
+    // All draws come from secondary command buffers recorded in parallel
+    commandBuffer.beginRenderPass(renderPassInfo, vk::SubpassContents::eSecondaryCommandBuffers);
+    recordVulkanSecondaries(device, threadPool, recorder, commandBuffer, frameIndex, threadCnt,
+                            renderPass, framebuffer, drawCnt, recordFunc);
+    commandBuffer.endRenderPass();
+}
+
 int main(int argc, char **argv) {
+    cout << "BEGIN VULKAN ADVENTURE!" << endl;
+
+    // Options: --grid N (N*N draws), --record-threads N, --record-bench (time 1..N threads, then exit)
+    int gridSize = DEFAULT_GRID_SIZE;
+    int maxThreadCnt = getDefaultThreadCount();
+    bool recordBench = false;
+    for(int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if(arg == "--grid" && i + 1 < argc) {
+            gridSize = max(1, atoi(argv[++i]));
+        }
+        else if(arg == "--record-threads" && i + 1 < argc) {
+            maxThreadCnt = max(1, atoi(argv[++i]));
+        }
+        else if(arg == "--record-bench") {
+            recordBench = true;
+        }
+    }
+    int drawCnt = gridSize*gridSize;
+    cout << "Drawing " << drawCnt << " objects with up to " << maxThreadCnt << " recording threads" << endl;
+
+    GLFWwindow *window = createVulkanWindow("BasicVulkanHpp", 800, 600, true);
+
+    try {
+        // Instance, surface and device
+        vk::Instance instance = createVulkanInstance("BasicVulkanHpp", "No Engine", validationLayers);
+        vk::SurfaceKHR surface = createVulkanSurface(instance, window);
+        vk::PhysicalDevice physicalDevice = pickFirstVulkanPhysicalDevice(instance);
+        cout << "Using device: " << getVulkanPhysicalDeviceName(physicalDevice) << endl;
+
+        QueueFamilyIndices indices = findQueueFamilies(physicalDevice, surface);
+        vk::Device device = createVulkanLogicalDevice(instance, physicalDevice, indices, validationLayers);
+        vk::Queue graphicsQueue = device.getQueue(indices.graphicsFamily.value(), 0);
+        vk::Queue presentQueue = device.getQueue(indices.presentFamily.value(), 0);
+
+        // Swap chain, render pass, pipeline and framebuffers
+        SwapChainData swapChainData = createSwapChainData(window, physicalDevice, device, surface, indices);
+        vk::RenderPass renderPass = createVulkanRenderPass(device, swapChainData);
+
+        // Buffers are sub-allocated from a few large memory blocks
+        VulkanAllocator allocator = createVulkanAllocator(physicalDevice, device);
+
+        // Camera (binding 0) and light (binding 1) live in a per-frame uniform ring
+        // (one region per frame in flight; the frame loop and recorder use the same count)
+        const int framesInFlight = MAX_FRAMES_IN_FLIGHT;
+        VulkanUniformRing uniformRing = createVulkanUniformRing(allocator, 64*1024,
+                                            { sizeof(CameraUniforms), sizeof(LightUniforms) },
+                                            vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
+                                            framesInFlight);
+
+        // Pipeline cache survives between runs, so only the first launch compiles from scratch
+        VulkanPipelineCache pipelineCache = createVulkanPipelineCache(physicalDevice, device, "./BasicVulkanHpp");
+        PipelineData pipelineData = createGraphicsPipelineData(device, swapChainData, renderPass,
+                                        "./build/compiledshaders/BasicVulkanHpp/shader.vert.spv",
+                                        "./build/compiledshaders/BasicVulkanHpp/shader.frag.spv",
+                                        pipelineCache.cache,
+                                        { uniformRing.setLayout },
+                                        { getVulkanDrawConstantsRange() });
+        vector<vk::Framebuffer> framebuffers = createVulkanFramebuffers(device, swapChainData, renderPass);
+
+        // Geometry goes to device-local memory through a staging buffer
+        VulkanUploadContext upload = createVulkanUploadContext(physicalDevice, device, indices, true, &allocator);
+        HostMesh hostMesh;
+        createTriangle(hostMesh);
+        VulkanMesh mesh = createVulkanMeshDeviceLocal(upload, hostMesh);
+        flushVulkanUploads(upload);
+        printVulkanMemoryStats(allocator);
+
+        // Frames in flight, each with its own command buffer and sync objects
+        VulkanFrameLoop frameLoop = createVulkanFrameLoop(device, indices, swapChainData, framesInFlight);
+        watchVulkanWindowResize(window, frameLoop);
+
+        // Each recording thread gets its own command pools and secondary command buffers
+        ThreadPool threadPool;
+        createThreadPool(threadPool, maxThreadCnt);
+        VulkanParallelRecorder recorder = createVulkanParallelRecorder(device, indices, maxThreadCnt, framesInFlight);
+
+        // Benchmark steps through 1..maxThreadCnt threads; otherwise always use all of them
+        int threadCnt = recordBench ? 1 : maxThreadCnt;
+        int benchFrameCnt = 0;
+        double benchRecordMS = 0.0;
+        vector<double> benchResults;
+
+        double reportMS = 0.0;
+        auto startTime = chrono::steady_clock::now();
+        while(!glfwWindowShouldClose(window)) {
+            glfwPollEvents();
+
+            if(!beginVulkanFrame(device, swapChainData, frameLoop)) {
+                recreateVulkanSwapChain(window, physicalDevice, device, surface, indices,
+                                        swapChainData, renderPass, framebuffers, frameLoop);
+                continue;
+            }
+
+            // This frame's fence has signaled, so its uniform region is free again
+            beginVulkanUniformFrame(uniformRing, frameLoop.currentFrame);
+            vector<uint32_t> uniformOffsets = updateUniforms(uniformRing, swapChainData, gridSize);
+            float time = chrono::duration<float>(chrono::steady_clock::now() - startTime).count();
+
+            VulkanRecordFunc recordFunc = [&](vk::CommandBuffer &secondary, int first, int last) {
+                recordDraws(secondary, first, last, swapChainData, pipelineData,
+                            uniformRing, uniformOffsets, mesh, gridSize, time);
+            };
+
+            vk::CommandBuffer &commandBuffer = getVulkanFrameCommandBuffer(frameLoop);
+            recordCommandBuffer(commandBuffer, renderPass, framebuffers.at(frameLoop.imageIndex),
+                                swapChainData, device, threadPool, recorder,
+                                frameLoop.currentFrame, threadCnt, drawCnt, recordFunc);
+
+            if(!endVulkanFrame(device, graphicsQueue, presentQueue, swapChainData, frameLoop)) {
+                recreateVulkanSwapChain(window, physicalDevice, device, surface, indices,
+                                        swapChainData, renderPass, framebuffers, frameLoop);
+            }
+
+            // Average recording time per thread count, skipping warmup frames
+            if(recordBench) {
+                benchFrameCnt++;
+                if(benchFrameCnt > RECORD_BENCH_WARMUP) {
+                    benchRecordMS += frameLoop.timings.recordMS;
+                }
+                if(benchFrameCnt == RECORD_BENCH_WARMUP + RECORD_BENCH_FRAMES) {
+                    benchResults.push_back(benchRecordMS / RECORD_BENCH_FRAMES);
+                    benchFrameCnt = 0;
+                    benchRecordMS = 0.0;
+                    threadCnt++;
+                    if(threadCnt > maxThreadCnt) break;
+                }
+                continue;
+            }
+
+            // Print timings about once a second
+            VulkanFrameTimings &t = frameLoop.timings;
+            reportMS += t.frameMS;
+            if(reportMS >= 1000.0) {
+                cout << "FRAME: " << t.frameMS << " ms (fence " << t.fenceWaitMS;
+                cout << ", acquire " << t.acquireMS << ", record " << t.recordMS;
+                cout << ", submit " << t.submitMS << ")" << endl;
+                reportMS = 0.0;
+            }
+        }
+
+        if(!benchResults.empty()) {
+            cout << "RECORD BENCHMARK (" << drawCnt << " draws):" << endl;
+            cout << "threads,recordMS,speedup" << endl;
+            for(size_t i = 0; i < benchResults.size(); i++) {
+                cout << (i + 1) << "," << benchResults[i] << "," << (benchResults[0] / benchResults[i]) << endl;
+            }
+        }
+
+        // Waits for the device to go idle first
+        cleanupVulkanFrameLoop(device, frameLoop);
+        cleanupVulkanParallelRecorder(device, recorder);
+        cleanupThreadPool(threadPool);
+
+        cleanupVulkanMesh(device, mesh);
+        cleanupVulkanUniformRing(device, uniformRing);
+        cleanupVulkanUploadContext(upload);
+        cleanupVulkanAllocator(allocator);
+        cleanupVulkanFramebuffers(device, framebuffers);
+        cleanupGraphicsPipelineData(device, pipelineData);
+        cleanupVulkanPipelineCache(device, pipelineCache);
+        cleanupVulkanRenderPass(device, renderPass);
+        cleanupSwapChainData(device, swapChainData);
+        cleanupVulkanLogicalDevice(device);
+        cleanupVulkanSurface(instance, surface);
+        cleanupVulkanInstance(instance);
+    }
+    catch(exception &e) {
+        cerr << "ERROR: " << e.what() << endl;
+        cleanupVulkanWindow(window);
+        return 1;
+    }
+
+    cleanupVulkanWindow(window);
+
     return 0;
-}
\ No newline at end of file
+}
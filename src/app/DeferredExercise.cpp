@@ -5,6 +5,7 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include "Shader.hpp"
+#include "FramePacer.hpp"
 #include "MeshData.hpp"
 #include "MeshGLData.hpp"
 #include "glm/glm.hpp"
@@ -490,7 +491,8 @@ int main(int argc, char **argv) {
     }
 
     glfwMakeContextCurrent(window);
-    glfwSwapInterval(1);
+    FramePacer pacer;
+    createFramePacer(pacer, window);
 
     double mx, my;
     glfwGetCursorPos(window, &mx, &my);
@@ -688,9 +690,9 @@ int main(int argc, char **argv) {
 
         glUseProgram(0);
 
-        glfwSwapBuffers(window);
+        swapFrameBuffers(pacer, window);
         glfwPollEvents();
-        this_thread::sleep_for(chrono::milliseconds(15));
+        waitForNextFrame(pacer);
     }
 
     gb.cleanup();
@@ -4,6 +4,7 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <Shader.hpp>
+#include <FramePacer.hpp>
 #include <vector>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -46,7 +47,8 @@ int main(int argc, char ** argv)
     }
 
     glfwMakeContextCurrent(window);
-    glfwSwapInterval(1);
+    FramePacer pacer;
+    createFramePacer(pacer, window);
 
     glewExperimental = true;
     GLenum err = glewInit();
@@ -134,9 +136,9 @@ int main(int argc, char ** argv)
         glBindVertexArray(0);
         glUseProgram(0);
 
-        glfwSwapBuffers(window);
+        swapFrameBuffers(pacer, window);
         glfwPollEvents();
-        this_thread::sleep_for(chrono::milliseconds(15));
+        waitForNextFrame(pacer);
     }
 
     glBindVertexArray(0);
@@ -5,7 +5,9 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include "Shader.hpp"
+#include "FramePacer.hpp"
 #include "MeshData.hpp"
+#include "TextureStreamGL.hpp"
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #define GLM_ENABLE_EXPERIMENTAL
@@ -14,8 +16,6 @@
 #include "glm/gtc/type_ptr.hpp"
 #include "glm/gtc/quaternion.hpp"
 #include "glm/gtx/quaternion.hpp"
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
 using namespace std;
 
 glm::quat startRot = glm::quat(glm::radians(glm::vec3(70, 32, 23)));
@@ -253,55 +253,6 @@ void makeCylinder(Mesh &m, float length, float radius, int faceCnt)
     computeAllNormals(m);
 }
 
-unsigned int loadAndCreateTexture(string filename)
-{
-    int texWidth, texHeight, texComponents;
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char* imageData = stbi_load(filename.c_str(),
-                                            &texWidth,
-                                            &texHeight,
-                                            &texComponents, 0);
-    unsigned int texID = 0;
-    if (imageData)
-    {
-        glGenTextures(1, &texID);
-        GLenum format;
-        if (texComponents == 3)
-        {
-            format = GL_RGB;
-            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-        }
-        else
-        {
-            format = GL_RGBA;
-        }
-        glBindTexture(GL_TEXTURE_2D, texID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, texWidth, 
-                    texHeight, 0, format, GL_UNSIGNED_BYTE, imageData);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        glTexParameteri(GL_TEXTURE_2D, 
-                        GL_TEXTURE_WRAP_S, 
-                        GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, 
-                        GL_TEXTURE_WRAP_T, 
-                        GL_REPEAT);
-        glBindTexture(GL_TEXTURE_2D, 0);
-
-        stbi_image_free(imageData);
-    }
-    else
-    {
-        cerr << "ERROR: Texture ccould not load!" << endl;
-        glfwTerminate();
-        exit(1);
-    }
-
-    return texID;
-}
-
 int main(int argc, char **argv) {
     cout << "BEGIN OPENGL ADVENTURE!" << endl;
 
@@ -351,7 +302,8 @@ int main(int argc, char **argv) {
     }
 
     glfwMakeContextCurrent(window);
-    glfwSwapInterval(1);
+    FramePacer pacer;
+    createFramePacer(pacer, window);
 
     double mx, my;
     glfwGetCursorPos(window, &mx, &my);
@@ -408,13 +360,11 @@ int main(int argc, char **argv) {
     GLint lightPosLoc = glGetUniformLocation(progID, "light.pos");
     GLint lightColorLoc = glGetUniformLocation(progID, "light.color");
 
-    unsigned int diffTexID = loadAndCreateTexture("test.png");
-    unsigned int normTexID = loadAndCreateTexture("normal.png");
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, diffTexID);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, normTexID);
+    // Decoded off-thread and uploaded a few MB per frame; a gray placeholder stands in until then
+    TextureStreamer texStreamer;
+    createTextureStreamer(texStreamer);
+    int diffTexHandle = requestTexture(texStreamer, "test.png", TEXTURE_COMPRESSION_BC1);
+    int normTexHandle = requestTexture(texStreamer, "normal.png", TEXTURE_COMPRESSION_BC5);
 
     GLint diffuseTexLoc = glGetUniformLocation(progID, "diffuseTexture");
     GLint normalTexLoc = glGetUniformLocation(progID, "normalTexture");
@@ -517,6 +467,7 @@ int main(int argc, char **argv) {
     light.pos = glm::vec4(0, 20, 0, 1.0);
 
     while(!glfwWindowShouldClose(window)) {
+        updateTextureStreamer(texStreamer);
         glfwGetFramebufferSize(window, &frameWidth, &frameHeight);
         float aspect = 1.0f;
         if(frameHeight > 0) {
@@ -544,6 +495,12 @@ int main(int argc, char **argv) {
         glUniform4fv(lightPosLoc, 1, glm::value_ptr(lightPos));
         glUniform4fv(lightColorLoc, 1, glm::value_ptr(light.color));
 
+        // Rebound each frame: the streamed IDs change once the first mip lands
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, getStreamedTexture(texStreamer, diffTexHandle));
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, getStreamedTexture(texStreamer, normTexHandle));
+
         glUniform1i(diffuseTexLoc, 0);
         glUniform1i(normalTexLoc, 1);
 
@@ -553,9 +510,9 @@ int main(int argc, char **argv) {
         glBindVertexArray(0);
         glUseProgram(0);
 
-        glfwSwapBuffers(window);
+        swapFrameBuffers(pacer, window);
         glfwPollEvents();
-        this_thread::sleep_for(chrono::milliseconds(15));
+        waitForNextFrame(pacer);
     }
 
     glActiveTexture(GL_TEXTURE0);
@@ -563,8 +520,7 @@ int main(int argc, char **argv) {
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, 0);
 
-    glDeleteTextures(1, &diffTexID);
-    glDeleteTextures(1, &normTexID);
+    cleanupTextureStreamer(texStreamer);
 
     glBindVertexArray(0);
     glDeleteVertexArrays(1, &VAO);
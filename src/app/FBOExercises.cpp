@@ -5,16 +5,16 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include "Shader.hpp"
+#include "FramePacer.hpp"
 #include "MeshData.hpp"
 #include "MeshGLData.hpp"
+#include "TextureStreamGL.hpp"
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #define GLM_ENABLE_EXPERIMENTAL
 #include "glm/gtx/string_cast.hpp"
 #include "glm/gtx/transform.hpp"
 #include "glm/gtc/type_ptr.hpp"
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
 using namespace std;
 
 glm::mat4 modelMat(1.0);
@@ -300,53 +300,6 @@ void makeCylinder(Mesh &m, float length, float radius, int faceCnt) {
     computeAllNormals(m);
 }
 
-unsigned int loadAndCreateTexture(string filename) {
-    
-    int texWidth, texHeight, texComponents;
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char *imageData = stbi_load(filename.c_str(), 
-                                            &texWidth, 
-                                            &texHeight, 
-                                            &texComponents, 0);
-    unsigned int texID = 0;
-    if(imageData) {
-        glGenTextures(1, &texID);
-        GLenum format;
-        if(texComponents == 3) {
-            format = GL_RGB;
-            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-        }
-        else {
-            format = GL_RGBA;
-        }
-        glBindTexture(GL_TEXTURE_2D, texID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, texWidth, texHeight, 0,
-                            format, GL_UNSIGNED_BYTE, imageData);
-        
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        glTexParameteri(GL_TEXTURE_2D, 
-                        GL_TEXTURE_WRAP_S,
-                        GL_REPEAT); 
-                        //GL_MIRRORED_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, 
-                        GL_TEXTURE_WRAP_T, 
-                        GL_REPEAT);
-                        //GL_MIRRORED_REPEAT);
-        glBindTexture(GL_TEXTURE_2D, 0);
-
-        stbi_image_free(imageData);
-    }
-    else {
-        cerr << "ERROR: Texture could not load!" << endl;
-        glfwTerminate();
-        exit(1);
-    }
-
-    return texID;
-}
-
 GLuint loadAndCreateShaderProgram(string vertFile, string fragFile) {
     
     string vertCode = readFileToString(vertFile);
@@ -430,7 +383,8 @@ int main(int argc, char **argv) {
     }
 
     glfwMakeContextCurrent(window);
-    glfwSwapInterval(1);
+    FramePacer pacer;
+    createFramePacer(pacer, window);
 
     double mx, my;
     glfwGetCursorPos(window, &mx, &my);
@@ -473,8 +427,11 @@ int main(int argc, char **argv) {
     FBO fbo;
     createFBO(fbo, frameWidth, frameHeight);
 
-    unsigned int diffTexID = loadAndCreateTexture("test.png");
-    unsigned int normTexID = loadAndCreateTexture("normal.png");
+    // Decoded off-thread and uploaded a few MB per frame; a gray placeholder stands in until then
+    TextureStreamer texStreamer;
+    createTextureStreamer(texStreamer);
+    int diffTexHandle = requestTexture(texStreamer, "test.png", TEXTURE_COMPRESSION_BC1);
+    int normTexHandle = requestTexture(texStreamer, "normal.png", TEXTURE_COMPRESSION_BC5);
 
     GLint diffuseTexLoc = glGetUniformLocation(progID, "diffuseTexture");
     GLint normalTexLoc = glGetUniformLocation(progID, "normalTexture");
@@ -546,6 +503,8 @@ int main(int argc, char **argv) {
 
     while(!glfwWindowShouldClose(window)) {
 
+        updateTextureStreamer(texStreamer);
+
         //first pass
         glBindFramebuffer(GL_FRAMEBUFFER, fbo.ID);
 
@@ -577,9 +536,9 @@ int main(int argc, char **argv) {
         glUniform4fv(lightColorLoc, 1, glm::value_ptr(light.color));
 
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, diffTexID);
+        glBindTexture(GL_TEXTURE_2D, getStreamedTexture(texStreamer, diffTexHandle));
         glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, normTexID);
+        glBindTexture(GL_TEXTURE_2D, getStreamedTexture(texStreamer, normTexHandle));
 
         glUniform1i(diffuseTexLoc, 0);
         glUniform1i(normalTexLoc, 1);
@@ -608,9 +567,9 @@ int main(int argc, char **argv) {
 
         glUseProgram(0);
 
-        glfwSwapBuffers(window);
+        swapFrameBuffers(pacer, window);
         glfwPollEvents();
-        this_thread::sleep_for(chrono::milliseconds(15));
+        waitForNextFrame(pacer);
     }
 
     glDeleteFramebuffers(1, &(fbo.ID));
@@ -619,8 +578,7 @@ int main(int argc, char **argv) {
     glBindTexture(GL_TEXTURE_2D, 0);
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, 0);
-    glDeleteTextures(1, &diffTexID);
-    glDeleteTextures(1, &normTexID);
+    cleanupTextureStreamer(texStreamer);
 
     cleanupMesh(mainGL);
     cleanupMesh(quadGL);
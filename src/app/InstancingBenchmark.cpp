@@ -0,0 +1,351 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cfloat>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "glm/glm.hpp"
+#include "MeshData.hpp"
+#include "MeshGLData.hpp"
+#include "MeshExtract.hpp"
+#include "GLSetup.hpp"
+#include "Shader.hpp"
+#include "FramePacer.hpp"
+#include "GPUProfiler.hpp"
+#include "Benchmark.hpp"
+#include "ThreadPool.hpp"
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include "glm/gtc/matrix_transform.hpp"
+#define GLM_ENABLE_EXPERIMENTAL
+#include "glm/gtx/transform.hpp"
+#include "glm/gtc/type_ptr.hpp"
+
+using namespace std;
+
+// Draws the same mesh many times, three ways:
+//	1: one drawMesh() per instance with a uniform (the old way)
+//	2: one instanced draw, matrices as a per-instance vertex attribute
+//	3: one instanced draw, matrices read from an SSBO
+// Extra options (besides the --bench-* ones):
+//	--instances <N>				Instance count (default 100000)
+//	--mode loop|attrib|ssbo		Starting mode
+//	--animate					Rebuild and upload every matrix each frame
+//	<model>						Mesh to repeat (default sampleModels/Duck.glb)
+enum InstanceDrawMode
+{
+	INSTANCE_DRAW_LOOP,
+	INSTANCE_DRAW_ATTRIBUTE,
+	INSTANCE_DRAW_SSBO,
+	INSTANCE_DRAW_MODE_CNT
+};
+
+string instanceDrawModeNames[INSTANCE_DRAW_MODE_CNT] = { "loop", "attrib", "ssbo" };
+
+InstanceDrawMode drawMode = INSTANCE_DRAW_ATTRIBUTE;
+bool animateInstances = false;
+
+static void key_callback(GLFWwindow *window,
+                        int key, int scancode,
+                        int action, int mods)
+{
+	if (action != GLFW_PRESS) return;
+
+	if (key == GLFW_KEY_ESCAPE)
+	{
+		glfwSetWindowShouldClose(window, true);
+	}
+	else if (key >= GLFW_KEY_1 && key < GLFW_KEY_1 + INSTANCE_DRAW_MODE_CNT)
+	{
+		drawMode = (InstanceDrawMode)(key - GLFW_KEY_1);
+		cout << "Draw mode: " << instanceDrawModeNames[drawMode] << endl;
+	}
+	else if (key == GLFW_KEY_U)
+	{
+		animateInstances = !animateInstances;
+		cout << "Animate instances: " << (animateInstances ? "ON" : "OFF") << endl;
+	}
+}
+
+// All meshes of the model as one (node transforms are ignored; each copy is normalized anyway)
+void mergeMeshes(vector<Mesh> &allMeshes, Mesh &merged)
+{
+	merged.vertices.clear();
+	merged.indices.clear();
+	for (Mesh &m : allMeshes)
+	{
+		unsigned int base = (unsigned int)merged.vertices.size();
+		merged.vertices.insert(merged.vertices.end(), m.vertices.begin(), m.vertices.end());
+		for (unsigned int index : m.indices)
+			merged.indices.push_back(base + index);
+	}
+}
+
+// Transform that centers the mesh and scales it to a radius of 0.5
+glm::mat4 getUnitMeshTransform(Mesh &m)
+{
+	glm::vec3 minPos(FLT_MAX);
+	glm::vec3 maxPos(-FLT_MAX);
+	for (Vertex &v : m.vertices)
+	{
+		minPos = glm::min(minPos, v.position);
+		maxPos = glm::max(maxPos, v.position);
+	}
+	glm::vec3 center = 0.5f * (minPos + maxPos);
+	float radius = max(0.5f * glm::length(maxPos - minPos), 0.0001f);
+	return glm::scale(glm::vec3(0.5f / radius)) * glm::translate(-center);
+}
+
+// Copies on a cubic grid, each spun around its own axis
+// (parallelFor hands each thread a contiguous run of instances, not one task per matrix)
+void buildInstanceMatrices(vector<glm::mat4> &modelMats, int instanceCnt, float spacing,
+							const glm::mat4 &unitMat, float time, ThreadPool &pool)
+{
+	modelMats.resize(instanceCnt);
+	int side = max(1, (int)ceil(cbrt((double)instanceCnt)));
+	float offset = 0.5f * spacing * (side - 1);
+
+	parallelFor(pool, instanceCnt, [&](int i)
+	{
+		int x = i % side;
+		int y = (i / side) % side;
+		int z = i / (side * side);
+		glm::vec3 pos = glm::vec3(x, y, z) * spacing - glm::vec3(offset);
+
+		// Golden-ratio spread of starting angles so neighbors don't line up
+		float angle = (float)i * 2.39996f + time;
+		glm::vec3 axis = glm::normalize(glm::vec3(0.3f, 1.0f, 0.2f * (float)(i % 7)));
+		modelMats[i] = glm::translate(pos) * glm::rotate(angle, axis) * unitMat;
+	});
+}
+
+int main(int argc, char **argv)
+{
+	BenchmarkSettings benchSettings;
+	vector<string> otherArgs;
+	if (!parseBenchmarkArgs(argc, argv, benchSettings, otherArgs)) exit(EXIT_FAILURE);
+
+	int instanceCnt = 100000;
+	string modelPath = "sampleModels/Duck.glb";
+	for (int i = 0; i < (int)otherArgs.size(); i++)
+	{
+		string arg = otherArgs[i];
+		bool hasValue = (i + 1 < (int)otherArgs.size());
+		if (arg == "--instances" && hasValue)
+			instanceCnt = max(1, atoi(otherArgs[++i].c_str()));
+		else if (arg == "--mode" && hasValue)
+		{
+			string mode = otherArgs[++i];
+			for (int m = 0; m < INSTANCE_DRAW_MODE_CNT; m++)
+			{
+				if (mode == instanceDrawModeNames[m])
+					drawMode = (InstanceDrawMode)m;
+			}
+		}
+		else if (arg == "--animate")
+			animateInstances = true;
+		else
+			modelPath = arg;
+	}
+
+	// Are we in debugging mode? (never while benchmarking)
+	bool DEBUG_MODE = !benchSettings.enabled;
+
+	GLFWwindow* window = NULL;
+	if (benchSettings.enabled)
+		window = setupGLFWHeadless("InstancingBenchmark", 4, 3, benchSettings.width, benchSettings.height, DEBUG_MODE);
+	else
+		window = setupGLFW("InstancingBenchmark", 4, 3, 1280, 720, DEBUG_MODE);
+
+	setupGLEW(window, benchSettings.enabled);
+	checkOpenGLVersion();
+	if (DEBUG_MODE) checkAndSetupOpenGLDebugging();
+
+	glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
+	glfwSetKeyCallback(window, key_callback);
+
+	// Same shaders, three ways of getting the model matrix
+	ShaderCache shaders;
+	createShaderCache(shaders);
+	int programs[INSTANCE_DRAW_MODE_CNT];
+	try
+	{
+		vector<string> files = { "./shaders/InstancingBenchmark/Instanced.vs",
+									"./shaders/InstancingBenchmark/Instanced.fs" };
+		programs[INSTANCE_DRAW_LOOP] = loadShaderProgram(shaders, files);
+		programs[INSTANCE_DRAW_ATTRIBUTE] = loadShaderProgram(shaders, files, "#define INSTANCE_ATTRIBUTE\n");
+		programs[INSTANCE_DRAW_SSBO] = loadShaderProgram(shaders, files, "#define INSTANCE_SSBO\n");
+	}
+	catch (exception e)
+	{
+		cleanupGLFW(window);
+		exit(EXIT_FAILURE);
+	}
+
+	glEnable(GL_DEPTH_TEST);
+
+	// Load the model once; every instance shares its buffers
+	Mesh mesh;
+	{
+		Assimp::Importer importer;
+		unsigned int flags = aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_JoinIdenticalVertices;
+		const aiScene *scene = importer.ReadFile(modelPath, flags);
+		if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+		{
+			cerr << "Error: " << importer.GetErrorString() << endl;
+			cleanupGLFW(window);
+			exit(EXIT_FAILURE);
+		}
+
+		ThreadPool pool;
+		createThreadPool(pool);
+		vector<Mesh> allMeshes;
+		extractAllMeshData(scene, allMeshes, pool, glm::vec4(0.9, 0.7, 0.2, 1.0));
+		cleanupThreadPool(pool);
+		mergeMeshes(allMeshes, mesh);
+	}
+
+	MeshGL mgl;
+	createMeshGL(mesh, mgl, VERTEX_FORMAT_PACKED);
+	glm::mat4 unitMat = getUnitMeshTransform(mesh);
+
+	// Matrix building is spread over the pool (it matters when animating)
+	ThreadPool pool;
+	createThreadPool(pool);
+	float spacing = 1.5f;
+	vector<glm::mat4> modelMats;
+	buildInstanceMatrices(modelMats, instanceCnt, spacing, unitMat, 0.0f, pool);
+
+	InstanceBufferGL instances;
+	createInstanceBufferGL(instances, instanceCnt);
+	updateInstanceBufferGL(instances, modelMats.data(), instanceCnt);
+	attachInstanceBuffer(mgl, instances);
+
+	int side = max(1, (int)ceil(cbrt((double)instanceCnt)));
+	float sceneRadius = 0.87f * spacing * side;
+	cout << "Instances: " << instanceCnt << " x " << (mgl.indexCnt / 3) << " triangles ("
+		<< ((double)instanceCnt * mgl.indexCnt / 3.0e6) << " M per frame)" << endl;
+	cout << "Draw mode: " << instanceDrawModeNames[drawMode] << " (1/2/3 to switch, U to animate)" << endl;
+
+	FramePacer pacer;
+	createFramePacer(pacer, window);
+
+	GPUProfiler gpuProf;
+	createGPUProfiler(gpuProf, 240, benchSettings.enabled ? 0 : 300);
+
+	BenchmarkRun bench;
+	if (benchSettings.enabled)
+	{
+		createBenchmarkRun(bench, benchSettings);
+		setFramePacingMode(pacer, FRAME_PACING_UNCAPPED);
+	}
+
+	// CPU time spent building, uploading and submitting (per frame)
+	double cpuSubmitTotalMS = 0.0;
+	int cpuSubmitFrames = 0;
+	double cpuBuildTotalMS = 0.0;	// Matrix rebuild (--animate), kept out of the submit time
+	int cpuBuildFrames = 0;
+
+	while (!glfwWindowShouldClose(window))
+	{
+		if (benchSettings.enabled && isBenchmarkDone(bench)) break;
+
+		int fwidth, fheight;
+		glm::vec3 eye, lookAt;
+		if (benchSettings.enabled)
+		{
+			beginBenchmarkFrame(bench);
+			fwidth = bench.target.width;
+			fheight = bench.target.height;
+			getBenchmarkCamera(bench, glm::vec3(0,0,0), 1.2f * sceneRadius, eye, lookAt);
+		}
+		else
+		{
+			glfwGetFramebufferSize(window, &fwidth, &fheight);
+			float angle = 0.2f * (float)glfwGetTime();
+			eye = 1.2f * sceneRadius * glm::vec3(sin(angle), 0.3f, cos(angle));
+			lookAt = glm::vec3(0,0,0);
+		}
+		glViewport(0, 0, fwidth, fheight);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		float aspectRatio = (fwidth > 0 && fheight > 0) ? (float)fwidth / (float)fheight : 1.0f;
+		glm::mat4 viewMat = glm::lookAt(eye, lookAt, glm::vec3(0,1,0));
+		glm::mat4 projMat = glm::perspective(glm::radians(60.0f), aspectRatio, 0.1f, 4.0f * sceneRadius);
+
+		int handle = programs[drawMode];
+		glUseProgram(getShaderProgramID(shaders, handle));
+		glUniformMatrix4fv(getShaderUniform(shaders, handle, "viewMat"), 1, false, glm::value_ptr(viewMat));
+		glUniformMatrix4fv(getShaderUniform(shaders, handle, "projMat"), 1, false, glm::value_ptr(projMat));
+
+		if (animateInstances)
+		{
+			auto buildStart = chrono::steady_clock::now();
+			buildInstanceMatrices(modelMats, instanceCnt, spacing, unitMat, (float)glfwGetTime(), pool);
+			cpuBuildTotalMS += chrono::duration<double, milli>(chrono::steady_clock::now() - buildStart).count();
+			cpuBuildFrames++;
+		}
+
+		auto cpuStart = chrono::steady_clock::now();
+		beginGPUTimer(gpuProf, "Instances");
+
+		if (animateInstances && drawMode != INSTANCE_DRAW_LOOP)
+			updateInstanceBufferGL(instances, modelMats.data(), instanceCnt);
+
+		if (drawMode == INSTANCE_DRAW_LOOP)
+		{
+			GLint modelMatLoc = getShaderUniform(shaders, handle, "modelMat");
+			for (int i = 0; i < instanceCnt; i++)
+			{
+				glUniformMatrix4fv(modelMatLoc, 1, false, glm::value_ptr(modelMats[i]));
+				drawMesh(mgl);
+			}
+		}
+		else if (drawMode == INSTANCE_DRAW_ATTRIBUTE)
+			drawMeshInstanced(mgl, instances);
+		else
+			drawMeshInstancedSSBO(mgl, instances);
+
+		endGPUTimer(gpuProf);
+		cpuSubmitTotalMS += chrono::duration<double, milli>(chrono::steady_clock::now() - cpuStart).count();
+		cpuSubmitFrames++;
+		endGPUProfilerFrame(gpuProf);
+		glUseProgram(0);
+
+		if (benchSettings.enabled)
+			endBenchmarkFrame(bench);
+		else
+			swapFrameBuffers(pacer, window);
+		glfwPollEvents();
+
+		if (!benchSettings.enabled)
+			reloadChangedShaders(shaders);
+		waitForNextFrame(pacer);
+	}
+
+	cout << "CPU submit (avg): " << (cpuSubmitTotalMS / max(1, cpuSubmitFrames)) << " ms" << endl;
+	if (cpuBuildFrames > 0)
+		cout << "CPU matrix build (avg): " << (cpuBuildTotalMS / cpuBuildFrames) << " ms" << endl;
+	printGPUProfilerStats(gpuProf);
+	if (benchSettings.enabled)
+	{
+		finishBenchmark(bench, modelPath + " x" + to_string(instanceCnt) + " (" + instanceDrawModeNames[drawMode]
+							+ (animateInstances ? ", animated)" : ")"));
+		cleanupBenchmarkRun(bench);
+	}
+
+	cleanupGPUProfiler(gpuProf);
+	cleanupInstanceBufferGL(instances);
+	cleanupMesh(mgl);
+	cleanupThreadPool(pool);
+	cleanupShaderCache(shaders);
+	cleanupGLFW(window);
+
+	return 0;
+}
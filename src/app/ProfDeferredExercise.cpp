@@ -1,20 +1,24 @@
 #include <iostream>
 #include <cstring>
+#include <random>
 #include <thread>
 #include <vector>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include "Shader.hpp"
+#include "FramePacer.hpp"
+#include "GPUProfiler.hpp"
 #include "MeshData.hpp"
 #include "MeshGLData.hpp"
+#include "LightCullingGL.hpp"
+#include "UniformRingGL.hpp"
+#include "TextureStreamGL.hpp"
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #define GLM_ENABLE_EXPERIMENTAL
 #include "glm/gtx/string_cast.hpp"
 #include "glm/gtx/transform.hpp"
 #include "glm/gtc/type_ptr.hpp"
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
 using namespace std;
 
 glm::mat4 modelMat(1.0);
@@ -27,19 +31,32 @@ bool leftMouseDown = false;
 struct PointLight {
     glm::vec4 pos = glm::vec4(0,0,0,1);
     glm::vec4 color = glm::vec4(1,1,1,1);
-    GLint posLoc = -1;
-    GLint colorLoc = -1;
+    float radius = 1.0f;
 };
 
-const int LIGHT_CNT = 10;
+const int LIGHT_CNT = 2048;
+
+// Per-frame camera data shared by the geometry and lighting passes (std140, matches FrameBlock)
+#define FRAME_BLOCK_BINDING 0
+struct FrameBlock {
+    glm::mat4 viewMat;
+    glm::mat4 projMat;
+    glm::mat4 invProjMat;
+    glm::ivec4 tileInfo;
+};
 PointLight lights[LIGHT_CNT];
 
+// Compact G-buffer: octahedral RG16 normals + RGBA8 albedo + sampled depth (12 bytes/pixel)
+// instead of RGBA16F position + RGBA16F normal + RGBA8 albedo + depth RBO (24 bytes/pixel)
+const bool COMPACT_GBUFFER = true;
+
 struct FBO {
     unsigned int ID;
     int width;
     int height;
     vector<unsigned int> colorIDs;
     unsigned int depthRBO;
+    unsigned int depthTexID;
 
     void clear() {
         ID = 0;
@@ -47,11 +64,13 @@ struct FBO {
         height = 0;
         colorIDs.clear();
         depthRBO = 0;
+        depthTexID = 0;
     };
 };
 
 struct GBuffer {
     FBO fbo;
+    vector<unsigned int> texIDs;    // Sampled in the lighting pass (same order as locs)
     vector<int> locs;
 
     void startGeometry() {
@@ -66,7 +85,7 @@ struct GBuffer {
     void startLighting() {
         for(int i = 0; i < locs.size(); i++) {
             glActiveTexture(GL_TEXTURE0 + i);
-            glBindTexture(GL_TEXTURE_2D, fbo.colorIDs.at(i));
+            glBindTexture(GL_TEXTURE_2D, texIDs.at(i));
             glUniform1i(locs.at(i), i);
             //cout << "colorIDs: " << fbo.colorIDs.at(i) << endl;
             //cout << "locs: " << locs.at(i) << endl;
@@ -82,7 +101,11 @@ struct GBuffer {
 
     void cleanup() {
         glDeleteFramebuffers(1, &(fbo.ID));
+        glDeleteTextures((GLsizei)fbo.colorIDs.size(), fbo.colorIDs.data());
+        if(fbo.depthTexID) glDeleteTextures(1, &(fbo.depthTexID));
+        if(fbo.depthRBO) glDeleteRenderbuffers(1, &(fbo.depthRBO));
         fbo.clear();
+        texIDs.clear();
         locs.clear();
     };
 };
@@ -120,6 +143,24 @@ unsigned int createDepthRBO(int width, int height) {
     return rbo;
 }
 
+unsigned int createDepthTexture(int width, int height) {
+    unsigned int texID = 0;
+    glGenTextures(1, &texID);
+    glBindTexture(GL_TEXTURE_2D, texID);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, width, height, 0,
+                        GL_DEPTH_COMPONENT, GL_FLOAT, 0);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                            GL_TEXTURE_2D, texID, 0);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texID;
+}
+
 void createFBO(FBO &fboObj, int width, int height) {
     fboObj.clear();
     glGenFramebuffers(1, &(fboObj.ID));
@@ -138,12 +179,51 @@ void createFBO(FBO &fboObj, int width, int height) {
     glBindFramebuffer(GL_FRAMEBUFFER, 0);                                            
 }
 
+// Compact layout: gNormal (RG16, octahedral), gAlbedoSpec (RGBA8), gDepth (depth texture).
+// Full layout: gPosition (RGBA16F), gNormal (RGBA16F), gAlbedoSpec (RGBA8), depth RBO.
+void createCompactGBuffer(GBuffer &gb, int width, int height, int lightProgID, 
+                            string *uniformNames) {
+    gb.fbo.colorIDs.push_back(createColorAttachment(width, height,
+                                                GL_RG16, GL_RG, 
+                                                GL_UNSIGNED_SHORT,
+                                                GL_NEAREST, 0));
+
+    gb.fbo.colorIDs.push_back(createColorAttachment(width, height,
+                                                GL_RGBA8, GL_RGBA, 
+                                                GL_UNSIGNED_BYTE,
+                                                GL_NEAREST, 1));
+
+    unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, 
+                                    GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, attachments);
+
+    gb.fbo.depthTexID = createDepthTexture(width, height);
+
+    gb.texIDs = gb.fbo.colorIDs;
+    gb.texIDs.push_back(gb.fbo.depthTexID);
+    for(int i = 0; i < gb.texIDs.size(); i++) {
+        gb.locs.push_back(
+            glGetUniformLocation(lightProgID, uniformNames[i].c_str())
+        );
+    }
+}
+
 void createGBuffer(GBuffer &gb, int width, int height, int lightProgID, 
-                    string *uniformNames) {    
+                    string *uniformNames, bool compact = false) {    
     glGenFramebuffers(1, &(gb.fbo.ID));
     gb.fbo.width = width;
     gb.fbo.height = height;
     glBindFramebuffer(GL_FRAMEBUFFER, gb.fbo.ID);
+
+    if(compact) {
+        createCompactGBuffer(gb, width, height, lightProgID, uniformNames);
+        if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            cerr << "ERROR: Incomplete GBuffer::FBO!" << endl;        
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return;
+    }
+
     for(int i = 0; i < 2; i++) {
         gb.fbo.colorIDs.push_back(createColorAttachment(width, height,
                                                 GL_RGBA16F, GL_RGBA, 
@@ -162,7 +242,8 @@ void createGBuffer(GBuffer &gb, int width, int height, int lightProgID,
                                     GL_COLOR_ATTACHMENT2 };
     glDrawBuffers(3, attachments);
 
-    for(int i = 0; i < gb.fbo.colorIDs.size(); i++) {
+    gb.texIDs = gb.fbo.colorIDs;
+    for(int i = 0; i < gb.texIDs.size(); i++) {
         gb.locs.push_back(
             glGetUniformLocation(lightProgID, uniformNames[i].c_str())
         );
@@ -176,6 +257,18 @@ void createGBuffer(GBuffer &gb, int width, int height, int lightProgID,
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
+// G-buffer in whichever layout COMPACT_GBUFFER selects
+void createSceneGBuffer(GBuffer &gb, int width, int height, int lightProgID) {
+    if(COMPACT_GBUFFER) {
+        string uniformNames[3] = { "gNormal", "gAlbedoSpec", "gDepth" };
+        createGBuffer(gb, width, height, lightProgID, uniformNames, true);
+    }
+    else {
+        string uniformNames[3] = { "gPosition", "gNormal", "gAlbedoSpec" };
+        createGBuffer(gb, width, height, lightProgID, uniformNames);
+    }
+}
+
 static void mouse_button_callback(GLFWwindow *window, int button,
                                     int action, int mods) {
     if(action == GLFW_PRESS) {
@@ -378,58 +471,11 @@ void makeCylinder(Mesh &m, float length, float radius, int faceCnt) {
     computeAllNormals(m);
 }
 
-unsigned int loadAndCreateTexture(string filename) {
-    
-    int texWidth, texHeight, texComponents;
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char *imageData = stbi_load(filename.c_str(), 
-                                            &texWidth, 
-                                            &texHeight, 
-                                            &texComponents, 0);
-    unsigned int texID = 0;
-    if(imageData) {
-        glGenTextures(1, &texID);
-        GLenum format;
-        if(texComponents == 3) {
-            format = GL_RGB;
-            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-        }
-        else {
-            format = GL_RGBA;
-        }
-        glBindTexture(GL_TEXTURE_2D, texID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, texWidth, texHeight, 0,
-                            format, GL_UNSIGNED_BYTE, imageData);
-        
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        glTexParameteri(GL_TEXTURE_2D, 
-                        GL_TEXTURE_WRAP_S,
-                        GL_REPEAT); 
-                        //GL_MIRRORED_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, 
-                        GL_TEXTURE_WRAP_T, 
-                        GL_REPEAT);
-                        //GL_MIRRORED_REPEAT);
-        glBindTexture(GL_TEXTURE_2D, 0);
-
-        stbi_image_free(imageData);
-    }
-    else {
-        cerr << "ERROR: Texture could not load!" << endl;
-        glfwTerminate();
-        exit(1);
-    }
-
-    return texID;
-}
-
-GLuint loadAndCreateShaderProgram(string vertFile, string fragFile) {
+GLuint loadAndCreateShaderProgram(string vertFile, string fragFile, string defines = "") {
 
     // Load vertex shader code and fragment shader code
-    string vertexCode = readFileToString(vertFile);
-    string fragCode = readFileToString(fragFile);
+    string vertexCode = insertShaderDefines(readFileToString(vertFile), defines);
+    string fragCode = insertShaderDefines(readFileToString(fragFile), defines);
 
     // Print out shader code, just to check
     printShaderCode(vertexCode, fragCode);
@@ -494,7 +540,8 @@ int main(int argc, char **argv) {
     }
 
     glfwMakeContextCurrent(window);
-    glfwSwapInterval(1);
+    FramePacer pacer;
+    createFramePacer(pacer, window);
 
     double mx, my;
     glfwGetCursorPos(window, &mx, &my);
@@ -516,39 +563,45 @@ int main(int argc, char **argv) {
         exit(1);
     }
 
+    string gbufferDefines = COMPACT_GBUFFER ? "#define COMPACT_GBUFFER\n" : "";
+
     GLuint geoProgID = loadAndCreateShaderProgram(
         "./shaders/ProfDeferredExercise/Geo.vs",
-        "./shaders/ProfDeferredExercise/Geo.fs");
+        "./shaders/ProfDeferredExercise/Geo.fs",
+        gbufferDefines);
 
     GLuint lightProgID = loadAndCreateShaderProgram(
         "./shaders/ProfDeferredExercise/Light.vs",                                                
-        "./shaders/ProfDeferredExercise/Light.fs");
+        "./shaders/ProfDeferredExercise/Light.fs",
+        gbufferDefines);
+
+    GLuint cullProgID = initComputeProgramFromSource(
+        insertShaderDefines(readFileToString("./shaders/ProfDeferredExercise/LightCull.comp"),
+                            gbufferDefines));
 
     GLint modelMatLoc = glGetUniformLocation(geoProgID, "modelMat");
-    GLint viewMatLoc = glGetUniformLocation(geoProgID, "viewMat");
-    GLint projMatLoc = glGetUniformLocation(geoProgID, "projMat");
     GLint normalMatLoc = glGetUniformLocation(geoProgID, "normalMat");
     cout << "modelMatLoc: " << modelMatLoc << endl;
-    cout << "viewMatLoc: " << viewMatLoc << endl;
-    cout << "projMatLoc: " << projMatLoc << endl;
     cout << "normalMatLoc: " << normalMatLoc << endl;
 
-    float lightAngleInc = glm::radians(360.0f / LIGHT_CNT);
-    float radius = 4.0f; //0.8f;
+    // Scatter lights around the cylinder (fixed seed so every run looks the same)
+    mt19937 rng(450);
+    uniform_real_distribution<float> unitDist(0.0f, 1.0f);
 
     for(int i = 0; i < LIGHT_CNT; i++) {
-        lights[i].pos = glm::vec4(radius * sin(lightAngleInc*i),
-                                    0.1f, //3.0f, //0.1f,
-                                    radius * cos(lightAngleInc*i),
+        float angle = glm::radians(360.0f) * unitDist(rng);
+        float ringRadius = 2.2f + 3.0f*unitDist(rng);
+        lights[i].pos = glm::vec4(ringRadius * sin(angle),
+                                    -4.0f + 8.0f*unitDist(rng),
+                                    ringRadius * cos(angle),
                                     1.0f);
-        cout << "light " << std::to_string(i) 
-                << ": " << glm::to_string(lights[i].pos) << endl;
-        string pos_str = "lights[" + to_string(i) + "].pos";
-        string color_str = "lights[" + to_string(i) + "].color";
-        lights[i].posLoc = glGetUniformLocation(lightProgID, pos_str.c_str());
-        lights[i].colorLoc = glGetUniformLocation(lightProgID, color_str.c_str());
+        lights[i].color = glm::vec4(unitDist(rng), unitDist(rng), unitDist(rng), 1.0f);
+        lights[i].radius = 0.5f + 1.5f*unitDist(rng);
     }
 
+    UniformRingGL uniformRing;
+    createUniformRingGL(uniformRing, sizeof(FrameBlock));
+
     //GLint lightPosLoc = glGetUniformLocation(geoProgID, "light.pos");
     //GLint lightColorLoc = glGetUniformLocation(geoProgID, "light.color");
 
@@ -557,11 +610,18 @@ int main(int argc, char **argv) {
     //createFBO(fbo, frameWidth, frameHeight);
 
     GBuffer gb;
-    createGBuffer(gb, frameWidth, frameHeight, lightProgID, 
-                    new string[3] { "gPosition", "gNormal", "gAlbedoSpec"});
+    createSceneGBuffer(gb, frameWidth, frameHeight, lightProgID);
+
+    // Bins lights into 16x16 pixel tiles each frame
+    TiledLightCuller culler;
+    createTiledLightCuller(culler, cullProgID, frameWidth, frameHeight);
+    vector<GPUPointLight> viewLights(LIGHT_CNT);
                     
-    unsigned int diffTexID = loadAndCreateTexture("test.png");
-    unsigned int normTexID = loadAndCreateTexture("normal.png");
+    // Decoded off-thread and uploaded a few MB per frame; a gray placeholder stands in until then
+    TextureStreamer texStreamer;
+    createTextureStreamer(texStreamer);
+    int diffTexHandle = requestTexture(texStreamer, "test.png", TEXTURE_COMPRESSION_BC1);
+    int normTexHandle = requestTexture(texStreamer, "normal.png", TEXTURE_COMPRESSION_BC5);
    
     GLint diffuseTexLoc = glGetUniformLocation(geoProgID, "diffuseTexture");
     GLint normalTexLoc = glGetUniformLocation(geoProgID, "normalTexture");
@@ -628,6 +688,10 @@ int main(int argc, char **argv) {
 
 
 
+    // Per-pass GPU timings, printed every 300 frames
+    GPUProfiler gpuProf;
+    createGPUProfiler(gpuProf, 240, 300);
+
     glClearColor(1.0, 1.0, 0.0, 1.0);
     glEnable(GL_DEPTH_TEST);
 
@@ -635,10 +699,23 @@ int main(int argc, char **argv) {
 
     while(!glfwWindowShouldClose(window)) {
 
+        updateTextureStreamer(texStreamer);
+
+        // Window resized? G-buffer and tile lists both depend on the size
+        // (skipped while minimized, when the size is 0)
+        glfwGetFramebufferSize(window, &frameWidth, &frameHeight);
+        if(frameWidth > 0 && frameHeight > 0
+            && (frameWidth != gb.fbo.width || frameHeight != gb.fbo.height)) {
+            gb.cleanup();
+            createSceneGBuffer(gb, frameWidth, frameHeight, lightProgID);
+            cleanupTiledLightCuller(culler);
+            createTiledLightCuller(culler, cullProgID, frameWidth, frameHeight);
+        }
+
         // GEOMETRY PASS /////////////////////////////////////////////////
+        beginGPUTimer(gpuProf, "Geometry");
         gb.startGeometry();
 
-        glfwGetFramebufferSize(window, &frameWidth, &frameHeight);
         float aspect = 1.0f;
         if(frameHeight > 0) {
             aspect = ((float)frameWidth) / ((float)frameHeight);
@@ -653,18 +730,24 @@ int main(int argc, char **argv) {
         glUniformMatrix4fv(modelMatLoc, 1, false, glm::value_ptr(modelMat));
 
         viewMat = glm::lookAt(glm::vec3(0,7,7), glm::vec3(0,0,0), glm::vec3(0,1,0));
-        glUniformMatrix4fv(viewMatLoc, 1, false, glm::value_ptr(viewMat));
-
         projMat = glm::perspective(fov, aspect, 0.1f, 1000.0f);
-        glUniformMatrix4fv(projMatLoc, 1, false, glm::value_ptr(projMat));
+
+        // One write per frame; both passes read the same block
+        beginUniformFrame(uniformRing);
+        FrameBlock frame;
+        frame.viewMat = viewMat;
+        frame.projMat = projMat;
+        frame.invProjMat = glm::inverse(projMat);
+        frame.tileInfo = glm::ivec4(culler.tilesX, culler.tilesY, frameWidth, frameHeight);
+        pushAndBindUniformData(uniformRing, FRAME_BLOCK_BINDING, &frame, sizeof(frame));
 
         glm::mat3 normalMat = glm::transpose(glm::inverse(glm::mat3(viewMat*modelMat)));
         glUniformMatrix3fv(normalMatLoc, 1, false, glm::value_ptr(normalMat));
 
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, diffTexID);
+        glBindTexture(GL_TEXTURE_2D, getStreamedTexture(texStreamer, diffTexHandle));
         glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, normTexID);
+        glBindTexture(GL_TEXTURE_2D, getStreamedTexture(texStreamer, normTexHandle));
 
         glUniform1i(diffuseTexLoc, 0);
         glUniform1i(normalTexLoc, 1);
@@ -672,47 +755,67 @@ int main(int argc, char **argv) {
         drawMesh(mainGL);
 
         gb.endGeometry();
+        endGPUTimer(gpuProf);
+
+        // LIGHT CULLING PASS ////////////////////////////////////////
+        // All lights go up in one buffer update instead of two uniforms each
+        for(int i = 0; i < LIGHT_CNT; i++) {
+            viewLights[i].pos = viewMat*lights[i].pos;
+            viewLights[i].pos.w = lights[i].radius;
+            viewLights[i].color = lights[i].color;
+        }
+        beginGPUTimer(gpuProf, "LightCull");
+        uploadLights(culler, viewLights);
+        // Compact mode reconstructs view-space positions from depth
+        GLuint depthSourceID = COMPACT_GBUFFER ? gb.fbo.depthTexID : gb.fbo.colorIDs.at(0);
+        cullLights(culler, depthSourceID, projMat);
+        endGPUTimer(gpuProf);
 
         // LIGHTING PASS /////////////////////////////////////////////
+        beginGPUTimer(gpuProf, "Lighting");
         glUseProgram(lightProgID);
         gb.startLighting();       
+        bindTileLights(culler);
 
         glViewport(0,0,frameWidth,frameHeight);
         glClearColor(0.0, 0.0, 1.0, 1.0);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        
-        for(int i = 0; i < LIGHT_CNT; i++) {
-            glm::vec4 lightPos = viewMat*lights[i].pos;
-            glUniform4fv(lights[i].posLoc, 1, glm::value_ptr(lightPos));
-            glUniform4fv(lights[i].colorLoc, 1, glm::value_ptr(lights[i].color));
-        }
 
         drawMesh(quadGL);
+        endUniformFrame(uniformRing);
         
         gb.endLighting();
 
         glUseProgram(0);
+        endGPUTimer(gpuProf);
+        endGPUProfilerFrame(gpuProf);
 
-        glfwSwapBuffers(window);
+        swapFrameBuffers(pacer, window);
         glfwPollEvents();
-        this_thread::sleep_for(chrono::milliseconds(15));
+        waitForNextFrame(pacer);
     }
 
     //glDeleteFramebuffers(1, &(fbo.ID));
+    printGPUProfilerStats(gpuProf);
+    cleanupGPUProfiler(gpuProf);
+
     gb.cleanup();
+    cleanupTiledLightCuller(culler);
+    cleanupUniformRingGL(uniformRing);
 
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, 0);
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, 0);
-    glDeleteTextures(1, &diffTexID);
-    glDeleteTextures(1, &normTexID);
+    cleanupTextureStreamer(texStreamer);
 
     cleanupMesh(quadGL);
     cleanupMesh(mainGL);
 
     glUseProgram(0);
     glDeleteProgram(geoProgID);
+    glDeleteProgram(lightProgID);
+    glDeleteProgram(cullProgID);
 
     glfwDestroyWindow(window);
     glfwTerminate();
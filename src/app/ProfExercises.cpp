@@ -5,7 +5,9 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include "Shader.hpp"
+#include "FramePacer.hpp"
 #include "MeshData.hpp"
+#include "MeshLOD.hpp"
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 #define GLM_ENABLE_EXPERIMENTAL
@@ -358,7 +360,8 @@ int main(int argc, char **argv) {
     }
 
     glfwMakeContextCurrent(window);
-    glfwSwapInterval(1);
+    FramePacer pacer;
+    createFramePacer(pacer, window);
 
     double mx, my;
     glfwGetCursorPos(window, &mx, &my);
@@ -470,9 +473,12 @@ int main(int argc, char **argv) {
     
     Mesh cylinder;
     makeCylinder(cylinder, 7.0, 2.0, 36);
+    generateMeshLODs(cylinder);
 
     Mesh m = cylinder; //quad;
     int indexCnt = (int)m.indices.size();
+    float cylinderRadius = glm::length(glm::vec2(3.5f, 2.0f));
+    cout << "Cylinder LODs: " << m.lods.size() << endl;
 
     GLuint VBO = 0;
     GLuint EBO = 0;
@@ -506,8 +512,12 @@ int main(int argc, char **argv) {
 
     glGenBuffers(1, &EBO);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, m.indices.size()*sizeof(GLuint),
-                    m.indices.data(), GL_STATIC_DRAW);
+    // Full mesh first, simplified index lists right after it
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (m.indices.size() + m.lodIndices.size())*sizeof(GLuint),
+                    NULL, GL_STATIC_DRAW);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, m.indices.size()*sizeof(GLuint), m.indices.data());
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, m.indices.size()*sizeof(GLuint),
+                    m.lodIndices.size()*sizeof(GLuint), m.lodIndices.data());
     
 
     glBindVertexArray(0);
@@ -559,15 +569,27 @@ int main(int argc, char **argv) {
 
         glUniform1f(texOffLoc, tex_u_offset);
 
+        // Coarsest LOD that stays within a pixel of the full cylinder
+        glm::vec3 viewCenter = glm::vec3(viewMat*modelMat*glm::vec4(0,0,0,1));
+        float distance = max(glm::length(viewCenter) - cylinderRadius, 0.0f);
+        int lod = selectMeshLOD(m.lods, getMatrixMaxScale(modelMat), distance, 
+                                projMat, (float)frameHeight);
+        int drawCnt = indexCnt;
+        size_t drawOffset = 0;
+        if(lod > 0) {
+            drawCnt = (int)m.lods[lod-1].indexCnt;
+            drawOffset = (m.indices.size() + m.lods[lod-1].firstIndex)*sizeof(GLuint);
+        }
+
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indexCnt, 
-                        GL_UNSIGNED_INT, (void*)0);
+        glDrawElements(GL_TRIANGLES, drawCnt, 
+                        GL_UNSIGNED_INT, (void*)drawOffset);
         glBindVertexArray(0);
         glUseProgram(0);
 
-        glfwSwapBuffers(window);
+        swapFrameBuffers(pacer, window);
         glfwPollEvents();
-        this_thread::sleep_for(chrono::milliseconds(15));
+        waitForNextFrame(pacer);
     }
 
     glActiveTexture(GL_TEXTURE0);
@@ -5,6 +5,8 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include "Shader.hpp"
+#include "FramePacer.hpp"
+#include "GPUProfiler.hpp"
 #include "MeshData.hpp"
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
@@ -429,7 +431,8 @@ int main(int argc, char **argv) {
     }
 
     glfwMakeContextCurrent(window);
-    glfwSwapInterval(1);
+    FramePacer pacer;
+    createFramePacer(pacer, window);
 
     double mx, my;
     glfwGetCursorPos(window, &mx, &my);
@@ -585,8 +588,13 @@ int main(int argc, char **argv) {
 
     light.pos = glm::vec4(0, 20, 0, 1.0);
 
+    // Per-pass GPU timings, printed every 300 frames
+    GPUProfiler gpuProf;
+    createGPUProfiler(gpuProf, 240, 300);
+
     while(!glfwWindowShouldClose(window)) {
 
+        beginGPUTimer(gpuProf, "Scene");
         glBindFramebuffer(GL_FRAMEBUFFER, fbo.ID);
 
         glfwGetFramebufferSize(window, &frameWidth, &frameHeight);
@@ -620,7 +628,10 @@ int main(int argc, char **argv) {
 
         //drawMesh(mainGL);
 
+        endGPUTimer(gpuProf);
+
         // SECOND PASS /////////////////////////////////////////////
+        beginGPUTimer(gpuProf, "PostProcess");
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
         glUseProgram(quadProgID);
@@ -637,12 +648,17 @@ int main(int argc, char **argv) {
         //drawMesh(mainGL);
 
         glUseProgram(0);
+        endGPUTimer(gpuProf);
+        endGPUProfilerFrame(gpuProf);
 
-        glfwSwapBuffers(window);
+        swapFrameBuffers(pacer, window);
         glfwPollEvents();
-        this_thread::sleep_for(chrono::milliseconds(15));
+        waitForNextFrame(pacer);
     }
 
+    printGPUProfilerStats(gpuProf);
+    cleanupGPUProfiler(gpuProf);
+
     glDeleteFramebuffers(1, &(fbo.ID));
 
     glActiveTexture(GL_TEXTURE0);
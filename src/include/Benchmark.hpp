@@ -0,0 +1,64 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "glm/glm.hpp"
+using namespace std;
+
+// Command-line options:
+//	--benchmark [frames]		Run headless for a fixed number of frames, then exit
+//	--bench-warmup <frames>		Frames rendered before timing starts
+//	--bench-size <W>x<H>		Offscreen resolution
+//	--bench-stats <file>		Write timing statistics (CSV)
+//	--bench-screenshot <file>	Save the final frame (PNG)
+struct BenchmarkSettings {
+	bool enabled = false;
+	int frameCnt = 300;
+	int warmupCnt = 30;
+	int width = 1280;
+	int height = 720;
+	string statsFile = "";
+	string screenshotFile = "";
+};
+
+// Framebuffer the benchmark renders into (hidden windows have no reliable default framebuffer).
+// Depth is a texture so passes like Hi-Z can read it back.
+struct OffscreenTarget {
+	GLuint fbo = 0;
+	GLuint colorRBO = 0;
+	GLuint depthTexID = 0;
+	int width = 0;
+	int height = 0;
+};
+
+struct BenchmarkRun {
+	typedef chrono::steady_clock Clock;
+
+	BenchmarkSettings settings;
+	OffscreenTarget target;
+	int frame = 0;					// Includes warmup frames
+	vector<double> frameMS;			// Timed frames only
+	Clock::time_point frameStart;
+	Clock::time_point timedStart;
+};
+
+bool createOffscreenTarget(OffscreenTarget &target, int width, int height);
+void cleanupOffscreenTarget(OffscreenTarget &target);
+
+bool parseBenchmarkArgs(int argc, char **argv, BenchmarkSettings &settings, vector<string> &otherArgs);
+void createBenchmarkRun(BenchmarkRun &run, BenchmarkSettings &settings);
+void beginBenchmarkFrame(BenchmarkRun &run);
+void endBenchmarkFrame(BenchmarkRun &run);
+bool isBenchmarkDone(BenchmarkRun &run);
+void getBenchmarkCamera(BenchmarkRun &run, glm::vec3 center, float radius, glm::vec3 &eye, glm::vec3 &lookAt);
+void finishBenchmark(BenchmarkRun &run, string label);
+void cleanupBenchmarkRun(BenchmarkRun &run);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <thread>
+#include <cstdlib>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+using namespace std;
+
+enum FramePacingMode {
+	FRAME_PACING_UNCAPPED,		// Swap interval 0, never wait
+	FRAME_PACING_VSYNC,			// Swap interval 1, the driver paces us
+	FRAME_PACING_TARGET_FPS		// Swap interval 0, wait for a fixed deadline
+};
+
+// CPU timings for a single frame (milliseconds)
+struct FrameTimings {
+	double frameMS = 0.0;		// Whole frame, end to end
+	double cpuMS = 0.0;			// Frame start until swapFrameBuffers() (or waitForNextFrame() without it)
+	double swapMS = 0.0;		// Time blocked in glfwSwapBuffers() (vsync waits show up here)
+	double waitMS = 0.0;		// Time spent waiting for the deadline
+};
+
+struct FramePacer {
+	typedef chrono::steady_clock Clock;
+
+	FramePacingMode mode = FRAME_PACING_VSYNC;
+	double targetFPS = 60.0;
+	double spinMS = 1.5;				// Busy-wait this close to the deadline (sleep is too coarse)
+
+	Clock::time_point frameStart;
+	Clock::time_point cpuEnd;			// Set by swapFrameBuffers()
+	bool cpuEndSet = false;
+	Clock::time_point deadline;
+	FrameTimings last;
+	unsigned long long frameCnt = 0;
+
+	// Periodic console report (0 = off)
+	double reportIntervalMS = 0.0;
+	double reportElapsedMS = 0.0;
+	int reportFrameCnt = 0;
+	double reportCpuMS = 0.0;
+	double reportSwapMS = 0.0;
+	double reportMaxFrameMS = 0.0;
+};
+
+void createFramePacer(FramePacer &pacer, GLFWwindow *window, 
+						FramePacingMode mode = FRAME_PACING_VSYNC, double targetFPS = 60.0);
+void setFramePacingMode(FramePacer &pacer, FramePacingMode mode, double targetFPS = 60.0);
+void swapFrameBuffers(FramePacer &pacer, GLFWwindow *window);
+void waitForNextFrame(FramePacer &pacer);
+string getFramePacingModeName(FramePacingMode mode);
+
+#endif
@@ -6,13 +6,15 @@
 #include <sstream>
 #include <thread>
 #include <vector>
+#include <cstdlib>
 #include <GL/glew.h>					
 #include <GLFW/glfw3.h>
 using namespace std;
 
 GLFWwindow* setupGLFW(string windowTitle, int major, int minor, int windowWidth, int windowHeight, bool debugging);
+GLFWwindow* setupGLFWHeadless(string windowTitle, int major, int minor, int windowWidth, int windowHeight, bool debugging);
 void cleanupGLFW(GLFWwindow* window);
-void setupGLEW(GLFWwindow* window);
+void setupGLEW(GLFWwindow* window, bool headless = false);
 void checkOpenGLVersion();
 void checkAndSetupOpenGLDebugging();
 
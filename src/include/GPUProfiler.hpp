@@ -0,0 +1,61 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+using namespace std;
+
+// Frames between issuing a query and reading it back; results are normally
+// available by then, so reading them never stalls the pipeline
+#define GPU_PROFILER_FRAME_LATENCY 3
+
+// One named, timed section of the frame (e.g., "Geometry")
+struct GPUTimerPass {
+	string name;
+	GLuint queries[GPU_PROFILER_FRAME_LATENCY] = {};
+	bool pending[GPU_PROFILER_FRAME_LATENCY] = {};
+	unsigned long long issuedFrame[GPU_PROFILER_FRAME_LATENCY] = {};
+	vector<double> history;			// Ring buffer of recent results (ms)
+	int historyNext = 0;
+	double lastMS = 0.0;
+	unsigned long long sampleCnt = 0;
+	unsigned long long droppedCnt = 0;	// Results still not ready when their slot came around again
+};
+
+// Rolling statistics for one pass (ms)
+struct GPUTimerStats {
+	double avgMS = 0.0;
+	double minMS = 0.0;
+	double maxMS = 0.0;
+	double p50MS = 0.0;
+	double p95MS = 0.0;
+	double p99MS = 0.0;
+	int sampleCnt = 0;
+};
+
+struct GPUProfiler {
+	vector<GPUTimerPass> passes;
+	int slot = 0;					// Which query of each pass this frame uses
+	int activePass = -1;			// GL_TIME_ELAPSED queries cannot nest
+	int historySize = 240;
+	int reportEveryFrames = 0;		// 0 = no console report
+	unsigned long long frameCnt = 0;
+	ofstream csv;
+};
+
+void createGPUProfiler(GPUProfiler &prof, int historySize = 240, int reportEveryFrames = 0);
+void beginGPUTimer(GPUProfiler &prof, string passName);
+void endGPUTimer(GPUProfiler &prof);
+void endGPUProfilerFrame(GPUProfiler &prof);
+bool getGPUTimerStats(GPUProfiler &prof, string passName, GPUTimerStats &stats);
+void printGPUProfilerStats(GPUProfiler &prof);
+bool openGPUProfilerCSV(GPUProfiler &prof, string filename);
+void cleanupGPUProfiler(GPUProfiler &prof);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef HIZ_GL_H
+#define HIZ_GL_H
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "glm/glm.hpp"
+using namespace std;
+
+// Must match local_size in HiZBuild.comp
+#define HIZ_GROUP_SIZE 8
+
+// Hierarchical depth pyramid: level 0 is a copy of the depth buffer, and every
+// texel of the levels above holds the FARTHEST depth of the texels it covers
+struct HiZBuffer {
+	GLuint texID = 0;					// R32F, full mip chain
+	GLuint progID = 0;					// HiZBuild.comp (owned by caller)
+	int width = 0;
+	int height = 0;
+	int mipCnt = 0;
+	GLint srcTexLoc = -1;
+	GLint srcLevelLoc = -1;
+	GLint srcSizeLoc = -1;
+	GLint dstSizeLoc = -1;
+	GLint copyDepthLoc = -1;
+	glm::mat4 viewProjMat = glm::mat4(1.0);	// Camera the pyramid was built from
+	bool valid = false;					// False until the first build
+};
+
+void createHiZBuffer(HiZBuffer &hz, GLuint buildProgID, int width, int height);
+void resizeHiZBuffer(HiZBuffer &hz, int width, int height);
+void buildHiZBuffer(HiZBuffer &hz, GLuint depthTexID, const glm::mat4 &viewProjMat);
+void cleanupHiZBuffer(HiZBuffer &hz);
+
+#endif
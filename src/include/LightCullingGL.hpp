@@ -0,0 +1,51 @@
+#ifndef LIGHT_CULLING_GL_H
+#define LIGHT_CULLING_GL_H
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "glm/glm.hpp"
+using namespace std;
+
+// Must match TILE_SIZE / MAX_LIGHTS_PER_TILE in the culling and lighting shaders
+#define LIGHT_TILE_SIZE 16
+#define MAX_LIGHTS_PER_TILE 255
+
+// Default SSBO binding points
+#define LIGHT_BUFFER_BINDING 1
+#define TILE_BUFFER_BINDING 2
+
+// Point light as stored in the light SSBO (std430)
+struct GPUPointLight {
+	glm::vec4 pos;		// xyz = view-space position, w = radius of influence
+	glm::vec4 color;
+};
+
+// Bins lights into screen tiles with a compute shader.
+// Each tile gets (MAX_LIGHTS_PER_TILE + 1) uints: the count, then the light indices.
+struct TiledLightCuller {
+	GLuint progID = 0;
+	GLuint lightSSBO = 0;
+	GLuint tileSSBO = 0;
+	int lightCapacity = 0;
+	int lightCnt = 0;
+	int width = 0;
+	int height = 0;
+	int tilesX = 0;
+	int tilesY = 0;
+	GLint projMatLoc = -1;
+	GLint invProjMatLoc = -1;
+	GLint lightCntLoc = -1;
+	GLint screenSizeLoc = -1;
+	GLint depthSourceLoc = -1;		// "gPosition" (view-space positions) or "gDepth" (depth texture)
+};
+
+void createTiledLightCuller(TiledLightCuller &tc, GLuint cullProgID, int width, int height);
+void uploadLights(TiledLightCuller &tc, vector<GPUPointLight> &viewLights);
+void cullLights(TiledLightCuller &tc, GLuint depthSourceTexID, glm::mat4 &projMat);
+void bindTileLights(TiledLightCuller &tc);
+void cleanupTiledLightCuller(TiledLightCuller &tc);
+
+#endif
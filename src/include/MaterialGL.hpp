@@ -0,0 +1,52 @@
+#ifndef MATERIAL_GL_H
+#define MATERIAL_GL_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "glm/glm.hpp"
+#include "ThreadPool.hpp"
+#include "TextureStreamGL.hpp"
+using namespace std;
+
+// Binding points (must match the shaders)
+#define MATERIAL_SSBO_BINDING 8
+#define MATERIAL_ALBEDO_UNIT 0
+#define MATERIAL_NORMAL_UNIT 1
+
+#define MATERIAL_LAYER_SIZE 512		// Every texture is resampled to this (square) size
+#define MATERIAL_NO_TEXTURE -1
+
+// One entry of the material SSBO (std430 layout)
+struct GPUMaterial {
+	glm::vec4 baseColor = glm::vec4(1,1,1,1);	// Multiplies the albedo layer (or the vertex color without one)
+	float metallic = -1.0f;						// Negative = use the global value from the shader
+	float roughness = -1.0f;
+	int albedoLayer = MATERIAL_NO_TEXTURE;		// Layer in the albedo array
+	int normalLayer = MATERIAL_NO_TEXTURE;		// Layer in the normal array
+};
+
+// All textures of a scene in two 2D texture arrays, plus a table of materials,
+// so draws with different materials need no texture rebinds (and can share one
+// indirect batch; see BatchDrawData::material)
+struct MaterialLibraryGL {
+	int layerSize = MATERIAL_LAYER_SIZE;
+	vector<string> albedoFiles;
+	vector<string> normalFiles;
+	vector<GPUMaterial> materials;
+	GLuint albedoArrayID = 0;			// BC1 (RGBA8 without S3TC)
+	GLuint normalArrayID = 0;			// BC5 (only RG is stored)
+	GLuint materialSSBO = 0;
+};
+
+void createMaterialLibraryGL(MaterialLibraryGL &lib, int layerSize = MATERIAL_LAYER_SIZE);
+int addMaterialTexture(MaterialLibraryGL &lib, string filename, bool isNormalMap = false);
+int addMaterial(MaterialLibraryGL &lib, const GPUMaterial &material);
+void uploadMaterialLibraryGL(MaterialLibraryGL &lib, ThreadPool &pool);
+void bindMaterialLibraryGL(MaterialLibraryGL &lib);
+int getMaterialCount(MaterialLibraryGL &lib);
+void cleanupMaterialLibraryGL(MaterialLibraryGL &lib);
+
+#endif
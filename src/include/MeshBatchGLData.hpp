@@ -0,0 +1,116 @@
+#ifndef MESH_BATCH_GL_DATA_H
+#define MESH_BATCH_GL_DATA_H
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "glm/glm.hpp"
+#include "MeshData.hpp"
+#include "MeshGLData.hpp"
+#include "HiZGL.hpp"
+#include "MeshLOD.hpp"
+using namespace std;
+
+// Vertex attribute location used for the per-draw index
+#define BATCH_DRAW_ID_LOCATION 5
+
+// GPU frustum culling (must match FrustumCull.comp)
+#define BATCH_CULL_GROUP_SIZE 64
+#define BATCH_CULL_INPUT_BINDING 3		// All queued commands
+#define BATCH_CULL_OUTPUT_BINDING 4		// Commands actually drawn
+#define BATCH_CULL_BOUNDS_BINDING 5		// Per-draw bounding spheres
+#define BATCH_CULL_COUNT_BINDING 6		// Number of visible draws
+#define BATCH_CULL_RETEST_BINDING 7		// Draws the early occlusion phase rejected
+
+// Layout expected by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+	GLuint count = 0;
+	GLuint instanceCount = 0;
+	GLuint firstIndex = 0;
+	GLint baseVertex = 0;
+	GLuint baseInstance = 0;
+};
+
+// Per-draw data stored in the SSBO (std430 layout)
+struct BatchDrawData {
+	glm::mat4 modelMat;
+	glm::mat4 normalMat;	// Only upper 3x3 used (mat3 columns are padded to vec4 anyway)
+	glm::ivec4 material = glm::ivec4(0);	// x = index into the material SSBO (MaterialGL.hpp); yzw unused
+};
+
+// Where each source mesh lives inside the shared buffers
+struct BatchMeshRange {
+	GLuint firstIndex = 0;
+	GLuint indexCnt = 0;
+	GLint baseVertex = 0;
+	glm::mat4 dequantMat = glm::mat4(1.0);	// Folded into the model matrix of each draw
+	glm::vec4 boundingSphere = glm::vec4(0,0,0,0);	// xyz = center, w = radius (in uploaded vertex space)
+	vector<MeshLOD> lods;					// Same as Mesh::lods, but firstIndex is into the shared EBO
+};
+
+// One mesh's arrays, wherever they live (a Mesh, or a mapped mesh cache)
+struct BatchMeshSource {
+	const Vertex *vertices = nullptr;
+	size_t vertCnt = 0;
+	const unsigned int *indices = nullptr;
+	size_t indexCnt = 0;
+	const MeshLOD *lods = nullptr;
+	size_t lodCnt = 0;
+	const unsigned int *lodIndices = nullptr;	// MeshLOD::firstIndex points into these
+	size_t lodIndexCnt = 0;
+};
+
+// Struct for holding all meshes in shared buffers, drawn with a single multi-draw call
+struct MeshBatchGL {
+	GLuint VBO = 0;
+	GLuint EBO = 0;
+	GLuint VAO = 0;
+	GLuint drawIDBuffer = 0;		// 0,1,2,... read per instance (baseInstance = draw index)
+	GLuint indirectBuffer = 0;
+	GLuint drawDataSSBO = 0;
+	int drawCapacity = 0;
+	VertexFormat format = VERTEX_FORMAT_FULL;
+	vector<BatchMeshRange> meshes;
+	vector<DrawElementsIndirectCommand> commands;
+	vector<BatchDrawData> drawData;
+	vector<glm::vec4> drawBounds;			// Copy of each draw's mesh bounding sphere
+
+	// GPU culling (only set up by setupBatchCulling())
+	GLuint cullProgID = 0;
+	GLuint cullInputBuffer = 0;
+	GLuint cullBoundsSSBO = 0;
+	GLuint drawCountBuffer = 0;
+	GLuint lateIndirectBuffer = 0;			// Second (occlusion) phase gets its own commands + count
+	GLuint lateDrawCountBuffer = 0;
+	GLuint retestSSBO = 0;
+	GLint frustumPlanesLoc = -1;
+	GLint cullDrawCntLoc = -1;
+	GLint compactDrawsLoc = -1;
+	GLint cullPhaseLoc = -1;
+	GLint hiZLoc = -1;
+	GLint hiZViewProjMatLoc = -1;
+	GLint hiZValidLoc = -1;
+	bool useDrawCount = false;				// ARB_indirect_parameters: compacted list + GPU draw count
+};
+
+void createMeshBatchGL(const vector<BatchMeshSource> &sources, MeshBatchGL &batch, VertexFormat format = VERTEX_FORMAT_FULL);
+void createMeshBatchGL(vector<Mesh> &allMeshes, MeshBatchGL &batch, VertexFormat format = VERTEX_FORMAT_FULL);
+void clearBatchDraws(MeshBatchGL &batch);
+int selectBatchLOD(MeshBatchGL &batch, int meshIndex, const glm::mat4 &modelViewMat,
+					const glm::mat4 &projMat, float viewportHeight, float maxPixelError = 1.0f);
+void addBatchDraw(MeshBatchGL &batch, int meshIndex, const glm::mat4 &modelMat, const glm::mat3 &normalMat,
+					int lod = 0, int materialIndex = 0);
+void drawMeshBatch(MeshBatchGL &batch, GLuint drawDataBinding = 0);
+void setupBatchCulling(MeshBatchGL &batch, GLuint cullProgID);
+void extractFrustumPlanes(const glm::mat4 &viewProjMat, glm::vec4 planes[6]);
+void drawMeshBatchCulled(MeshBatchGL &batch, const glm::mat4 &viewMat, const glm::mat4 &projMat,
+							GLuint drawDataBinding = 0);
+void drawMeshBatchOcclusionCulled(MeshBatchGL &batch, HiZBuffer &hz, GLuint depthTexID,
+									const glm::mat4 &viewMat, const glm::mat4 &projMat,
+									GLuint drawDataBinding = 0);
+int getBatchVisibleCount(MeshBatchGL &batch);
+void cleanupMeshBatch(MeshBatchGL &batch);
+
+#endif
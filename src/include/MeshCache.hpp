@@ -0,0 +1,86 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cstdint>
+#include "MeshData.hpp"
+#include "MeshGLData.hpp"
+#include "MeshBatchGLData.hpp"
+#include "SceneGraph.hpp"
+using namespace std;
+
+// Bump whenever the on-disk layout (or Vertex) changes
+#define MESH_CACHE_VERSION 2
+
+// Read-only memory-mapped file
+struct MappedFile {
+	const unsigned char *data = nullptr;
+	size_t size = 0;
+	void *fileHandle = nullptr;		// Windows only
+	void *mapHandle = nullptr;		// Windows only
+	int fd = -1;					// POSIX only
+};
+
+// File header; all offsets are in bytes from the start of the file
+struct MeshCacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceHash;
+	uint32_t vertexSize;
+	uint32_t meshCnt;
+	uint32_t nodeCnt;
+	uint32_t nodeMeshIndexCnt;
+	uint32_t lodCnt;
+	uint32_t lodIndexCnt;
+	uint64_t meshTableOffset;
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint64_t nodeParentOffset;
+	uint64_t nodeMatrixOffset;
+	uint64_t nodeMeshStartOffset;
+	uint64_t nodeMeshCountOffset;
+	uint64_t nodeMeshIndexOffset;
+	uint64_t lodTableOffset;
+	uint64_t lodIndexOffset;
+	uint64_t fileSize;
+};
+
+// Where each mesh lives inside the shared vertex/index arrays
+struct MeshCacheEntry {
+	uint64_t firstVertex;
+	uint64_t vertexCnt;
+	uint64_t firstIndex;
+	uint64_t indexCnt;
+	uint64_t firstLOD;				// Into the LOD table
+	uint64_t lodCnt;
+	uint64_t firstLODIndex;			// Into the LOD index array
+	uint64_t lodIndexCnt;
+};
+
+// Opened cache; pointers refer directly into the mapped file
+struct MeshCache {
+	MappedFile file;
+	const MeshCacheHeader *header = nullptr;
+	const MeshCacheEntry *meshes = nullptr;
+	const Vertex *vertices = nullptr;
+	const unsigned int *indices = nullptr;
+	const MeshLOD *lods = nullptr;
+	const unsigned int *lodIndices = nullptr;
+};
+
+bool mapFileReadOnly(string filename, MappedFile &mf);
+void unmapFile(MappedFile &mf);
+uint64_t hashFile(string filename);
+
+bool writeMeshCache(string cacheFilename, uint64_t sourceHash, vector<Mesh> &allMeshes, SceneGraph &sg);
+bool openMeshCache(string cacheFilename, uint64_t sourceHash, MeshCache &cache);
+int getCachedMeshCount(MeshCache &cache);
+void createMeshGLFromCache(MeshCache &cache, int meshIndex, MeshGL &mgl, VertexFormat format = VERTEX_FORMAT_FULL);
+void createMeshBatchGLFromCache(MeshCache &cache, MeshBatchGL &batch, VertexFormat format = VERTEX_FORMAT_FULL);
+void getMeshFromCache(MeshCache &cache, int meshIndex, Mesh &m);
+void getSceneGraphFromCache(MeshCache &cache, SceneGraph &sg);
+void closeMeshCache(MeshCache &cache);
+
+#endif
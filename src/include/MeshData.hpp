@@ -3,6 +3,7 @@
 
 #include <iostream>
 #include <vector>
+#include <cstdint>
 #include "glm/glm.hpp"
 using namespace std;
 
@@ -15,10 +16,44 @@ struct Vertex {
 	glm::vec3 tangent = glm::vec3(1,0,0);
 };
 
+// One simplified level of detail; indices refer to the same vertices as the full mesh
+struct MeshLOD {
+	unsigned int firstIndex = 0;	// Into Mesh::lodIndices
+	unsigned int indexCnt = 0;
+	float error = 0.0f;				// Max. geometric deviation from the full mesh (object space)
+};
+
 // Struct for holding mesh data
 struct Mesh {
 	vector<Vertex> vertices;
 	vector<unsigned int> indices;
+	vector<unsigned int> lodIndices;	// All simplified levels back to back (see MeshLOD.hpp)
+	vector<MeshLOD> lods;				// Coarser and coarser; the full mesh (indices) is not included
+};
+
+// Vertex layouts available on the GPU side
+enum VertexFormat {
+	VERTEX_FORMAT_FULL,				// Vertex as-is (76 bytes)
+	VERTEX_FORMAT_PACKED,			// PackedVertex (28 bytes)
+	VERTEX_FORMAT_PACKED_QUANT		// QuantVertex (24 bytes); positions need the mesh's dequantization matrix
+};
+
+// Compact vertex: normals/tangents as snorm 10_10_10_2, half-float UVs, unorm8 color
+struct PackedVertex {
+	glm::vec3 position;
+	uint8_t color[4];
+	uint32_t normal;
+	uint32_t texcoord;
+	uint32_t tangent;
+};
+
+// Same as PackedVertex, but position is unorm16 inside the mesh's bounding box
+struct QuantVertex {
+	uint16_t position[4];			// Last component is padding
+	uint8_t color[4];
+	uint32_t normal;
+	uint32_t texcoord;
+	uint32_t tangent;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,16 @@
+#ifndef MESH_EXTRACT_H
+#define MESH_EXTRACT_H
+
+#include <iostream>
+#include <vector>
+#include <assimp/scene.h>
+#include "glm/glm.hpp"
+#include "MeshData.hpp"
+#include "ThreadPool.hpp"
+using namespace std;
+
+void extractMeshDataFast(const aiMesh *mesh, Mesh &m, glm::vec4 defaultColor = glm::vec4(1,1,1,1));
+void extractAllMeshData(const aiScene *scene, vector<Mesh> &allMeshes, ThreadPool &pool,
+						glm::vec4 defaultColor = glm::vec4(1,1,1,1));
+
+#endif
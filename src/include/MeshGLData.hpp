@@ -9,16 +9,49 @@
 #include "MeshData.hpp"
 using namespace std;
 
+// Per-instance model matrix as a vertex attribute (a mat4 takes four locations: 6..9)
+#define INSTANCE_MODEL_MAT_LOCATION 6
+// ...or read from an SSBO with gl_InstanceID
+#define INSTANCE_SSBO_BINDING 9
+
 // Struct for holding OpenGL mesh
 struct MeshGL {
 	GLuint VBO = 0;
 	GLuint EBO = 0;
 	GLuint VAO = 0;
 	int indexCnt = 0;
+	VertexFormat format = VERTEX_FORMAT_FULL;
+	// Maps quantized positions back to object space (identity unless VERTEX_FORMAT_PACKED_QUANT);
+	// multiply the model matrix by this one for positions only.
+	glm::mat4 dequantMat = glm::mat4(1.0);
 };
 
-void createMeshGL(Mesh &m, MeshGL &mgl);
+size_t getVertexStride(VertexFormat format);
+void packVertices(const Vertex *vertices, size_t vertCnt, VertexFormat format, 
+					vector<unsigned char> &data, glm::mat4 &dequantMat);
+void packVertices(Mesh &m, VertexFormat format, vector<unsigned char> &data, glm::mat4 &dequantMat);
+void setupVertexAttributes(VertexFormat format);
+
+void createMeshGL(const Vertex *vertices, size_t vertCnt, 
+					const unsigned int *indices, size_t indexCnt,
+					MeshGL &mgl, VertexFormat format = VERTEX_FORMAT_FULL);
+void createMeshGL(Mesh &m, MeshGL &mgl, VertexFormat format = VERTEX_FORMAT_FULL);
 void drawMesh(MeshGL &mgl);
 void cleanupMesh(MeshGL &mgl);
 
+// One model matrix per instance; the same buffer works for both instancing paths.
+// For VERTEX_FORMAT_PACKED_QUANT meshes, multiply each matrix by the mesh's dequantMat first.
+struct InstanceBufferGL {
+	GLuint buffer = 0;
+	int capacity = 0;			// In instances
+	int instanceCnt = 0;
+};
+
+void createInstanceBufferGL(InstanceBufferGL &ib, int capacity);
+void updateInstanceBufferGL(InstanceBufferGL &ib, const glm::mat4 *modelMats, int instanceCnt);
+void attachInstanceBuffer(MeshGL &mgl, InstanceBufferGL &ib);
+void drawMeshInstanced(MeshGL &mgl, InstanceBufferGL &ib);
+void drawMeshInstancedSSBO(MeshGL &mgl, InstanceBufferGL &ib, GLuint binding = INSTANCE_SSBO_BINDING);
+void cleanupInstanceBufferGL(InstanceBufferGL &ib);
+
 #endif
@@ -0,0 +1,28 @@
+#ifndef MESH_LOD_H
+#define MESH_LOD_H
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include "glm/glm.hpp"
+#include "MeshData.hpp"
+#include "ThreadPool.hpp"
+using namespace std;
+
+// Defaults for generateMeshLODs()
+#define MESH_LOD_MAX_CNT 4				// Levels besides the full mesh
+#define MESH_LOD_REDUCTION 0.5f			// Triangle count of each level vs. the previous one
+#define MESH_LOD_MIN_TRIANGLES 16		// Don't bother simplifying below this
+
+float simplifyMeshIndices(const Mesh &m, const unsigned int *indices, size_t indexCnt,
+							size_t targetIndexCnt, vector<unsigned int> &result);
+void generateMeshLODs(Mesh &m, int maxLODCnt = MESH_LOD_MAX_CNT, float reduction = MESH_LOD_REDUCTION);
+void generateAllMeshLODs(vector<Mesh> &allMeshes, ThreadPool &pool,
+							int maxLODCnt = MESH_LOD_MAX_CNT, float reduction = MESH_LOD_REDUCTION);
+
+float getMatrixMaxScale(const glm::mat4 &m);
+float getScreenSpaceError(float error, float distance, const glm::mat4 &projMat, float viewportHeight);
+int selectMeshLOD(const vector<MeshLOD> &lods, float scale, float distance,
+					const glm::mat4 &projMat, float viewportHeight, float maxPixelError = 1.0f);
+
+#endif
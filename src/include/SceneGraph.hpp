@@ -0,0 +1,34 @@
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <assimp/scene.h>
+#include "glm/glm.hpp"
+using namespace std;
+
+// Flattened node hierarchy, stored as parallel arrays (one entry per node).
+// Nodes are kept in depth-first pre-order, so a parent always comes before
+// its children and the subtree of node i is the range [i, subtreeEnd[i]).
+struct SceneGraph {
+	vector<int> parents;					// -1 for the root
+	vector<int> subtreeEnd;
+	vector<glm::mat4> localMats;
+	vector<glm::mat4> worldMats;
+	vector<glm::mat3> normalMats;			// transpose(inverse(mat3(worldMat)))
+	vector<unsigned int> meshStarts;		// First entry in meshIndices
+	vector<unsigned int> meshCounts;
+	vector<unsigned int> meshIndices;		// Indices into the scene's mesh list
+	vector<unsigned char> dirty;
+	bool anyDirty = false;
+};
+
+void flattenSceneGraph(aiNode *root, SceneGraph &sg);
+void finalizeSceneGraph(SceneGraph &sg);
+void setLocalTransform(SceneGraph &sg, int nodeIndex, const glm::mat4 &localMat);
+void updateSceneGraph(SceneGraph &sg);
+int getNodeCount(SceneGraph &sg);
+void cleanupSceneGraph(SceneGraph &sg);
+
+#endif
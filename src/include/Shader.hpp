@@ -5,6 +5,10 @@
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <chrono>
+#include <filesystem>
 #include <GL/glew.h>					
 #include <GLFW/glfw3.h>
 #include "glm/glm.hpp"
@@ -15,5 +19,46 @@ void printShaderCode(string &vertexCode, string &fragCode);
 GLuint createAndCompileShader(const char *shaderCode, GLenum shaderType);
 GLuint createAndLinkShaderProgram(std::vector<GLuint> allShaderIDs);
 GLuint initShaderProgramFromSource(string vertexShaderCode, string fragmentShaderCode);
+GLuint initComputeProgramFromSource(string computeShaderCode);
+string insertShaderDefines(string shaderCode, string defines);
+
+// Program cache: linked binaries are stored on disk (one file per program and driver,
+// replaced when the sources change), uniform/UBO locations are looked up once per link,
+// and watched files are recompiled when they change on disk.
+// Used by Assign07 and InstancingBenchmark; the other apps still compile directly.
+#define SHADER_CACHE_DIR "./build/shadercache"
+#define SHADER_RELOAD_INTERVAL 0.5		// Seconds between file timestamp checks
+
+struct ShaderProgram {
+	GLuint programID = 0;
+	vector<string> filenames;
+	vector<GLenum> stages;
+	vector<filesystem::file_time_type> fileTimes;
+	string defines = "";
+	bool watch = true;
+	int version = 0;						// Bumped on every successful reload
+	unordered_map<string, GLint> uniforms;		// Also "name" for arrays reported as "name[0]"
+	unordered_map<string, GLuint> uniformBlocks;
+};
+
+struct ShaderCache {
+	string cacheDir = SHADER_CACHE_DIR;
+	string driverString = "";				// Vendor, renderer and version; binaries only match the same driver
+	bool binarySupported = false;
+	vector<ShaderProgram> programs;
+	chrono::steady_clock::time_point lastCheck;
+	int binaryHitCnt = 0;
+	int binaryMissCnt = 0;
+};
+
+GLenum getShaderStageFromFilename(string filename);
+void createShaderCache(ShaderCache &cache, string cacheDir = SHADER_CACHE_DIR);
+int loadShaderProgram(ShaderCache &cache, vector<string> filenames, string defines = "", bool watch = true);
+GLuint getShaderProgramID(ShaderCache &cache, int handle);
+int getShaderProgramVersion(ShaderCache &cache, int handle);
+GLint getShaderUniform(ShaderCache &cache, int handle, string name);
+GLuint getShaderUniformBlock(ShaderCache &cache, int handle, string name);
+bool reloadChangedShaders(ShaderCache &cache);
+void cleanupShaderCache(ShaderCache &cache);
 
 #endif
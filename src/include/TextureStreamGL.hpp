@@ -0,0 +1,89 @@
+#ifndef TEXTURE_STREAM_GL_H
+#define TEXTURE_STREAM_GL_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "glm/glm.hpp"
+#include "ThreadPool.hpp"
+using namespace std;
+
+#define TEXTURE_STREAM_THREAD_CNT 2
+#define TEXTURE_STREAM_PBO_CNT 3							// Upload buffers in flight
+#define TEXTURE_STREAM_BYTES_PER_FRAME (4*1024*1024)		// Upload budget (also the PBO size)
+
+// Optional block compression done on the worker threads
+enum TextureCompression {
+	TEXTURE_COMPRESSION_NONE,		// RGBA8
+	TEXTURE_COMPRESSION_BC1,		// RGB, 4 bpp (color maps without alpha)
+	TEXTURE_COMPRESSION_BC3,		// RGBA, 8 bpp
+	TEXTURE_COMPRESSION_BC5			// RG, 8 bpp (tangent-space normal maps; rebuild z in the shader)
+};
+
+// One mip level, ready to upload (tightly packed RGBA8 or 4x4 blocks)
+struct TextureMipData {
+	int width = 0;
+	int height = 0;
+	vector<unsigned char> data;
+};
+
+// Output of a worker thread
+struct DecodedTexture {
+	int handle = -1;
+	bool ok = false;
+	TextureCompression compression = TEXTURE_COMPRESSION_NONE;
+	vector<TextureMipData> mips;			// Level 0 first
+};
+
+struct StreamedTexture {
+	string filename;
+	TextureCompression compression = TEXTURE_COMPRESSION_NONE;
+	GLuint texID = 0;
+	int width = 0;
+	int height = 0;
+	int mipCnt = 0;
+	int residentLevel = -1;					// Finest level uploaded so far (-1 = nothing yet)
+	bool failed = false;
+	shared_ptr<DecodedTexture> pending;		// Kept until every level is uploaded
+	int uploadLevel = -1;					// Level currently being uploaded (coarsest first)
+	int uploadRow = 0;						// Next pixel row (block row when compressed) of that level
+};
+
+// Decodes images on worker threads and uploads them through a ring of PBOs,
+// at most bytesPerFrame per updateTextureStreamer() call. Levels go up coarsest
+// first, so a texture can be sampled (blurry) long before it is complete.
+struct TextureStreamer {
+	ThreadPool pool;
+	mutex lock;
+	vector<shared_ptr<DecodedTexture>> finished;	// Guarded by lock
+	vector<StreamedTexture> textures;
+	vector<int> uploadQueue;
+	GLuint pbos[TEXTURE_STREAM_PBO_CNT] = {};
+	GLsync fences[TEXTURE_STREAM_PBO_CNT] = {};
+	int pboIndex = 0;
+	size_t bytesPerFrame = TEXTURE_STREAM_BYTES_PER_FRAME;
+	GLuint placeholderTexID = 0;			// 1x1 mid-gray, used until a texture has any level
+	bool s3tcSupported = false;
+	size_t uploadedBytes = 0;
+	int pendingCnt = 0;						// Requested but not fully uploaded
+};
+
+void createTextureStreamer(TextureStreamer &ts, size_t bytesPerFrame = TEXTURE_STREAM_BYTES_PER_FRAME);
+int requestTexture(TextureStreamer &ts, string filename,
+					TextureCompression compression = TEXTURE_COMPRESSION_NONE);
+void updateTextureStreamer(TextureStreamer &ts);
+GLuint getStreamedTexture(TextureStreamer &ts, int handle);
+bool isTextureComplete(TextureStreamer &ts, int handle);
+bool isStreamingDone(TextureStreamer &ts);
+void cleanupTextureStreamer(TextureStreamer &ts);
+
+bool loadTextureRGBA(string filename, vector<unsigned char> &rgba, int &width, int &height);
+void generateMipChain(const unsigned char *rgba, int width, int height, vector<TextureMipData> &mips);
+void compressTextureMip(const TextureMipData &src, TextureCompression compression, TextureMipData &dst);
+
+#endif
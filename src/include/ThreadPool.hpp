@@ -0,0 +1,36 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <iostream>
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+using namespace std;
+
+#define PARALLEL_FOR_CHUNKS_PER_THREAD 4		// parallelFor() load balancing vs. per-chunk overhead
+
+// Fixed set of worker threads pulling tasks from a shared queue
+struct ThreadPool {
+	vector<thread> workers;
+	queue<function<void()>> tasks;
+	mutex lock;
+	condition_variable taskReady;
+	condition_variable allDone;
+	int busyCnt = 0;
+	bool stopping = false;
+};
+
+int getDefaultThreadCount();
+void createThreadPool(ThreadPool &pool, int threadCnt = 0);
+void submitTask(ThreadPool &pool, function<void()> task);
+void waitForTasks(ThreadPool &pool);
+void parallelFor(ThreadPool &pool, int count, function<void(int)> func);
+void cleanupThreadPool(ThreadPool &pool);
+
+#endif
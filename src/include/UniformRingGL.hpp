@@ -0,0 +1,38 @@
+#ifndef UNIFORM_RING_GL_H
+#define UNIFORM_RING_GL_H
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include "glm/glm.hpp"
+using namespace std;
+
+// Frames the CPU may run ahead of the GPU before beginUniformFrame() waits
+#define UNIFORM_RING_FRAME_CNT 3
+
+// One uniform buffer split into a region per frame in flight. With ARB_buffer_storage
+// the buffer stays persistently mapped and each region is guarded by a fence;
+// otherwise writes fall back to glBufferSubData.
+struct UniformRingGL {
+	GLuint buffer = 0;
+	unsigned char *mapped = nullptr;
+	GLsync fences[UNIFORM_RING_FRAME_CNT] = {};
+	GLsizeiptr regionSize = 0;
+	GLint alignment = 256;				// GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+	int frameIndex = 0;
+	GLsizeiptr writeOffset = 0;			// Within the current region
+	double waitMS = 0.0;				// Time spent waiting on fences (last frame)
+};
+
+void createUniformRingGL(UniformRingGL &ring, GLsizeiptr bytesPerFrame);
+void beginUniformFrame(UniformRingGL &ring);
+GLintptr pushUniformData(UniformRingGL &ring, const void *data, GLsizeiptr size);
+void bindUniformRange(UniformRingGL &ring, GLuint binding, GLintptr offset, GLsizeiptr size);
+GLintptr pushAndBindUniformData(UniformRingGL &ring, GLuint binding, const void *data, GLsizeiptr size);
+void endUniformFrame(UniformRingGL &ring);
+void cleanupUniformRingGL(UniformRingGL &ring);
+
+#endif
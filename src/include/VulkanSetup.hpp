@@ -22,11 +22,18 @@
 #include <limits>
 #include <algorithm>
 #include <fstream>
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <functional>
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/vec4.hpp>
+#include "MeshData.hpp"
+#include "ThreadPool.hpp"
 #include <glm/mat4x4.hpp>
 
 using namespace std;
@@ -34,7 +41,7 @@ using namespace std;
 ///////////////////////////////////////////////////////////////////////////////
 // GLFW window creation
 ///////////////////////////////////////////////////////////////////////////////
-GLFWwindow* createVulkanWindow(const char* windowName, int windowWidth, int windowHeight);
+GLFWwindow* createVulkanWindow(const char* windowName, int windowWidth, int windowHeight, bool resizable = false);
 void cleanupVulkanWindow(GLFWwindow *window);
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -67,6 +74,7 @@ string getVulkanPhysicalDeviceName(vk::PhysicalDevice physicalDevice);
 struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsFamily; // If uninitialized, graphicsFamily.has_value() returns false
     std::optional<uint32_t> presentFamily;  // COULD be different from graphics family queue
+    std::optional<uint32_t> transferFamily; // Dedicated transfer-only family (if the device has one)
 
     bool isComplete() {
         return (graphicsFamily.has_value()
@@ -118,10 +126,8 @@ void cleanupVulkanRenderPass(vk::Device &device, vk::RenderPass &pass);
 // Vulkan vertex buffer
 ///////////////////////////////////////////////////////////////////////////////
 
-struct VulkanVertex {
-    glm::vec3 pos;
-    glm::vec3 color;    
-};
+// Same layout as the OpenGL side (Vertex from MeshData.hpp), so Assimp meshes work on both
+typedef Vertex VulkanVertex;
 
 vk::VertexInputBindingDescription getVertexBindingDescription();
 vector<vk::VertexInputAttributeDescription> getAttributeDescriptions();
@@ -132,19 +138,36 @@ vector<vk::VertexInputAttributeDescription> getAttributeDescriptions();
 
 struct PipelineData {
     vk::PipelineCache cache;
+    bool ownsCache = true;             // False if cache was passed in (shared)
     vk::PipelineLayout pipelineLayout; // Necessary for passing in uniform variables
     vk::Pipeline graphicsPipeline;
 };
 
+// Pipeline cache that persists between runs
+struct VulkanPipelineCache {
+    vk::PipelineCache cache;
+    string filename;                   // Includes device UUID and driver version
+    size_t loadedBytes = 0;            // 0 if we started cold
+};
+
 static std::vector<char> readBinaryFile(const std::string& filename);
 vk::ShaderModule createShaderModule(vk::Device &device, const std::vector<char>& code);
 PipelineData createGraphicsPipelineData(  vk::Device &device,
                                             SwapChainData &swapChainData,
                                             vk::RenderPass &renderPass, 
                                             string vertSPVFilename, 
-                                            string fragSPVFilename);
+                                            string fragSPVFilename,
+                                            vk::PipelineCache sharedCache = vk::PipelineCache(),
+                                            const vector<vk::DescriptorSetLayout> &setLayouts = {},
+                                            const vector<vk::PushConstantRange> &pushConstantRanges = {});
 void cleanupGraphicsPipelineData(vk::Device &device, PipelineData &data);
 
+string getVulkanPipelineCacheFilename(vk::PhysicalDevice &physicalDevice, string baseFilename);
+VulkanPipelineCache createVulkanPipelineCache(vk::PhysicalDevice &physicalDevice, vk::Device &device,
+                                                string baseFilename);
+bool saveVulkanPipelineCache(vk::Device &device, VulkanPipelineCache &pipelineCache);
+void cleanupVulkanPipelineCache(vk::Device &device, VulkanPipelineCache &pipelineCache);
+
 ///////////////////////////////////////////////////////////////////////////////
 // Vulkan framebuffers
 ///////////////////////////////////////////////////////////////////////////////
@@ -172,23 +195,139 @@ void cleanupVulkanSemaphore(vk::Device &device, vk::Semaphore &s);
 void cleanupVulkanFence(vk::Device &device, vk::Fence &f);
 
 ///////////////////////////////////////////////////////////////////////////////
-// Vulkan mesh
+// Vulkan frame loop
+///////////////////////////////////////////////////////////////////////////////
+
+#define MAX_FRAMES_IN_FLIGHT 2
+
+// Everything one in-flight frame owns; reused once its fence signals
+struct VulkanFrameData {
+    vk::CommandBuffer commandBuffer;
+    vk::Semaphore imageAvailable;
+    vk::Fence inFlight;
+};
+
+// CPU-side timings of the last frame (milliseconds)
+struct VulkanFrameTimings {
+    double frameMS = 0.0;       // Start of one frame to start of the next
+    double fenceWaitMS = 0.0;   // Waiting for this slot's previous submission (and the image's, if still in use)
+    double acquireMS = 0.0;     // Waiting for a swap chain image
+    double recordMS = 0.0;      // From commandBuffer.begin() until endVulkanFrame() (no fence waits)
+    double submitMS = 0.0;      // Submit + present
+};
+
+struct VulkanFrameLoop {
+    vk::CommandPool commandPool;
+    vector<VulkanFrameData> frames;
+    vector<vk::Semaphore> renderFinished;   // One per swap chain image (presentation holds it until shown)
+    vector<vk::Fence> imagesInFlight;       // Fence of the frame that last used each image
+    uint32_t currentFrame = 0;
+    uint32_t imageIndex = 0;
+    bool framebufferResized = false;
+    bool frameStarted = false;
+    unsigned long long frameCnt = 0;
+    VulkanFrameTimings timings;
+    chrono::steady_clock::time_point frameStart;
+    chrono::steady_clock::time_point recordStart;
+};
+
+VulkanFrameLoop createVulkanFrameLoop(  vk::Device &device, QueueFamilyIndices &indices,
+                                        SwapChainData &swapChainData,
+                                        int framesInFlight = MAX_FRAMES_IN_FLIGHT);
+void watchVulkanWindowResize(GLFWwindow *window, VulkanFrameLoop &loop);
+bool beginVulkanFrame(vk::Device &device, SwapChainData &swapChainData, VulkanFrameLoop &loop);
+vk::CommandBuffer& getVulkanFrameCommandBuffer(VulkanFrameLoop &loop);
+bool endVulkanFrame(vk::Device &device, vk::Queue &graphicsQueue, vk::Queue &presentQueue,
+                    SwapChainData &swapChainData, VulkanFrameLoop &loop);
+void recreateVulkanSwapChain(GLFWwindow *window, vk::PhysicalDevice physicalDevice,
+                            vk::Device &device, vk::SurfaceKHR surface, QueueFamilyIndices indices,
+                            SwapChainData &swapChainData, vk::RenderPass &renderPass,
+                            vector<vk::Framebuffer> &framebuffers, VulkanFrameLoop &loop);
+void cleanupVulkanFrameLoop(vk::Device &device, VulkanFrameLoop &loop);
+
 ///////////////////////////////////////////////////////////////////////////////
+// Vulkan memory allocator
+///////////////////////////////////////////////////////////////////////////////
+
+// Default size of each vk::DeviceMemory block (bigger requests get their own block)
+#define VULKAN_MEMORY_BLOCK_SIZE (64ull*1024ull*1024ull)
+
+struct VulkanMemoryRange {
+    vk::DeviceSize offset = 0;
+    vk::DeviceSize size = 0;
+};
+
+// One big vk::DeviceMemory carved up with a first-fit free list
+struct VulkanMemoryBlock {
+    vk::DeviceMemory memory;
+    vk::DeviceSize size = 0;
+    vk::DeviceSize usedBytes = 0;
+    int allocationCnt = 0;
+    vector<VulkanMemoryRange> freeRanges;   // Sorted by offset, neighbors always merged
+    void *mapped = nullptr;                 // Whole block stays mapped if host visible
+};
+
+// All blocks of one memory type
+struct VulkanMemoryPool {
+    vector<VulkanMemoryBlock> blocks;
+};
+
+struct VulkanAllocation {
+    vk::DeviceMemory memory;
+    vk::DeviceSize offset = 0;
+    vk::DeviceSize size = 0;
+    uint32_t memoryTypeIndex = 0;
+    int blockIndex = -1;
+    void *mapped = nullptr;                 // Points at offset (nullptr if not host visible)
+};
 
-struct HostMesh {
-    vector<VulkanVertex> vertices {};
-    vector<uint16_t> indices {};
+struct VulkanMemoryStats {
+    int deviceAllocationCnt = 0;            // Actual vkAllocateMemory calls alive
+    int allocationCnt = 0;                  // Sub-allocations alive
+    vk::DeviceSize reservedBytes = 0;
+    vk::DeviceSize usedBytes = 0;
+    vk::DeviceSize largestFreeRange = 0;
+    int freeRangeCnt = 0;
 };
 
+struct VulkanAllocator {
+    vk::PhysicalDevice physicalDevice;
+    vk::Device device;
+    vk::PhysicalDeviceMemoryProperties memProperties;
+    vk::DeviceSize blockSize = VULKAN_MEMORY_BLOCK_SIZE;
+    uint32_t maxAllocationCnt = 0;
+    vector<VulkanMemoryPool> pools;         // Indexed by memory type
+};
+
+VulkanAllocator createVulkanAllocator(vk::PhysicalDevice &physicalDevice, vk::Device &device,
+                                        vk::DeviceSize blockSize = VULKAN_MEMORY_BLOCK_SIZE);
+VulkanAllocation allocateVulkanMemory(VulkanAllocator &allocator, vk::MemoryRequirements memRequirements,
+                                        vk::MemoryPropertyFlags properties);
+void freeVulkanMemory(VulkanAllocator &allocator, VulkanAllocation &allocation);
+VulkanMemoryStats getVulkanMemoryStats(VulkanAllocator &allocator);
+void printVulkanMemoryStats(VulkanAllocator &allocator);
+void cleanupVulkanAllocator(VulkanAllocator &allocator);
+
+///////////////////////////////////////////////////////////////////////////////
+// Vulkan mesh
+///////////////////////////////////////////////////////////////////////////////
+
+// Indices are always kept as 32-bit on the host; the GPU copy is narrowed when it fits
+typedef Mesh HostMesh;
+
 struct VulkanBuffer {
     vk::Buffer buffer;
     vk::DeviceMemory memory;
+    vk::DeviceSize offset = 0;              // Where the buffer starts inside memory
+    VulkanAllocator *allocator = nullptr;   // Set if memory came from a VulkanAllocator
+    VulkanAllocation allocation;
 };
 
 struct VulkanMesh {
     VulkanBuffer vertices;
     VulkanBuffer indices;
     int indexCnt = 0;
+    vk::IndexType indexType = vk::IndexType::eUint32;
 };
 
 uint32_t findMemoryType(vk::PhysicalDevice &physicalDevice, uint32_t typeFilter, 
@@ -197,14 +336,135 @@ VulkanBuffer createVulkanBuffer(vk::PhysicalDevice &physicalDevice,
                                 vk::Device &device,
                                 vk::DeviceSize size,
                                 vk::BufferUsageFlags usage,
-                                vk::MemoryPropertyFlags properties);
+                                vk::MemoryPropertyFlags properties,
+                                const vector<uint32_t> &sharingFamilies = {});
+VulkanBuffer createVulkanBuffer(VulkanAllocator &allocator,
+                                vk::DeviceSize size,
+                                vk::BufferUsageFlags usage,
+                                vk::MemoryPropertyFlags properties,
+                                const vector<uint32_t> &sharingFamilies = {});
 void copyDataToVulkanBuffer(vk::Device &device, vk::DeviceMemory memory, size_t bufferSize, void *hostData);
+void copyDataToVulkanBuffer(vk::Device &device, VulkanBuffer &buffer, size_t bufferSize, void *hostData);
 
 VulkanMesh createVulkanMesh(vk::PhysicalDevice &physicalDevice,
                             vk::Device &device,
                             HostMesh &hostMesh);   
+VulkanMesh createVulkanMesh(VulkanAllocator &allocator, HostMesh &hostMesh);
+
+vk::IndexType chooseVulkanIndexType(HostMesh &hostMesh);
+size_t getVulkanIndexSize(vk::IndexType indexType);
+void packVulkanIndices(HostMesh &hostMesh, vk::IndexType indexType, vector<unsigned char> &indexData);
 
 void drawVulkanMesh(vk::CommandBuffer &commandBuffer, VulkanMesh &mesh);                      
+void bindVulkanMesh(vk::CommandBuffer &commandBuffer, VulkanMesh &mesh);
+void drawBoundVulkanMesh(vk::CommandBuffer &commandBuffer, VulkanMesh &mesh);
 
 void cleanupVulkanBuffer(vk::Device &device, VulkanBuffer &data);
 void cleanupVulkanMesh(vk::Device &device, VulkanMesh &mesh);
+
+///////////////////////////////////////////////////////////////////////////////
+// Vulkan staging uploads
+///////////////////////////////////////////////////////////////////////////////
+
+// One pending copy from the shared staging buffer into a device-local buffer
+struct VulkanPendingCopy {
+    vk::Buffer dst;
+    vk::DeviceSize stagingOffset = 0;
+    vk::DeviceSize size = 0;
+};
+
+// Collects uploads and submits them together (one staging buffer, one submit, one fence wait)
+struct VulkanUploadContext {
+    vk::PhysicalDevice physicalDevice;
+    vk::Device device;
+    vk::Queue queue;
+    uint32_t queueFamily = 0;
+    vector<uint32_t> sharingFamilies;       // Graphics + transfer families if they differ
+    vk::CommandPool commandPool;
+    vk::CommandBuffer commandBuffer;
+    vk::Fence fence;
+    vector<unsigned char> stagingData;
+    vector<VulkanPendingCopy> pendingCopies;
+    VulkanAllocator *allocator = nullptr;   // Optional; otherwise one allocation per buffer
+};
+
+VulkanUploadContext createVulkanUploadContext(vk::PhysicalDevice &physicalDevice,
+                                                vk::Device &device,
+                                                QueueFamilyIndices &indices,
+                                                bool useTransferQueue = true,
+                                                VulkanAllocator *allocator = nullptr);
+VulkanBuffer createDeviceLocalBuffer(VulkanUploadContext &upload, const void *hostData,
+                                        vk::DeviceSize size, vk::BufferUsageFlags usage);
+VulkanMesh createVulkanMeshDeviceLocal(VulkanUploadContext &upload, HostMesh &hostMesh);
+void flushVulkanUploads(VulkanUploadContext &upload);
+void cleanupVulkanUploadContext(VulkanUploadContext &upload);
+
+///////////////////////////////////////////////////////////////////////////////
+// Vulkan uniforms and push constants
+///////////////////////////////////////////////////////////////////////////////
+
+// Per-draw data pushed straight into the command buffer (128 bytes is the guaranteed minimum)
+struct VulkanDrawConstants {
+    glm::mat4 modelMat;
+    glm::mat4 normalMat;
+};
+
+// One host-visible buffer split into a region per frame in flight; each frame's
+// uniforms are appended to its region and bound with dynamic offsets, so nothing
+// is allocated or rewritten while the GPU may still be reading it
+struct VulkanUniformRing {
+    VulkanBuffer buffer;
+    unsigned char *mapped = nullptr;
+    vk::DeviceSize alignment = 256;         // minUniformBufferOffsetAlignment
+    vk::DeviceSize frameSize = 0;           // Bytes per frame region
+    int frameCnt = 0;                       // Regions (must match the frame loop's frames in flight)
+    vk::DeviceSize frameStart = 0;
+    vk::DeviceSize head = 0;                // Next free byte in current region
+    vector<vk::DeviceSize> bindingSizes;    // One dynamic uniform buffer per binding
+    vk::DescriptorSetLayout setLayout;
+    vk::DescriptorPool descriptorPool;
+    vk::DescriptorSet descriptorSet;
+};
+
+vk::PushConstantRange getVulkanDrawConstantsRange();
+void pushVulkanDrawConstants(vk::CommandBuffer &commandBuffer, vk::PipelineLayout &layout,
+                                const glm::mat4 &modelMat);
+
+VulkanUniformRing createVulkanUniformRing(VulkanAllocator &allocator,
+                                            vk::DeviceSize bytesPerFrame,
+                                            const vector<vk::DeviceSize> &bindingSizes,
+                                            vk::ShaderStageFlags stages = vk::ShaderStageFlagBits::eVertex
+                                                                        | vk::ShaderStageFlagBits::eFragment,
+                                            int framesInFlight = MAX_FRAMES_IN_FLIGHT);
+void beginVulkanUniformFrame(VulkanUniformRing &ring, int frameIndex);
+uint32_t pushVulkanUniformData(VulkanUniformRing &ring, const void *data, vk::DeviceSize size);
+void bindVulkanUniformRing(vk::CommandBuffer &commandBuffer, vk::PipelineLayout &layout,
+                            VulkanUniformRing &ring, const vector<uint32_t> &dynamicOffsets);
+void cleanupVulkanUniformRing(vk::Device &device, VulkanUniformRing &ring);
+
+///////////////////////////////////////////////////////////////////////////////
+// Vulkan parallel command recording
+///////////////////////////////////////////////////////////////////////////////
+
+// A command pool may only be used by one thread at a time, so every partition
+// of the draw list gets its own pool (one per frame in flight, reset as a whole)
+struct VulkanRecordPartition {
+    vector<vk::CommandPool> commandPools;
+    vector<vk::CommandBuffer> secondaries;
+};
+
+struct VulkanParallelRecorder {
+    vector<VulkanRecordPartition> partitions;
+};
+
+// Records draws [first, last) into a secondary command buffer (must bind its own pipeline/state)
+typedef function<void(vk::CommandBuffer &commandBuffer, int first, int last)> VulkanRecordFunc;
+
+VulkanParallelRecorder createVulkanParallelRecorder(vk::Device &device, QueueFamilyIndices &indices,
+                                                    int maxThreadCnt,
+                                                    int framesInFlight = MAX_FRAMES_IN_FLIGHT);
+void recordVulkanSecondaries(vk::Device &device, ThreadPool &threadPool, VulkanParallelRecorder &recorder,
+                                vk::CommandBuffer &primary, uint32_t frameIndex, int threadCnt,
+                                vk::RenderPass &renderPass, vk::Framebuffer &framebuffer,
+                                int drawCnt, VulkanRecordFunc recordDraws);
+void cleanupVulkanParallelRecorder(vk::Device &device, VulkanParallelRecorder &recorder);
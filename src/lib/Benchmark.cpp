@@ -0,0 +1,245 @@
+#include <cstdlib>
+#include <cstdio>
+#include <cctype>
+#include <climits>
+#include "Benchmark.hpp"
+
+// Keep stb_image_write private to this file (VerifyVulkan has its own copy)
+#define STB_IMAGE_WRITE_STATIC
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+// Pull benchmark options out of argv; everything else is returned in order
+bool parseBenchmarkArgs(int argc, char **argv, BenchmarkSettings &settings, vector<string> &otherArgs) {
+	otherArgs.clear();
+	for(int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		bool hasValue = (i + 1 < argc);
+
+		// Options that need a value must not fall through and become a positional argument
+		bool needsValue = (arg == "--bench-warmup" || arg == "--bench-size"
+							|| arg == "--bench-stats" || arg == "--bench-screenshot");
+		if(needsValue && !hasValue) {
+			cerr << "ERROR: Missing value for " << arg << endl;
+			return false;
+		}
+
+		if(arg == "--benchmark") {
+			settings.enabled = true;
+			// Optional frame count; only taken if the next argument is a plain number
+			// (so "--benchmark model.obj" keeps the model path)
+			if(hasValue) {
+				char *end = NULL;
+				long frameCnt = strtol(argv[i+1], &end, 10);
+				if(end != argv[i+1] && *end == '\0' && isdigit((unsigned char)argv[i+1][0])
+					&& frameCnt > 0 && frameCnt <= INT_MAX) {
+					settings.frameCnt = (int)frameCnt;
+					i++;
+				}
+			}
+		}
+		else if(arg == "--bench-warmup") {
+			settings.warmupCnt = max(0, atoi(argv[++i]));
+		}
+		else if(arg == "--bench-size") {
+			int w = 0, h = 0;
+			if(sscanf(argv[++i], "%dx%d", &w, &h) == 2 && w > 0 && h > 0) {
+				settings.width = w;
+				settings.height = h;
+			}
+			else {
+				cerr << "ERROR: Bad --bench-size (expected WxH): " << argv[i] << endl;
+				return false;
+			}
+		}
+		else if(arg == "--bench-stats") {
+			settings.statsFile = argv[++i];
+		}
+		else if(arg == "--bench-screenshot") {
+			settings.screenshotFile = argv[++i];
+		}
+		else {
+			otherArgs.push_back(arg);
+		}
+	}
+	return true;
+}
+
+// Create framebuffer with color renderbuffer + depth texture
+bool createOffscreenTarget(OffscreenTarget &target, int width, int height) {
+	target.width = width;
+	target.height = height;
+
+	glGenFramebuffers(1, &(target.fbo));
+	glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+
+	glGenRenderbuffers(1, &(target.colorRBO));
+	glBindRenderbuffer(GL_RENDERBUFFER, target.colorRBO);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.colorRBO);
+
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenTextures(1, &(target.depthTexID));
+	glBindTexture(GL_TEXTURE_2D, target.depthTexID);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH24_STENCIL8, width, height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, target.depthTexID, 0);
+
+	bool complete = (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	if(!complete) {
+		cerr << "ERROR: Incomplete benchmark framebuffer!" << endl;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	return complete;
+}
+
+// Delete framebuffer and attachments
+void cleanupOffscreenTarget(OffscreenTarget &target) {
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteRenderbuffers(1, &(target.colorRBO));
+	glDeleteTextures(1, &(target.depthTexID));
+	glDeleteFramebuffers(1, &(target.fbo));
+	target = OffscreenTarget();
+}
+
+// Set up run (needs a current GL context)
+void createBenchmarkRun(BenchmarkRun &run, BenchmarkSettings &settings) {
+	run.settings = settings;
+	run.frame = 0;
+	run.frameMS.clear();
+	run.frameMS.reserve(settings.frameCnt);
+	createOffscreenTarget(run.target, settings.width, settings.height);
+
+	cout << "Benchmark: " << settings.frameCnt << " frames (+" << settings.warmupCnt << " warmup) at ";
+	cout << settings.width << "x" << settings.height << endl;
+}
+
+// Bind offscreen target and start the frame clock
+void beginBenchmarkFrame(BenchmarkRun &run) {
+	glBindFramebuffer(GL_FRAMEBUFFER, run.target.fbo);
+	glViewport(0, 0, run.target.width, run.target.height);
+
+	run.frameStart = BenchmarkRun::Clock::now();
+	if(run.frame == run.settings.warmupCnt) {
+		run.timedStart = run.frameStart;
+	}
+}
+
+// Record frame time
+void endBenchmarkFrame(BenchmarkRun &run) {
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	// Don't let the CPU queue up an unbounded number of frames
+	glFlush();
+
+	if(run.frame >= run.settings.warmupCnt) {
+		BenchmarkRun::Clock::time_point now = BenchmarkRun::Clock::now();
+		run.frameMS.push_back(chrono::duration<double, milli>(now - run.frameStart).count());
+	}
+	run.frame++;
+}
+
+bool isBenchmarkDone(BenchmarkRun &run) {
+	return run.frame >= run.settings.warmupCnt + run.settings.frameCnt;
+}
+
+// Deterministic camera: one full orbit (with a gentle bob) over the timed frames
+void getBenchmarkCamera(BenchmarkRun &run, glm::vec3 center, float radius, glm::vec3 &eye, glm::vec3 &lookAt) {
+	int timedFrame = max(0, run.frame - run.settings.warmupCnt);
+	float t = (float)timedFrame / (float)max(1, run.settings.frameCnt);
+	float angle = glm::radians(360.0f)*t;
+	float height = 0.35f*radius*glm::sin(2.0f*angle);
+
+	eye = center + glm::vec3(radius*glm::sin(angle), height, radius*glm::cos(angle));
+	lookAt = center;
+}
+
+// Value at percentile p (0-100) of sorted samples
+static double getBenchmarkPercentile(vector<double> &sorted, double p) {
+	if(sorted.empty()) return 0.0;
+	size_t index = (size_t)((p / 100.0)*(sorted.size() - 1) + 0.5);
+	return sorted[min(index, sorted.size() - 1)];
+}
+
+// Save final frame as PNG
+static bool saveBenchmarkScreenshot(BenchmarkRun &run) {
+	int w = run.target.width;
+	int h = run.target.height;
+	vector<unsigned char> pixels(w*h*4);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, run.target.fbo);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+	// OpenGL rows start at the bottom
+	stbi_flip_vertically_on_write(1);
+	bool ok = stbi_write_png(run.settings.screenshotFile.c_str(), w, h, 4, pixels.data(), w*4) != 0;
+	if(ok) cout << "Wrote screenshot: " << run.settings.screenshotFile << endl;
+	else cerr << "ERROR: Could not write screenshot: " << run.settings.screenshotFile << endl;
+	return ok;
+}
+
+// Wait for GPU, print and save statistics (and screenshot)
+void finishBenchmark(BenchmarkRun &run, string label) {
+	glFinish();
+	BenchmarkRun::Clock::time_point end = BenchmarkRun::Clock::now();
+	double totalMS = chrono::duration<double, milli>(end - run.timedStart).count();
+
+	vector<double> sorted = run.frameMS;
+	sort(sorted.begin(), sorted.end());
+	double sum = 0.0;
+	for(double ms : sorted) sum += ms;
+
+	int cnt = (int)sorted.size();
+	double avgMS = (cnt > 0) ? sum / cnt : 0.0;
+	double fps = (totalMS > 0.0) ? cnt*1000.0 / totalMS : 0.0;
+	double p50 = getBenchmarkPercentile(sorted, 50.0);
+	double p95 = getBenchmarkPercentile(sorted, 95.0);
+	double p99 = getBenchmarkPercentile(sorted, 99.0);
+	double minMS = (cnt > 0) ? sorted.front() : 0.0;
+	double maxMS = (cnt > 0) ? sorted.back() : 0.0;
+
+	cout << "BENCHMARK (" << label << "): " << cnt << " frames in " << totalMS << " ms" << endl;
+	cout << "\tThroughput: " << fps << " FPS" << endl;
+	cout << "\tFrame CPU (ms): avg " << avgMS << ", p50 " << p50 << ", p95 " << p95;
+	cout << ", p99 " << p99 << ", min " << minMS << ", max " << maxMS << endl;
+
+	if(!run.settings.statsFile.empty()) {
+		// Append so repeated runs build up a history
+		ifstream existing(run.settings.statsFile);
+		bool writeHeader = !existing.good() || existing.peek() == ifstream::traits_type::eof();
+		existing.close();
+
+		ofstream file(run.settings.statsFile, ios::app);
+		if(file) {
+			if(writeHeader) {
+				file << "label,width,height,frames,total_ms,fps,avg_ms,p50_ms,p95_ms,p99_ms,min_ms,max_ms\n";
+			}
+			file << label << "," << run.target.width << "," << run.target.height << "," << cnt << ",";
+			file << totalMS << "," << fps << "," << avgMS << "," << p50 << "," << p95 << ",";
+			file << p99 << "," << minMS << "," << maxMS << "\n";
+			cout << "Wrote benchmark stats: " << run.settings.statsFile << endl;
+		}
+		else {
+			cerr << "ERROR: Could not write benchmark stats: " << run.settings.statsFile << endl;
+		}
+	}
+
+	if(!run.settings.screenshotFile.empty()) {
+		saveBenchmarkScreenshot(run);
+	}
+}
+
+// Cleanup run
+void cleanupBenchmarkRun(BenchmarkRun &run) {
+	cleanupOffscreenTarget(run.target);
+	run.frameMS.clear();
+}
@@ -0,0 +1,134 @@
+#include "FramePacer.hpp"
+
+static double elapsedMS(FramePacer::Clock::time_point from, FramePacer::Clock::time_point to) {
+	return chrono::duration<double, milli>(to - from).count();
+}
+
+// Start pacing; FRAME_PACING ("uncapped", "vsync" or a target FPS) and
+// FRAME_STATS (report interval in ms) environment variables override the defaults
+void createFramePacer(FramePacer &pacer, GLFWwindow *window, FramePacingMode mode, double targetFPS) {
+	const char *modeEnv = getenv("FRAME_PACING");
+	if(modeEnv) {
+		string modeStr = modeEnv;
+		if(modeStr == "uncapped") mode = FRAME_PACING_UNCAPPED;
+		else if(modeStr == "vsync") mode = FRAME_PACING_VSYNC;
+		else if(atof(modeEnv) > 0.0) {
+			mode = FRAME_PACING_TARGET_FPS;
+			targetFPS = atof(modeEnv);
+		}
+		else cerr << "WARNING: Unknown FRAME_PACING value: " << modeStr << endl;
+	}
+
+	const char *statsEnv = getenv("FRAME_STATS");
+	if(statsEnv) {
+		pacer.reportIntervalMS = atof(statsEnv);
+		if(pacer.reportIntervalMS <= 0.0) pacer.reportIntervalMS = 1000.0;
+	}
+
+	// Swap interval applies to the current context
+	glfwMakeContextCurrent(window);
+	setFramePacingMode(pacer, mode, targetFPS);
+
+	pacer.frameStart = FramePacer::Clock::now();
+	pacer.deadline = pacer.frameStart;
+	pacer.frameCnt = 0;
+}
+
+// Switch modes (the window's context must be current)
+void setFramePacingMode(FramePacer &pacer, FramePacingMode mode, double targetFPS) {
+	pacer.mode = mode;
+	pacer.targetFPS = (targetFPS > 0.0) ? targetFPS : 60.0;
+	pacer.deadline = FramePacer::Clock::now();
+	glfwSwapInterval((mode == FRAME_PACING_VSYNC) ? 1 : 0);
+
+	cout << "Frame pacing: " << getFramePacingModeName(mode);
+	if(mode == FRAME_PACING_TARGET_FPS) cout << " (" << pacer.targetFPS << " FPS)";
+	cout << endl;
+}
+
+// Print averages every reportIntervalMS
+static void reportFrameStats(FramePacer &pacer) {
+	pacer.reportElapsedMS += pacer.last.frameMS;
+	pacer.reportCpuMS += pacer.last.cpuMS;
+	pacer.reportSwapMS += pacer.last.swapMS;
+	pacer.reportMaxFrameMS = max(pacer.reportMaxFrameMS, pacer.last.frameMS);
+	pacer.reportFrameCnt++;
+
+	if(pacer.reportElapsedMS >= pacer.reportIntervalMS) {
+		double avgFrameMS = pacer.reportElapsedMS / pacer.reportFrameCnt;
+		cout << "FRAME: " << (1000.0 / avgFrameMS) << " FPS, ";
+		cout << avgFrameMS << " ms avg, ";
+		cout << (pacer.reportCpuMS / pacer.reportFrameCnt) << " ms CPU, ";
+		cout << (pacer.reportSwapMS / pacer.reportFrameCnt) << " ms swap, ";
+		cout << pacer.reportMaxFrameMS << " ms max" << endl;
+
+		pacer.reportElapsedMS = 0.0;
+		pacer.reportCpuMS = 0.0;
+		pacer.reportSwapMS = 0.0;
+		pacer.reportMaxFrameMS = 0.0;
+		pacer.reportFrameCnt = 0;
+	}
+}
+
+// Use instead of glfwSwapBuffers(): the CPU timer stops before the swap,
+// since the swap blocks under vsync and would otherwise count as CPU work
+void swapFrameBuffers(FramePacer &pacer, GLFWwindow *window) {
+	pacer.cpuEnd = FramePacer::Clock::now();
+	pacer.cpuEndSet = true;
+	glfwSwapBuffers(window);
+	pacer.last.swapMS = elapsedMS(pacer.cpuEnd, FramePacer::Clock::now());
+}
+
+// Call once per frame after swapping buffers: waits (if needed) and records timings
+void waitForNextFrame(FramePacer &pacer) {
+	FramePacer::Clock::time_point now = FramePacer::Clock::now();
+	if(pacer.cpuEndSet) {
+		pacer.last.cpuMS = elapsedMS(pacer.frameStart, pacer.cpuEnd);
+	}
+	else {
+		// No swap this frame (e.g. offscreen benchmark) or swapped directly
+		pacer.last.cpuMS = elapsedMS(pacer.frameStart, now);
+		pacer.last.swapMS = 0.0;
+	}
+	pacer.cpuEndSet = false;
+	pacer.last.waitMS = 0.0;
+
+	if(pacer.mode == FRAME_PACING_TARGET_FPS) {
+		chrono::duration<double> period(1.0 / pacer.targetFPS);
+		pacer.deadline += chrono::duration_cast<FramePacer::Clock::duration>(period);
+
+		// Fell more than a frame behind: don't try to catch up with a burst of frames
+		if(pacer.deadline + chrono::duration_cast<FramePacer::Clock::duration>(period) < now) {
+			pacer.deadline = now;
+		}
+
+		// Coarse sleep first, then spin for the last bit
+		chrono::duration<double, milli> spin(pacer.spinMS);
+		FramePacer::Clock::time_point sleepUntil = pacer.deadline - chrono::duration_cast<FramePacer::Clock::duration>(spin);
+		if(now < sleepUntil) {
+			this_thread::sleep_until(sleepUntil);
+		}
+		while(FramePacer::Clock::now() < pacer.deadline) {
+			this_thread::yield();
+		}
+
+		FramePacer::Clock::time_point waited = FramePacer::Clock::now();
+		pacer.last.waitMS = elapsedMS(now, waited);
+		now = waited;
+	}
+
+	pacer.last.frameMS = elapsedMS(pacer.frameStart, now);
+	pacer.frameStart = now;
+	pacer.frameCnt++;
+
+	if(pacer.reportIntervalMS > 0.0) reportFrameStats(pacer);
+}
+
+string getFramePacingModeName(FramePacingMode mode) {
+	switch(mode) {
+		case FRAME_PACING_UNCAPPED:		return "uncapped";
+		case FRAME_PACING_VSYNC:		return "vsync";
+		case FRAME_PACING_TARGET_FPS:	return "target FPS";
+	}
+	return "unknown";
+}
@@ -47,6 +47,65 @@ GLFWwindow* setupGLFW(string windowTitle, int major, int minor, int windowWidth,
 	return window;
 }
 
+// GLFW setup with no visible window (for unattended benchmarks).
+// Without a display (and GLFW 3.4+), the null platform is used and the context
+// comes from EGL or OSMesa instead of the window system.
+GLFWwindow* setupGLFWHeadless(string windowTitle, int major, int minor, int windowWidth, int windowHeight, bool debugging) {
+
+	// Set GLFW error callback
+	glfwSetErrorCallback(error_callback);
+
+	// No display server? Ask for the null platform (must happen before glfwInit)
+	bool noDisplay = false;
+#if !defined(_WIN32) && !defined(__APPLE__)
+	noDisplay = !getenv("DISPLAY") && !getenv("WAYLAND_DISPLAY");
+#endif
+#ifdef GLFW_PLATFORM_NULL
+	if(noDisplay) {
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+	}
+#endif
+
+	// (Try to) initialize GLFW
+	if (!glfwInit()) {
+		cerr << "ERROR: GLFW could not start (headless)" << endl;
+		exit(EXIT_FAILURE);
+	}
+
+	// Force specific OpenGL version
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, debugging);
+
+	// Never shown; we render into our own framebuffer anyway
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+	// Try the native context API first (unless there's no display), then EGL, then OSMesa
+	int contextAPIs[3] = { GLFW_NATIVE_CONTEXT_API, GLFW_EGL_CONTEXT_API, GLFW_OSMESA_CONTEXT_API };
+	GLFWwindow* window = NULL;
+	for(int i = (noDisplay ? 1 : 0); i < 3 && !window; i++) {
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, contextAPIs[i]);
+		window = glfwCreateWindow(	windowWidth, windowHeight, 
+									windowTitle.c_str(), 
+									NULL, NULL);
+	}
+
+	if (!window) {
+		cerr << "ERROR: Could not create headless OpenGL context" << endl;
+		glfwTerminate();
+		exit(EXIT_FAILURE);
+	}
+
+	glfwMakeContextCurrent(window);
+
+	// Benchmarks should never wait on a display
+	glfwSwapInterval(0);
+
+	return window;
+}
+
 // Cleanup GLFW
 void cleanupGLFW(GLFWwindow* window) 
 {
@@ -55,7 +114,8 @@ void cleanupGLFW(GLFWwindow* window)
 }
 
 // GLEW setup
-void setupGLEW(GLFWwindow* window) {
+// (headless = context from setupGLFWHeadless(), possibly with no X display at all)
+void setupGLEW(GLFWwindow* window, bool headless) {
 	
 	// MAC-SPECIFIC: Some issues occur with using OpenGL core and GLEW; so, we'll use the experimental version of GLEW
 	glewExperimental = true;
@@ -63,6 +123,15 @@ void setupGLEW(GLFWwindow* window) {
 	// (Try to) initalize GLEW
 	GLenum err = glewInit();
 
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+	// A GLX build of GLEW (2.2+) fails when there's no X display, even though the
+	// EGL/OSMesa context itself is fine; only the GLX extension entry points are missing.
+	// The core/extension function pointers are all we need, so load those on their own.
+	if(headless && err == GLEW_ERROR_NO_GLX_DISPLAY) {
+		err = glewContextInit();
+	}
+#endif
+
 	if (GLEW_OK != err) {
 		// We couldn't start GLEW, so we've got to go.
 		// Kill GLFW and get out of here
@@ -0,0 +1,178 @@
+#include "GPUProfiler.hpp"
+
+// Set up profiler; GPU_PROFILE_CSV environment variable (if set) names a CSV file to log every sample to
+void createGPUProfiler(GPUProfiler &prof, int historySize, int reportEveryFrames) {
+	prof.passes.clear();
+	prof.slot = 0;
+	prof.activePass = -1;
+	prof.historySize = max(1, historySize);
+	prof.reportEveryFrames = reportEveryFrames;
+	prof.frameCnt = 0;
+
+	const char *csvEnv = getenv("GPU_PROFILE_CSV");
+	if(csvEnv && csvEnv[0] != '\0') {
+		openGPUProfilerCSV(prof, csvEnv);
+	}
+}
+
+// Find pass by name (or add it)
+static int getGPUTimerPassIndex(GPUProfiler &prof, string &passName) {
+	for(int i = 0; i < prof.passes.size(); i++) {
+		if(prof.passes[i].name == passName) return i;
+	}
+
+	GPUTimerPass pass;
+	pass.name = passName;
+	glGenQueries(GPU_PROFILER_FRAME_LATENCY, pass.queries);
+	pass.history.reserve(prof.historySize);
+	prof.passes.push_back(pass);
+	return (int)prof.passes.size() - 1;
+}
+
+// Start timing a pass (one pass at a time)
+void beginGPUTimer(GPUProfiler &prof, string passName) {
+	if(prof.activePass >= 0) {
+		cerr << "WARNING: GPU timer " << passName << " started inside ";
+		cerr << prof.passes[prof.activePass].name << "; closing that one first" << endl;
+		endGPUTimer(prof);
+	}
+
+	int index = getGPUTimerPassIndex(prof, passName);
+	GPUTimerPass &pass = prof.passes[index];
+
+	// Unread result from GPU_PROFILER_FRAME_LATENCY frames ago? Drop it rather than wait.
+	if(pass.pending[prof.slot]) {
+		pass.pending[prof.slot] = false;
+		pass.droppedCnt++;
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED, pass.queries[prof.slot]);
+	prof.activePass = index;
+}
+
+// Stop timing current pass
+void endGPUTimer(GPUProfiler &prof) {
+	if(prof.activePass < 0) return;
+	glEndQuery(GL_TIME_ELAPSED);
+	prof.passes[prof.activePass].pending[prof.slot] = true;
+	prof.passes[prof.activePass].issuedFrame[prof.slot] = prof.frameCnt;
+	prof.activePass = -1;
+}
+
+// Store one result in the pass's history
+static void addGPUTimerSample(GPUProfiler &prof, GPUTimerPass &pass, unsigned long long frame, double ms) {
+	if(pass.history.size() < prof.historySize) {
+		pass.history.push_back(ms);
+	}
+	else {
+		pass.history[pass.historyNext] = ms;
+	}
+	pass.historyNext = (pass.historyNext + 1) % prof.historySize;
+	pass.lastMS = ms;
+	pass.sampleCnt++;
+
+	if(prof.csv.is_open()) {
+		prof.csv << frame << "," << pass.name << "," << ms << "\n";
+	}
+}
+
+// Call once per frame (after the last timer): collects any finished results and moves to the next slot
+void endGPUProfilerFrame(GPUProfiler &prof) {
+	if(prof.activePass >= 0) endGPUTimer(prof);
+
+	// Oldest slot is the one about to be reused, so check it first
+	prof.slot = (prof.slot + 1) % GPU_PROFILER_FRAME_LATENCY;
+
+	for(GPUTimerPass &pass : prof.passes) {
+		for(int k = 0; k < GPU_PROFILER_FRAME_LATENCY; k++) {
+			int s = (prof.slot + k) % GPU_PROFILER_FRAME_LATENCY;
+			if(!pass.pending[s]) continue;
+
+			GLint available = 0;
+			glGetQueryObjectiv(pass.queries[s], GL_QUERY_RESULT_AVAILABLE, &available);
+			if(!available) break;	// Later slots can't be ready either
+
+			GLuint64 elapsedNS = 0;
+			glGetQueryObjectui64v(pass.queries[s], GL_QUERY_RESULT, &elapsedNS);
+			pass.pending[s] = false;
+			addGPUTimerSample(prof, pass, pass.issuedFrame[s], elapsedNS / 1.0e6);
+		}
+	}
+
+	prof.frameCnt++;
+
+	if(prof.reportEveryFrames > 0 && (prof.frameCnt % prof.reportEveryFrames) == 0) {
+		printGPUProfilerStats(prof);
+	}
+}
+
+// Value at percentile p (0-100) of sorted samples
+static double getPercentile(vector<double> &sorted, double p) {
+	if(sorted.empty()) return 0.0;
+	size_t index = (size_t)((p / 100.0)*(sorted.size() - 1) + 0.5);
+	return sorted[min(index, sorted.size() - 1)];
+}
+
+// Rolling average and percentiles over the history window
+bool getGPUTimerStats(GPUProfiler &prof, string passName, GPUTimerStats &stats) {
+	stats = GPUTimerStats();
+	for(GPUTimerPass &pass : prof.passes) {
+		if(pass.name != passName) continue;
+		if(pass.history.empty()) return false;
+
+		vector<double> sorted = pass.history;
+		sort(sorted.begin(), sorted.end());
+
+		double total = 0.0;
+		for(double ms : sorted) total += ms;
+
+		stats.sampleCnt = (int)sorted.size();
+		stats.avgMS = total / sorted.size();
+		stats.minMS = sorted.front();
+		stats.maxMS = sorted.back();
+		stats.p50MS = getPercentile(sorted, 50.0);
+		stats.p95MS = getPercentile(sorted, 95.0);
+		stats.p99MS = getPercentile(sorted, 99.0);
+		return true;
+	}
+	return false;
+}
+
+// Print one line per pass
+void printGPUProfilerStats(GPUProfiler &prof) {
+	cout << "GPU TIMINGS (ms, last " << prof.historySize << " frames):" << endl;
+	for(GPUTimerPass &pass : prof.passes) {
+		GPUTimerStats stats;
+		if(!getGPUTimerStats(prof, pass.name, stats)) continue;
+		cout << "\t" << pass.name << ": ";
+		cout << "avg " << stats.avgMS;
+		cout << ", p50 " << stats.p50MS;
+		cout << ", p95 " << stats.p95MS;
+		cout << ", p99 " << stats.p99MS;
+		cout << ", max " << stats.maxMS;
+		if(pass.droppedCnt > 0) cout << " (" << pass.droppedCnt << " dropped)";
+		cout << endl;
+	}
+}
+
+// Log every sample as frame,pass,ms
+bool openGPUProfilerCSV(GPUProfiler &prof, string filename) {
+	if(prof.csv.is_open()) prof.csv.close();
+	prof.csv.open(filename, ios::trunc);
+	if(!prof.csv) {
+		cerr << "ERROR: Could not open GPU profile CSV: " << filename << endl;
+		return false;
+	}
+	prof.csv << "frame,pass,ms\n";
+	return true;
+}
+
+// Cleanup profiler
+void cleanupGPUProfiler(GPUProfiler &prof) {
+	if(prof.activePass >= 0) endGPUTimer(prof);
+	for(GPUTimerPass &pass : prof.passes) {
+		glDeleteQueries(GPU_PROFILER_FRAME_LATENCY, pass.queries);
+	}
+	prof.passes.clear();
+	if(prof.csv.is_open()) prof.csv.close();
+}
@@ -0,0 +1,92 @@
+#include "HiZGL.hpp"
+
+// Create pyramid texture for a given depth buffer size (program is owned by the caller)
+void createHiZBuffer(HiZBuffer &hz, GLuint buildProgID, int width, int height) {
+	hz.progID = buildProgID;
+	hz.width = max(1, width);
+	hz.height = max(1, height);
+	hz.valid = false;
+
+	hz.mipCnt = 1;
+	while((hz.width >> hz.mipCnt) > 0 || (hz.height >> hz.mipCnt) > 0) hz.mipCnt++;
+
+	hz.srcTexLoc = glGetUniformLocation(buildProgID, "srcTex");
+	hz.srcLevelLoc = glGetUniformLocation(buildProgID, "srcLevel");
+	hz.srcSizeLoc = glGetUniformLocation(buildProgID, "srcSize");
+	hz.dstSizeLoc = glGetUniformLocation(buildProgID, "dstSize");
+	hz.copyDepthLoc = glGetUniformLocation(buildProgID, "copyDepth");
+
+	// Immutable storage, so every level can be bound as an image
+	glGenTextures(1, &(hz.texID));
+	glBindTexture(GL_TEXTURE_2D, hz.texID);
+	glTexStorage2D(GL_TEXTURE_2D, hz.mipCnt, GL_R32F, hz.width, hz.height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// Recreate for a new depth buffer size (no-op if unchanged)
+void resizeHiZBuffer(HiZBuffer &hz, int width, int height) {
+	if(hz.texID && hz.width == max(1, width) && hz.height == max(1, height)) return;
+	GLuint progID = hz.progID;
+	cleanupHiZBuffer(hz);
+	createHiZBuffer(hz, progID, width, height);
+}
+
+// Copy depth into level 0, then reduce level by level (depth texture must not be written meanwhile)
+void buildHiZBuffer(HiZBuffer &hz, GLuint depthTexID, const glm::mat4 &viewProjMat) {
+	GLint prevProgID = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &prevProgID);
+	glUseProgram(hz.progID);
+	glActiveTexture(GL_TEXTURE0);
+	glUniform1i(hz.srcTexLoc, 0);
+
+	int srcWidth = hz.width;
+	int srcHeight = hz.height;
+	for(int level = 0; level < hz.mipCnt; level++) {
+		int dstWidth = max(1, hz.width >> level);
+		int dstHeight = max(1, hz.height >> level);
+
+		if(level == 0) {
+			glBindTexture(GL_TEXTURE_2D, depthTexID);
+			glUniform1i(hz.copyDepthLoc, 1);
+			glUniform1i(hz.srcLevelLoc, 0);
+		}
+		else {
+			glBindTexture(GL_TEXTURE_2D, hz.texID);
+			glUniform1i(hz.copyDepthLoc, 0);
+			glUniform1i(hz.srcLevelLoc, level - 1);
+		}
+		glUniform2i(hz.srcSizeLoc, srcWidth, srcHeight);
+		glUniform2i(hz.dstSizeLoc, dstWidth, dstHeight);
+		glBindImageTexture(0, hz.texID, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+		glDispatchCompute((dstWidth + HIZ_GROUP_SIZE - 1)/HIZ_GROUP_SIZE,
+							(dstHeight + HIZ_GROUP_SIZE - 1)/HIZ_GROUP_SIZE, 1);
+
+		// Next level reads what this one wrote
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+		srcWidth = dstWidth;
+		srcHeight = dstHeight;
+	}
+
+	glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glUseProgram((GLuint)prevProgID);
+
+	hz.viewProjMat = viewProjMat;
+	hz.valid = true;
+}
+
+// Cleanup pyramid
+void cleanupHiZBuffer(HiZBuffer &hz) {
+	glDeleteTextures(1, &(hz.texID));
+	hz.texID = 0;
+	hz.width = 0;
+	hz.height = 0;
+	hz.mipCnt = 0;
+	hz.valid = false;
+}
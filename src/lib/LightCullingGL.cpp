@@ -0,0 +1,88 @@
+#include "LightCullingGL.hpp"
+
+// Create buffers for a given screen size (program is owned by the caller)
+void createTiledLightCuller(TiledLightCuller &tc, GLuint cullProgID, int width, int height) {
+	tc.progID = cullProgID;
+	tc.width = width;
+	tc.height = height;
+	tc.tilesX = (width + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE;
+	tc.tilesY = (height + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE;
+
+	tc.projMatLoc = glGetUniformLocation(cullProgID, "projMat");
+	tc.invProjMatLoc = glGetUniformLocation(cullProgID, "invProjMat");
+	tc.lightCntLoc = glGetUniformLocation(cullProgID, "lightCnt");
+	tc.screenSizeLoc = glGetUniformLocation(cullProgID, "screenSize");
+	tc.depthSourceLoc = glGetUniformLocation(cullProgID, "gPosition");
+	if(tc.depthSourceLoc < 0) {
+		tc.depthSourceLoc = glGetUniformLocation(cullProgID, "gDepth");
+	}
+
+	glGenBuffers(1, &(tc.lightSSBO));
+	glGenBuffers(1, &(tc.tileSSBO));
+
+	// Tile lists only depend on screen size
+	size_t tileBufferSize = sizeof(GLuint)*(MAX_LIGHTS_PER_TILE + 1)*tc.tilesX*tc.tilesY;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, tc.tileSSBO);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, tileBufferSize, NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+// Upload view-space lights (once per frame)
+void uploadLights(TiledLightCuller &tc, vector<GPUPointLight> &viewLights) {
+	int cnt = (int)viewLights.size();
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, tc.lightSSBO);
+	if(cnt > tc.lightCapacity) {
+		tc.lightCapacity = max(cnt, 2*tc.lightCapacity);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GPUPointLight)*tc.lightCapacity, NULL, GL_DYNAMIC_DRAW);
+	}
+	if(cnt > 0) {
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GPUPointLight)*cnt, viewLights.data());
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	tc.lightCnt = cnt;
+}
+
+// Build per-tile light lists from the G-buffer positions (or depth)
+void cullLights(TiledLightCuller &tc, GLuint depthSourceTexID, glm::mat4 &projMat) {
+	glUseProgram(tc.progID);
+
+	glm::mat4 invProjMat = glm::inverse(projMat);
+	glUniformMatrix4fv(tc.projMatLoc, 1, false, &projMat[0][0]);
+	glUniformMatrix4fv(tc.invProjMatLoc, 1, false, &invProjMat[0][0]);
+	glUniform1i(tc.lightCntLoc, tc.lightCnt);
+	glUniform2i(tc.screenSizeLoc, tc.width, tc.height);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, depthSourceTexID);
+	glUniform1i(tc.depthSourceLoc, 0);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_BUFFER_BINDING, tc.lightSSBO);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TILE_BUFFER_BINDING, tc.tileSSBO);
+
+	// One work group per tile
+	glDispatchCompute(tc.tilesX, tc.tilesY, 1);
+
+	// Make tile lists visible to the lighting pass
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glUseProgram(0);
+}
+
+// Bind light and tile buffers for the lighting pass
+void bindTileLights(TiledLightCuller &tc) {
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_BUFFER_BINDING, tc.lightSSBO);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TILE_BUFFER_BINDING, tc.tileSSBO);
+}
+
+// Cleanup buffers
+void cleanupTiledLightCuller(TiledLightCuller &tc) {
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glDeleteBuffers(1, &(tc.lightSSBO));
+	glDeleteBuffers(1, &(tc.tileSSBO));
+	tc.lightSSBO = 0;
+	tc.tileSSBO = 0;
+	tc.lightCapacity = 0;
+	tc.lightCnt = 0;
+	tc.progID = 0;
+}
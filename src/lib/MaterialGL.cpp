@@ -0,0 +1,176 @@
+#include <cstring>
+#include "MaterialGL.hpp"
+
+void createMaterialLibraryGL(MaterialLibraryGL &lib, int layerSize) {
+	lib.layerSize = max(4, layerSize);
+	lib.albedoFiles.clear();
+	lib.normalFiles.clear();
+	lib.materials.clear();
+}
+
+// Returns the texture's layer; the same file is only stored once
+int addMaterialTexture(MaterialLibraryGL &lib, string filename, bool isNormalMap) {
+	vector<string> &files = isNormalMap ? lib.normalFiles : lib.albedoFiles;
+	for(int i = 0; i < (int)files.size(); i++) {
+		if(files.at(i) == filename) return i;
+	}
+	files.push_back(filename);
+	return (int)files.size() - 1;
+}
+
+int addMaterial(MaterialLibraryGL &lib, const GPUMaterial &material) {
+	lib.materials.push_back(material);
+	return (int)lib.materials.size() - 1;
+}
+
+int getMaterialCount(MaterialLibraryGL &lib) {
+	return (int)lib.materials.size();
+}
+
+// Bilinear resample to size x size (layers of an array all share one size)
+static void resampleRGBA(const vector<unsigned char> &src, int width, int height,
+							int size, vector<unsigned char> &dst) {
+	dst.resize((size_t)size*size*4);
+	for(int y = 0; y < size; y++) {
+		float sy = max(0.0f, ((float)y + 0.5f)*height/size - 0.5f);
+		int y0 = min((int)sy, height - 1);
+		int y1 = min(y0 + 1, height - 1);
+		float fy = sy - (float)y0;
+		for(int x = 0; x < size; x++) {
+			float sx = max(0.0f, ((float)x + 0.5f)*width/size - 0.5f);
+			int x0 = min((int)sx, width - 1);
+			int x1 = min(x0 + 1, width - 1);
+			float fx = sx - (float)x0;
+			for(int c = 0; c < 4; c++) {
+				float top = src[((size_t)y0*width + x0)*4 + c]*(1.0f - fx) + src[((size_t)y0*width + x1)*4 + c]*fx;
+				float bottom = src[((size_t)y1*width + x0)*4 + c]*(1.0f - fx) + src[((size_t)y1*width + x1)*4 + c]*fx;
+				dst[((size_t)y*size + x)*4 + c] = (unsigned char)(top*(1.0f - fy) + bottom*fy + 0.5f);
+			}
+		}
+	}
+}
+
+// Decode, resize, build mips and compress every file of one array (in parallel)
+static void buildLayers(MaterialLibraryGL &lib, vector<string> &files, TextureCompression compression,
+						const unsigned char fallback[4], ThreadPool &pool,
+						vector<vector<TextureMipData>> &layers) {
+	layers.assign(files.size(), vector<TextureMipData>());
+	parallelFor(pool, (int)files.size(), [&](int i) {
+		vector<unsigned char> rgba;
+		vector<unsigned char> resized;
+		int width, height;
+		if(loadTextureRGBA(files.at(i), rgba, width, height)) {
+			if(width == lib.layerSize && height == lib.layerSize) {
+				resized.swap(rgba);
+			}
+			else {
+				resampleRGBA(rgba, width, height, lib.layerSize, resized);
+			}
+		}
+		else {
+			// Still takes up its layer, so the indices given out stay valid
+			cerr << "ERROR: Material texture could not load: " << files.at(i) << endl;
+			resized.resize((size_t)lib.layerSize*lib.layerSize*4);
+			for(size_t p = 0; p < resized.size(); p += 4) {
+				memcpy(&(resized[p]), fallback, 4);
+			}
+		}
+
+		generateMipChain(resized.data(), lib.layerSize, lib.layerSize, layers.at(i));
+		if(compression != TEXTURE_COMPRESSION_NONE) {
+			for(auto &mip : layers.at(i)) {
+				TextureMipData blocks;
+				compressTextureMip(mip, compression, blocks);
+				mip = std::move(blocks);
+			}
+		}
+	});
+}
+
+static GLuint createTextureArray(MaterialLibraryGL &lib, vector<vector<TextureMipData>> &layers,
+									GLenum internalFormat, bool compressed) {
+	int levelCnt = 1;
+	for(int s = lib.layerSize; s > 1; s /= 2) levelCnt++;
+	int layerCnt = max(1, (int)layers.size());	// An empty array still needs storage to be sampled
+
+	GLuint texID = 0;
+	glGenTextures(1, &texID);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texID);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, levelCnt, internalFormat, lib.layerSize, lib.layerSize, layerCnt);
+
+	GLint oldAlignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &oldAlignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	for(int layer = 0; layer < (int)layers.size(); layer++) {
+		for(int level = 0; level < (int)layers.at(layer).size(); level++) {
+			TextureMipData &mip = layers.at(layer).at(level);
+			if(compressed) {
+				glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, mip.width, mip.height, 1,
+											internalFormat, (GLsizei)mip.data.size(), mip.data.data());
+			}
+			else {
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, mip.width, mip.height, 1,
+									GL_RGBA, GL_UNSIGNED_BYTE, mip.data.data());
+			}
+		}
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, oldAlignment);
+
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	return texID;
+}
+
+// Load every texture and create the arrays + material SSBO (call once, after adding everything)
+void uploadMaterialLibraryGL(MaterialLibraryGL &lib, ThreadPool &pool) {
+	bool s3tcSupported = (GLEW_EXT_texture_compression_s3tc != 0);
+	TextureCompression albedoCompression = s3tcSupported ? TEXTURE_COMPRESSION_BC1 : TEXTURE_COMPRESSION_NONE;
+	GLenum albedoFormat = s3tcSupported ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_RGBA8;
+
+	const unsigned char white[4] = {255, 255, 255, 255};
+	const unsigned char flatNormal[4] = {128, 128, 255, 255};
+
+	vector<vector<TextureMipData>> layers;
+	buildLayers(lib, lib.albedoFiles, albedoCompression, white, pool, layers);
+	lib.albedoArrayID = createTextureArray(lib, layers, albedoFormat, s3tcSupported);
+
+	buildLayers(lib, lib.normalFiles, TEXTURE_COMPRESSION_BC5, flatNormal, pool, layers);
+	lib.normalArrayID = createTextureArray(lib, layers, GL_COMPRESSED_RG_RGTC2, true);
+
+	// Out-of-range material indices are never produced, but keep at least one entry
+	if(lib.materials.empty()) lib.materials.push_back(GPUMaterial());
+	glGenBuffers(1, &(lib.materialSSBO));
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, lib.materialSSBO);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GPUMaterial)*lib.materials.size(),
+					lib.materials.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	cout << "Material library: " << lib.materials.size() << " materials, ";
+	cout << lib.albedoFiles.size() << " albedo + " << lib.normalFiles.size() << " normal layers (";
+	cout << lib.layerSize << "x" << lib.layerSize << ")" << endl;
+}
+
+// Same bindings for every draw, so this is done once per frame (not per material)
+void bindMaterialLibraryGL(MaterialLibraryGL &lib) {
+	glActiveTexture(GL_TEXTURE0 + MATERIAL_ALBEDO_UNIT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, lib.albedoArrayID);
+	glActiveTexture(GL_TEXTURE0 + MATERIAL_NORMAL_UNIT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, lib.normalArrayID);
+	glActiveTexture(GL_TEXTURE0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_SSBO_BINDING, lib.materialSSBO);
+}
+
+void cleanupMaterialLibraryGL(MaterialLibraryGL &lib) {
+	glDeleteTextures(1, &(lib.albedoArrayID));
+	glDeleteTextures(1, &(lib.normalArrayID));
+	glDeleteBuffers(1, &(lib.materialSSBO));
+	lib.albedoArrayID = 0;
+	lib.normalArrayID = 0;
+	lib.materialSSBO = 0;
+	lib.materials.clear();
+	lib.albedoFiles.clear();
+	lib.normalFiles.clear();
+}
@@ -0,0 +1,468 @@
+#include "MeshBatchGLData.hpp"
+
+// Make sure per-draw buffers can hold at least drawCnt draws
+static void reserveBatchDraws(MeshBatchGL &batch, int drawCnt) {
+	if(drawCnt <= batch.drawCapacity) return;
+
+	// Grow geometrically so we don't reallocate every frame
+	int newCapacity = max(64, batch.drawCapacity);
+	while(newCapacity < drawCnt) newCapacity *= 2;
+
+	// Draw IDs never change, so they only get written when the buffer grows
+	vector<GLuint> drawIDs(newCapacity);
+	for(int i = 0; i < newCapacity; i++) drawIDs[i] = (GLuint)i;
+	glBindBuffer(GL_ARRAY_BUFFER, batch.drawIDBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(GLuint)*newCapacity, drawIDs.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batch.indirectBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand)*newCapacity, NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch.drawDataSSBO);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(BatchDrawData)*newCapacity, NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	// Culling inputs grow along with everything else
+	if(batch.cullProgID) {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch.cullInputBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(DrawElementsIndirectCommand)*newCapacity, NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch.cullBoundsSSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(glm::vec4)*newCapacity, NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch.lateIndirectBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(DrawElementsIndirectCommand)*newCapacity, NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch.retestSSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint)*newCapacity, NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+
+	batch.drawCapacity = newCapacity;
+}
+
+// Bounding sphere of a mesh in the space its vertices are uploaded in (i.e., before dequantMat)
+static glm::vec4 computeBoundingSphere(const Vertex *vertices, size_t vertCnt, const glm::mat4 &dequantMat) {
+	if(vertCnt == 0) return glm::vec4(0,0,0,0);
+
+	glm::mat4 quantMat = glm::inverse(dequantMat);
+	vector<glm::vec3> positions(vertCnt);
+	glm::vec3 minP = glm::vec3(quantMat*glm::vec4(vertices[0].position, 1.0f));
+	glm::vec3 maxP = minP;
+	for(size_t i = 0; i < vertCnt; i++) {
+		positions[i] = glm::vec3(quantMat*glm::vec4(vertices[i].position, 1.0f));
+		minP = glm::min(minP, positions[i]);
+		maxP = glm::max(maxP, positions[i]);
+	}
+
+	// Box center is good enough; radius is exact for that center
+	glm::vec3 center = 0.5f*(minP + maxP);
+	float radius2 = 0.0f;
+	for(glm::vec3 &p : positions) {
+		glm::vec3 d = p - center;
+		radius2 = max(radius2, glm::dot(d, d));
+	}
+	return glm::vec4(center, sqrt(radius2));
+}
+
+// Pack all meshes into one vertex buffer and one index buffer (LOD index lists go right after each mesh's own).
+// Sources are only read, so they can point straight into a mapped mesh cache.
+void createMeshBatchGL(const vector<BatchMeshSource> &sources, MeshBatchGL &batch, VertexFormat format) {
+	// Figure out where each mesh goes
+	size_t vertCnt = 0;
+	size_t indexCnt = 0;
+	batch.meshes.clear();
+	batch.format = format;
+	for(const BatchMeshSource &m : sources) {
+		BatchMeshRange range;
+		range.firstIndex = (GLuint)indexCnt;
+		range.indexCnt = (GLuint)m.indexCnt;
+		range.baseVertex = (GLint)vertCnt;
+		for(size_t i = 0; i < m.lodCnt; i++) {
+			MeshLOD lod = m.lods[i];
+			lod.firstIndex += (unsigned int)(indexCnt + m.indexCnt);
+			range.lods.push_back(lod);
+		}
+		batch.meshes.push_back(range);
+		vertCnt += m.vertCnt;
+		indexCnt += m.indexCnt + m.lodIndexCnt;
+	}
+
+	// Create shared Vertex Buffer Object (VBO) and fill it mesh by mesh
+	size_t stride = getVertexStride(format);
+	vector<unsigned char> vertData;
+	glGenBuffers(1, &(batch.VBO));
+	glBindBuffer(GL_ARRAY_BUFFER, batch.VBO);
+	glBufferData(GL_ARRAY_BUFFER, stride*vertCnt, NULL, GL_STATIC_DRAW);
+	for(size_t i = 0; i < sources.size(); i++) {
+		packVertices(sources[i].vertices, sources[i].vertCnt, format, vertData, batch.meshes[i].dequantMat);
+		batch.meshes[i].boundingSphere = computeBoundingSphere(sources[i].vertices, sources[i].vertCnt,
+																batch.meshes[i].dequantMat);
+		glBufferSubData(GL_ARRAY_BUFFER,
+						stride*batch.meshes[i].baseVertex,
+						vertData.size(),
+						vertData.data());
+	}
+
+	// Create Vertex Array Object (VAO)
+	glGenVertexArrays(1, &(batch.VAO));
+	glBindVertexArray(batch.VAO);
+
+	// Same attribute layout as createMeshGL()
+	setupVertexAttributes(format);
+
+	// Draw ID is a per-instance attribute; each command sets baseInstance to its
+	// own index, so the shader can look up its matrices without gl_DrawID (GL 4.6)
+	glGenBuffers(1, &(batch.drawIDBuffer));
+	glGenBuffers(1, &(batch.indirectBuffer));
+	glGenBuffers(1, &(batch.drawDataSSBO));
+	reserveBatchDraws(batch, 64);
+
+	glBindBuffer(GL_ARRAY_BUFFER, batch.drawIDBuffer);
+	glEnableVertexAttribArray(BATCH_DRAW_ID_LOCATION);
+	glVertexAttribIPointer(BATCH_DRAW_ID_LOCATION, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+	glVertexAttribDivisor(BATCH_DRAW_ID_LOCATION, 1);
+
+	// Create shared Element Buffer Object (EBO); indices stay mesh-relative thanks to baseVertex
+	glGenBuffers(1, &(batch.EBO));
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch.EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint)*indexCnt, NULL, GL_STATIC_DRAW);
+	for(size_t i = 0; i < sources.size(); i++) {
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER,
+						sizeof(GLuint)*batch.meshes[i].firstIndex,
+						sizeof(GLuint)*sources[i].indexCnt,
+						sources[i].indices);
+		if(sources[i].lodIndexCnt > 0) {
+			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER,
+							sizeof(GLuint)*(batch.meshes[i].firstIndex + batch.meshes[i].indexCnt),
+							sizeof(GLuint)*sources[i].lodIndexCnt,
+							sources[i].lodIndices);
+		}
+	}
+
+	// Unbind vertex array for now
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void createMeshBatchGL(vector<Mesh> &allMeshes, MeshBatchGL &batch, VertexFormat format) {
+	vector<BatchMeshSource> sources(allMeshes.size());
+	for(size_t i = 0; i < allMeshes.size(); i++) {
+		Mesh &m = allMeshes[i];
+		sources[i].vertices = m.vertices.data();
+		sources[i].vertCnt = m.vertices.size();
+		sources[i].indices = m.indices.data();
+		sources[i].indexCnt = m.indices.size();
+		sources[i].lods = m.lods.data();
+		sources[i].lodCnt = m.lods.size();
+		sources[i].lodIndices = m.lodIndices.data();
+		sources[i].lodIndexCnt = m.lodIndices.size();
+	}
+	createMeshBatchGL(sources, batch, format);
+}
+
+// Start a new list of draws (buffers are kept)
+void clearBatchDraws(MeshBatchGL &batch) {
+	batch.commands.clear();
+	batch.drawData.clear();
+	batch.drawBounds.clear();
+}
+
+// Pick a LOD from the projected error at the mesh's distance (modelViewMat: object to view space)
+int selectBatchLOD(MeshBatchGL &batch, int meshIndex, const glm::mat4 &modelViewMat,
+					const glm::mat4 &projMat, float viewportHeight, float maxPixelError) {
+	BatchMeshRange &range = batch.meshes.at(meshIndex);
+	if(range.lods.empty()) return 0;
+
+	// Distance to the closest point of the bounding sphere (0 when the camera is inside)
+	glm::mat4 vertToViewMat = modelViewMat*range.dequantMat;
+	glm::vec3 center = glm::vec3(vertToViewMat*glm::vec4(glm::vec3(range.boundingSphere), 1.0f));
+	float radius = range.boundingSphere.w*getMatrixMaxScale(vertToViewMat);
+	float distance = max(glm::length(center) - radius, 0.0f);
+
+	// LOD errors are in object space (before quantization)
+	return selectMeshLOD(range.lods, getMatrixMaxScale(modelViewMat), distance,
+							projMat, viewportHeight, maxPixelError);
+}
+
+// Queue one draw of a mesh with its own transforms (lod: 0 = full mesh, see selectBatchLOD();
+// materialIndex is only read by shaders that use a MaterialLibraryGL)
+void addBatchDraw(MeshBatchGL &batch, int meshIndex, const glm::mat4 &modelMat, const glm::mat3 &normalMat,
+					int lod, int materialIndex) {
+	BatchMeshRange &range = batch.meshes.at(meshIndex);
+
+	DrawElementsIndirectCommand cmd;
+	cmd.count = range.indexCnt;
+	cmd.instanceCount = 1;
+	cmd.firstIndex = range.firstIndex;
+	if(lod > 0 && lod <= (int)range.lods.size()) {
+		cmd.count = range.lods[lod - 1].indexCnt;
+		cmd.firstIndex = range.lods[lod - 1].firstIndex;
+	}
+	cmd.baseVertex = range.baseVertex;
+	cmd.baseInstance = (GLuint)batch.commands.size();
+	batch.commands.push_back(cmd);
+
+	BatchDrawData data;
+	data.modelMat = modelMat*range.dequantMat;
+	data.normalMat = glm::mat4(normalMat);
+	data.material = glm::ivec4(materialIndex, 0, 0, 0);
+	batch.drawData.push_back(data);
+
+	// Transformed on the GPU (only used when culling)
+	batch.drawBounds.push_back(range.boundingSphere);
+}
+
+// Upload queued draws and submit them all with one call
+void drawMeshBatch(MeshBatchGL &batch, GLuint drawDataBinding) {
+	int drawCnt = (int)batch.commands.size();
+	if(drawCnt == 0) return;
+
+	reserveBatchDraws(batch, drawCnt);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch.drawDataSSBO);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(BatchDrawData)*drawCnt, batch.drawData.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, drawDataBinding, batch.drawDataSSBO);
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, batch.indirectBuffer);
+	glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(DrawElementsIndirectCommand)*drawCnt, batch.commands.data());
+
+	glBindVertexArray(batch.VAO);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, drawCnt, 0);
+	glBindVertexArray(0);
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+// Enable GPU culling for drawMeshBatchCulled()/drawMeshBatchOcclusionCulled() (program is owned by the caller)
+void setupBatchCulling(MeshBatchGL &batch, GLuint cullProgID) {
+	batch.cullProgID = cullProgID;
+	batch.frustumPlanesLoc = glGetUniformLocation(cullProgID, "frustumPlanes");
+	batch.cullDrawCntLoc = glGetUniformLocation(cullProgID, "drawCnt");
+	batch.compactDrawsLoc = glGetUniformLocation(cullProgID, "compactDraws");
+	batch.cullPhaseLoc = glGetUniformLocation(cullProgID, "cullPhase");
+	batch.hiZLoc = glGetUniformLocation(cullProgID, "hiZ");
+	batch.hiZViewProjMatLoc = glGetUniformLocation(cullProgID, "hiZViewProjMat");
+	batch.hiZValidLoc = glGetUniformLocation(cullProgID, "hiZValid");
+
+	// Without a GPU-side draw count, culled commands are zeroed in place instead of removed
+	batch.useDrawCount = GLEW_ARB_indirect_parameters && glMultiDrawElementsIndirectCountARB;
+	cout << "GPU culling: " << (batch.useDrawCount ? "compacted draws + indirect count" : "zeroed draws") << endl;
+
+	glGenBuffers(1, &(batch.cullInputBuffer));
+	glGenBuffers(1, &(batch.cullBoundsSSBO));
+	glGenBuffers(1, &(batch.drawCountBuffer));
+	glGenBuffers(1, &(batch.lateIndirectBuffer));
+	glGenBuffers(1, &(batch.lateDrawCountBuffer));
+	glGenBuffers(1, &(batch.retestSSBO));
+
+	GLuint zero = 0;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch.drawCountBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), &zero, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch.lateDrawCountBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), &zero, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	// Force culling buffers to be allocated at the current capacity
+	int capacity = batch.drawCapacity;
+	batch.drawCapacity = 0;
+	reserveBatchDraws(batch, capacity);
+}
+
+// Gribb/Hartmann: planes (pointing inwards, normalized) straight from the view-projection matrix
+void extractFrustumPlanes(const glm::mat4 &viewProjMat, glm::vec4 planes[6]) {
+	glm::mat4 m = glm::transpose(viewProjMat);
+	planes[0] = m[3] + m[0];	// Left
+	planes[1] = m[3] - m[0];	// Right
+	planes[2] = m[3] + m[1];	// Bottom
+	planes[3] = m[3] - m[1];	// Top
+	planes[4] = m[3] + m[2];	// Near
+	planes[5] = m[3] - m[2];	// Far
+	for(int i = 0; i < 6; i++) {
+		planes[i] /= glm::length(glm::vec3(planes[i]));
+	}
+}
+
+// Upload everything queued; the GPU decides what actually gets drawn
+static void uploadBatchCullInputs(MeshBatchGL &batch, int drawCnt) {
+	reserveBatchDraws(batch, drawCnt);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch.drawDataSSBO);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(BatchDrawData)*drawCnt, batch.drawData.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch.cullInputBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(DrawElementsIndirectCommand)*drawCnt, batch.commands.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch.cullBoundsSSBO);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(glm::vec4)*drawCnt, batch.drawBounds.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+// One compute pass writing commands (and count) for one cull phase (see FrustumCull.comp)
+static void runBatchCullPass(MeshBatchGL &batch, int drawCnt, int phase, const glm::vec4 planes[6],
+								GLuint outputBuffer, GLuint countBuffer, HiZBuffer *hz, GLuint drawDataBinding) {
+	GLuint zero = 0;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &zero);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	GLint prevProgID = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &prevProgID);
+	glUseProgram(batch.cullProgID);
+	glUniform4fv(batch.frustumPlanesLoc, 6, &planes[0][0]);
+	glUniform1ui(batch.cullDrawCntLoc, (GLuint)drawCnt);
+	glUniform1i(batch.compactDrawsLoc, batch.useDrawCount ? 1 : 0);
+	glUniform1i(batch.cullPhaseLoc, phase);
+
+	if(hz) {
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, hz->texID);
+		glUniform1i(batch.hiZLoc, 0);
+		glUniformMatrix4fv(batch.hiZViewProjMatLoc, 1, false, &(hz->viewProjMat[0][0]));
+		glUniform1i(batch.hiZValidLoc, hz->valid ? 1 : 0);
+	}
+	else {
+		glUniform1i(batch.hiZValidLoc, 0);
+	}
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, drawDataBinding, batch.drawDataSSBO);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BATCH_CULL_INPUT_BINDING, batch.cullInputBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BATCH_CULL_OUTPUT_BINDING, outputBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BATCH_CULL_BOUNDS_BINDING, batch.cullBoundsSSBO);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BATCH_CULL_COUNT_BINDING, countBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BATCH_CULL_RETEST_BINDING, batch.retestSSBO);
+
+	glDispatchCompute((drawCnt + BATCH_CULL_GROUP_SIZE - 1)/BATCH_CULL_GROUP_SIZE, 1, 1);
+
+	// Commands and count are read by the draw call itself
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+	if(hz) glBindTexture(GL_TEXTURE_2D, 0);
+	glUseProgram((GLuint)prevProgID);
+}
+
+// Draw whatever a cull pass left in commandBuffer
+static void drawBatchCullOutput(MeshBatchGL &batch, int drawCnt, GLuint commandBuffer, GLuint countBuffer) {
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glBindVertexArray(batch.VAO);
+	if(batch.useDrawCount) {
+		glBindBuffer(GL_PARAMETER_BUFFER_ARB, countBuffer);
+		glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, 0, drawCnt, 0);
+		glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+	}
+	else {
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, drawCnt, 0);
+	}
+	glBindVertexArray(0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+// Same as drawMeshBatch(), but a compute pass drops draws outside the view frustum first
+void drawMeshBatchCulled(MeshBatchGL &batch, const glm::mat4 &viewMat, const glm::mat4 &projMat,
+							GLuint drawDataBinding) {
+	if(!batch.cullProgID) {
+		drawMeshBatch(batch, drawDataBinding);
+		return;
+	}
+
+	int drawCnt = (int)batch.commands.size();
+	if(drawCnt == 0) return;
+
+	uploadBatchCullInputs(batch, drawCnt);
+
+	glm::vec4 planes[6];
+	extractFrustumPlanes(projMat*viewMat, planes);
+	runBatchCullPass(batch, drawCnt, 0, planes, batch.indirectBuffer, batch.drawCountBuffer,
+						nullptr, drawDataBinding);
+	drawBatchCullOutput(batch, drawCnt, batch.indirectBuffer, batch.drawCountBuffer);
+}
+
+// Two-phase occlusion culling on top of frustum culling:
+//	1) Draw what survives last frame's Hi-Z pyramid (reprojected with last frame's camera)
+//	2) Rebuild the pyramid from that depth, retest only what phase 1 rejected, and draw the newly visible
+//	3) Rebuild the pyramid once more, so late-phase draws also occlude next frame
+// The pyramid left behind is the one the next frame starts from. depthTexID must be the depth
+// attachment of the framebuffer currently being drawn into, with the same size as hz.
+void drawMeshBatchOcclusionCulled(MeshBatchGL &batch, HiZBuffer &hz, GLuint depthTexID,
+									const glm::mat4 &viewMat, const glm::mat4 &projMat,
+									GLuint drawDataBinding) {
+	if(!batch.cullProgID) {
+		drawMeshBatch(batch, drawDataBinding);
+		return;
+	}
+
+	int drawCnt = (int)batch.commands.size();
+	if(drawCnt == 0) return;
+
+	uploadBatchCullInputs(batch, drawCnt);
+
+	glm::mat4 viewProjMat = projMat*viewMat;
+	glm::vec4 planes[6];
+	extractFrustumPlanes(viewProjMat, planes);
+
+	// Early phase
+	runBatchCullPass(batch, drawCnt, 1, planes, batch.indirectBuffer, batch.drawCountBuffer,
+						&hz, drawDataBinding);
+	drawBatchCullOutput(batch, drawCnt, batch.indirectBuffer, batch.drawCountBuffer);
+
+	// Occluders drawn so far -> new pyramid
+	buildHiZBuffer(hz, depthTexID, viewProjMat);
+
+	// Late phase (disoccluded objects)
+	runBatchCullPass(batch, drawCnt, 2, planes, batch.lateIndirectBuffer, batch.lateDrawCountBuffer,
+						&hz, drawDataBinding);
+	drawBatchCullOutput(batch, drawCnt, batch.lateIndirectBuffer, batch.lateDrawCountBuffer);
+
+	// Full depth of everything drawn -> next frame's pyramid (otherwise anything that only
+	// became visible this frame would be missing as an occluder, and keep getting retested)
+	buildHiZBuffer(hz, depthTexID, viewProjMat);
+}
+
+// Read back how many draws survived culling last time (stalls; for debugging/stats only)
+int getBatchVisibleCount(MeshBatchGL &batch) {
+	if(!batch.drawCountBuffer) return (int)batch.commands.size();
+
+	GLuint cnt = 0;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch.drawCountBuffer);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &cnt);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	return (int)cnt;
+}
+
+// Cleanup batch
+void cleanupMeshBatch(MeshBatchGL &batch) {
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindVertexArray(0);
+
+	glDeleteBuffers(1, &(batch.VBO));
+	glDeleteBuffers(1, &(batch.EBO));
+	glDeleteBuffers(1, &(batch.drawIDBuffer));
+	glDeleteBuffers(1, &(batch.indirectBuffer));
+	glDeleteBuffers(1, &(batch.drawDataSSBO));
+	glDeleteBuffers(1, &(batch.cullInputBuffer));
+	glDeleteBuffers(1, &(batch.cullBoundsSSBO));
+	glDeleteBuffers(1, &(batch.drawCountBuffer));
+	glDeleteBuffers(1, &(batch.lateIndirectBuffer));
+	glDeleteBuffers(1, &(batch.lateDrawCountBuffer));
+	glDeleteBuffers(1, &(batch.retestSSBO));
+	glDeleteVertexArrays(1, &(batch.VAO));
+
+	batch.VBO = 0;
+	batch.EBO = 0;
+	batch.drawIDBuffer = 0;
+	batch.indirectBuffer = 0;
+	batch.drawDataSSBO = 0;
+	batch.cullInputBuffer = 0;
+	batch.cullBoundsSSBO = 0;
+	batch.drawCountBuffer = 0;
+	batch.lateIndirectBuffer = 0;
+	batch.lateDrawCountBuffer = 0;
+	batch.retestSSBO = 0;
+	batch.cullProgID = 0;
+	batch.VAO = 0;
+	batch.drawCapacity = 0;
+	batch.meshes.clear();
+	batch.commands.clear();
+	batch.drawData.clear();
+	batch.drawBounds.clear();
+}
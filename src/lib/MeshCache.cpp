@@ -0,0 +1,430 @@
+#include <cstring>
+#include <cstdio>
+#include "MeshCache.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static const char MESH_CACHE_MAGIC[4] = { 'M', 'C', 'S', 'H' };
+
+// Map whole file into memory (read-only)
+bool mapFileReadOnly(string filename, MappedFile &mf) {
+	unmapFile(mf);
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+								OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER fileSize;
+	if(!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(!mapping) {
+		CloseHandle(file);
+		return false;
+	}
+
+	void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if(!data) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	mf.data = (const unsigned char*)data;
+	mf.size = (size_t)fileSize.QuadPart;
+	mf.fileHandle = file;
+	mf.mapHandle = mapping;
+#else
+	int fd = open(filename.c_str(), O_RDONLY);
+	if(fd < 0) return false;
+
+	struct stat st;
+	if(fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return false;
+	}
+
+	void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if(data == MAP_FAILED) {
+		close(fd);
+		return false;
+	}
+
+	mf.data = (const unsigned char*)data;
+	mf.size = (size_t)st.st_size;
+	mf.fd = fd;
+#endif
+
+	return true;
+}
+
+// Unmap file (safe to call on an unmapped file)
+void unmapFile(MappedFile &mf) {
+	if(mf.data) {
+#ifdef _WIN32
+		UnmapViewOfFile(mf.data);
+		CloseHandle((HANDLE)mf.mapHandle);
+		CloseHandle((HANDLE)mf.fileHandle);
+#else
+		munmap((void*)mf.data, mf.size);
+		close(mf.fd);
+#endif
+	}
+
+	mf.data = nullptr;
+	mf.size = 0;
+	mf.fileHandle = nullptr;
+	mf.mapHandle = nullptr;
+	mf.fd = -1;
+}
+
+// 64-bit FNV-1a hash of a file's contents (0 if it can't be read)
+uint64_t hashFile(string filename) {
+	MappedFile mf;
+	if(!mapFileReadOnly(filename, mf)) return 0;
+
+	uint64_t hash = 14695981039346656037ULL;
+	for(size_t i = 0; i < mf.size; i++) {
+		hash ^= mf.data[i];
+		hash *= 1099511628211ULL;
+	}
+	// Mix in the size too, so truncated files don't collide as easily
+	hash ^= (uint64_t)mf.size;
+	hash *= 1099511628211ULL;
+
+	unmapFile(mf);
+	return hash;
+}
+
+// Round up to 16 bytes so every section is safely aligned when mapped
+static uint64_t alignCacheOffset(uint64_t offset) {
+	return (offset + 15) & ~(uint64_t)15;
+}
+
+// Write raw bytes at a given offset (padding with zeros up to it)
+static void writeCacheSection(ofstream &file, uint64_t offset, const void *data, size_t size) {
+	uint64_t pos = (uint64_t)file.tellp();
+	static const char zeros[16] = {};
+	while(pos < offset) {
+		size_t padCnt = (size_t)min<uint64_t>(offset - pos, sizeof(zeros));
+		file.write(zeros, padCnt);
+		pos += padCnt;
+	}
+	if(size > 0) file.write((const char*)data, size);
+}
+
+// Write processed meshes and node hierarchy to disk
+bool writeMeshCache(string cacheFilename, uint64_t sourceHash, vector<Mesh> &allMeshes, SceneGraph &sg) {
+	MeshCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MESH_CACHE_MAGIC, 4);
+	header.version = MESH_CACHE_VERSION;
+	header.sourceHash = sourceHash;
+	header.vertexSize = sizeof(Vertex);
+	header.meshCnt = (uint32_t)allMeshes.size();
+	header.nodeCnt = (uint32_t)sg.parents.size();
+	header.nodeMeshIndexCnt = (uint32_t)sg.meshIndices.size();
+
+	// Build mesh table
+	vector<MeshCacheEntry> entries(allMeshes.size());
+	uint64_t vertCnt = 0;
+	uint64_t indexCnt = 0;
+	uint64_t lodCnt = 0;
+	uint64_t lodIndexCnt = 0;
+	for(size_t i = 0; i < allMeshes.size(); i++) {
+		entries[i].firstVertex = vertCnt;
+		entries[i].vertexCnt = allMeshes[i].vertices.size();
+		entries[i].firstIndex = indexCnt;
+		entries[i].indexCnt = allMeshes[i].indices.size();
+		entries[i].firstLOD = lodCnt;
+		entries[i].lodCnt = allMeshes[i].lods.size();
+		entries[i].firstLODIndex = lodIndexCnt;
+		entries[i].lodIndexCnt = allMeshes[i].lodIndices.size();
+		vertCnt += entries[i].vertexCnt;
+		indexCnt += entries[i].indexCnt;
+		lodCnt += entries[i].lodCnt;
+		lodIndexCnt += entries[i].lodIndexCnt;
+	}
+	header.lodCnt = (uint32_t)lodCnt;
+	header.lodIndexCnt = (uint32_t)lodIndexCnt;
+
+	// Lay out sections
+	uint64_t offset = alignCacheOffset(sizeof(MeshCacheHeader));
+	header.meshTableOffset = offset;
+	offset = alignCacheOffset(offset + sizeof(MeshCacheEntry)*entries.size());
+	header.vertexOffset = offset;
+	offset = alignCacheOffset(offset + sizeof(Vertex)*vertCnt);
+	header.indexOffset = offset;
+	offset = alignCacheOffset(offset + sizeof(unsigned int)*indexCnt);
+	header.nodeParentOffset = offset;
+	offset = alignCacheOffset(offset + sizeof(int32_t)*header.nodeCnt);
+	header.nodeMatrixOffset = offset;
+	offset = alignCacheOffset(offset + sizeof(glm::mat4)*header.nodeCnt);
+	header.nodeMeshStartOffset = offset;
+	offset = alignCacheOffset(offset + sizeof(uint32_t)*header.nodeCnt);
+	header.nodeMeshCountOffset = offset;
+	offset = alignCacheOffset(offset + sizeof(uint32_t)*header.nodeCnt);
+	header.nodeMeshIndexOffset = offset;
+	offset = alignCacheOffset(offset + sizeof(uint32_t)*header.nodeMeshIndexCnt);
+	header.lodTableOffset = offset;
+	offset = alignCacheOffset(offset + sizeof(MeshLOD)*lodCnt);
+	header.lodIndexOffset = offset;
+	offset += sizeof(unsigned int)*lodIndexCnt;
+	header.fileSize = offset;
+
+	// Write to a temporary file first so a crash never leaves a half-written cache behind
+	string tempFilename = cacheFilename + ".tmp";
+	ofstream file(tempFilename, ios::binary | ios::trunc);
+	if(!file) {
+		cerr << "ERROR: Could not write mesh cache: " << tempFilename << endl;
+		return false;
+	}
+
+	vector<int32_t> parents(sg.parents.begin(), sg.parents.end());
+
+	writeCacheSection(file, 0, &header, sizeof(header));
+	writeCacheSection(file, header.meshTableOffset, entries.data(), sizeof(MeshCacheEntry)*entries.size());
+	for(size_t i = 0; i < allMeshes.size(); i++) {
+		writeCacheSection(file, header.vertexOffset + sizeof(Vertex)*entries[i].firstVertex,
+							allMeshes[i].vertices.data(), sizeof(Vertex)*allMeshes[i].vertices.size());
+	}
+	for(size_t i = 0; i < allMeshes.size(); i++) {
+		writeCacheSection(file, header.indexOffset + sizeof(unsigned int)*entries[i].firstIndex,
+							allMeshes[i].indices.data(), sizeof(unsigned int)*allMeshes[i].indices.size());
+	}
+	writeCacheSection(file, header.nodeParentOffset, parents.data(), sizeof(int32_t)*parents.size());
+	writeCacheSection(file, header.nodeMatrixOffset, sg.localMats.data(), sizeof(glm::mat4)*sg.localMats.size());
+	writeCacheSection(file, header.nodeMeshStartOffset, sg.meshStarts.data(), sizeof(uint32_t)*sg.meshStarts.size());
+	writeCacheSection(file, header.nodeMeshCountOffset, sg.meshCounts.data(), sizeof(uint32_t)*sg.meshCounts.size());
+	writeCacheSection(file, header.nodeMeshIndexOffset, sg.meshIndices.data(), sizeof(uint32_t)*sg.meshIndices.size());
+	for(size_t i = 0; i < allMeshes.size(); i++) {
+		writeCacheSection(file, header.lodTableOffset + sizeof(MeshLOD)*entries[i].firstLOD,
+							allMeshes[i].lods.data(), sizeof(MeshLOD)*allMeshes[i].lods.size());
+	}
+	for(size_t i = 0; i < allMeshes.size(); i++) {
+		writeCacheSection(file, header.lodIndexOffset + sizeof(unsigned int)*entries[i].firstLODIndex,
+							allMeshes[i].lodIndices.data(), sizeof(unsigned int)*allMeshes[i].lodIndices.size());
+	}
+
+	bool ok = file.good();
+	file.close();
+	if(!ok) {
+		remove(tempFilename.c_str());
+		cerr << "ERROR: Failed writing mesh cache: " << tempFilename << endl;
+		return false;
+	}
+
+	// Replaces the old cache atomically on POSIX; Windows' rename() won't overwrite, so delete first there
+#ifdef _WIN32
+	remove(cacheFilename.c_str());
+#endif
+	if(rename(tempFilename.c_str(), cacheFilename.c_str()) != 0) {
+		remove(tempFilename.c_str());
+		cerr << "ERROR: Could not rename mesh cache: " << cacheFilename << endl;
+		return false;
+	}
+
+	return true;
+}
+
+// Does [offset, offset + count*stride) lie inside the file (and is it aligned for its type)?
+static bool isCacheSectionValid(const MeshCacheHeader *header, uint64_t offset, uint64_t count,
+								uint64_t stride, uint64_t alignment) {
+	if(offset < sizeof(MeshCacheHeader) || offset > header->fileSize) return false;
+	if(offset % alignment != 0) return false;
+	return count <= (header->fileSize - offset)/stride;
+}
+
+// Check every offset, count and stored index, so a corrupt (or truncated,
+// or hand-edited) cache is rebuilt instead of being read out of bounds
+static bool validateMeshCache(const MeshCacheHeader *header, const unsigned char *base) {
+	// Fixed-size tables
+	if(!isCacheSectionValid(header, header->meshTableOffset, header->meshCnt, sizeof(MeshCacheEntry), alignof(MeshCacheEntry))
+		|| !isCacheSectionValid(header, header->nodeParentOffset, header->nodeCnt, sizeof(int32_t), alignof(int32_t))
+		|| !isCacheSectionValid(header, header->nodeMatrixOffset, header->nodeCnt, sizeof(glm::mat4), alignof(glm::mat4))
+		|| !isCacheSectionValid(header, header->nodeMeshStartOffset, header->nodeCnt, sizeof(uint32_t), alignof(uint32_t))
+		|| !isCacheSectionValid(header, header->nodeMeshCountOffset, header->nodeCnt, sizeof(uint32_t), alignof(uint32_t))
+		|| !isCacheSectionValid(header, header->nodeMeshIndexOffset, header->nodeMeshIndexCnt, sizeof(uint32_t), alignof(uint32_t))
+		|| !isCacheSectionValid(header, header->lodTableOffset, header->lodCnt, sizeof(MeshLOD), alignof(MeshLOD))
+		|| !isCacheSectionValid(header, header->lodIndexOffset, header->lodIndexCnt, sizeof(unsigned int), alignof(unsigned int))) {
+		return false;
+	}
+
+	// Meshes are stored back to back, so the totals follow from the mesh table
+	const MeshCacheEntry *meshes = (const MeshCacheEntry*)(base + header->meshTableOffset);
+	uint64_t vertCnt = 0, indexCnt = 0, lodCnt = 0, lodIndexCnt = 0;
+	for(uint32_t i = 0; i < header->meshCnt; i++) {
+		const MeshCacheEntry &e = meshes[i];
+		if(e.firstVertex != vertCnt || e.firstIndex != indexCnt
+			|| e.firstLOD != lodCnt || e.firstLODIndex != lodIndexCnt) {
+			return false;
+		}
+		// Counts are checked against the file size below; this only keeps the sums from wrapping
+		if(e.vertexCnt > header->fileSize || e.indexCnt > header->fileSize
+			|| e.lodCnt > header->lodCnt || e.lodIndexCnt > header->lodIndexCnt) {
+			return false;
+		}
+		vertCnt += e.vertexCnt;
+		indexCnt += e.indexCnt;
+		lodCnt += e.lodCnt;
+		lodIndexCnt += e.lodIndexCnt;
+	}
+	if(lodCnt != header->lodCnt || lodIndexCnt != header->lodIndexCnt
+		|| !isCacheSectionValid(header, header->vertexOffset, vertCnt, sizeof(Vertex), alignof(Vertex))
+		|| !isCacheSectionValid(header, header->indexOffset, indexCnt, sizeof(unsigned int), alignof(unsigned int))) {
+		return false;
+	}
+
+	// Vertex indices (full mesh and LODs) must stay inside their own mesh
+	const unsigned int *indices = (const unsigned int*)(base + header->indexOffset);
+	const MeshLOD *lods = (const MeshLOD*)(base + header->lodTableOffset);
+	const unsigned int *lodIndices = (const unsigned int*)(base + header->lodIndexOffset);
+	for(uint32_t i = 0; i < header->meshCnt; i++) {
+		const MeshCacheEntry &e = meshes[i];
+		for(uint64_t j = 0; j < e.indexCnt; j++) {
+			if(indices[e.firstIndex + j] >= e.vertexCnt) return false;
+		}
+		for(uint64_t j = 0; j < e.lodCnt; j++) {
+			const MeshLOD &lod = lods[e.firstLOD + j];
+			if((uint64_t)lod.firstIndex + lod.indexCnt > e.lodIndexCnt) return false;
+		}
+		for(uint64_t j = 0; j < e.lodIndexCnt; j++) {
+			if(lodIndices[e.firstLODIndex + j] >= e.vertexCnt) return false;
+		}
+	}
+
+	// Node hierarchy: parents come before children (only the root has none),
+	// and mesh lists point into the mesh table
+	const int32_t *parents = (const int32_t*)(base + header->nodeParentOffset);
+	const uint32_t *meshStarts = (const uint32_t*)(base + header->nodeMeshStartOffset);
+	const uint32_t *meshCounts = (const uint32_t*)(base + header->nodeMeshCountOffset);
+	const uint32_t *meshIndices = (const uint32_t*)(base + header->nodeMeshIndexOffset);
+	for(uint32_t i = 0; i < header->nodeCnt; i++) {
+		if(i == 0 ? parents[i] != -1 : (parents[i] < 0 || (uint32_t)parents[i] >= i)) return false;
+		if((uint64_t)meshStarts[i] + meshCounts[i] > header->nodeMeshIndexCnt) return false;
+	}
+	for(uint32_t i = 0; i < header->nodeMeshIndexCnt; i++) {
+		if(meshIndices[i] >= header->meshCnt) return false;
+	}
+
+	return true;
+}
+
+// Open and validate cache; returns false if missing, stale or corrupt
+bool openMeshCache(string cacheFilename, uint64_t sourceHash, MeshCache &cache) {
+	closeMeshCache(cache);
+
+	if(!mapFileReadOnly(cacheFilename, cache.file)) return false;
+
+	const MeshCacheHeader *header = (const MeshCacheHeader*)cache.file.data;
+	bool valid = cache.file.size >= sizeof(MeshCacheHeader)
+					&& memcmp(header->magic, MESH_CACHE_MAGIC, 4) == 0
+					&& header->version == MESH_CACHE_VERSION
+					&& header->vertexSize == sizeof(Vertex)
+					&& header->sourceHash == sourceHash
+					&& header->fileSize == cache.file.size;
+
+	if(valid && !validateMeshCache(header, cache.file.data)) {
+		cerr << "ERROR: Mesh cache is corrupt (rebuilding): " << cacheFilename << endl;
+		valid = false;
+	}
+
+	if(!valid) {
+		closeMeshCache(cache);
+		return false;
+	}
+
+	const unsigned char *base = cache.file.data;
+	cache.header = header;
+	cache.meshes = (const MeshCacheEntry*)(base + header->meshTableOffset);
+	cache.vertices = (const Vertex*)(base + header->vertexOffset);
+	cache.indices = (const unsigned int*)(base + header->indexOffset);
+	cache.lods = (const MeshLOD*)(base + header->lodTableOffset);
+	cache.lodIndices = (const unsigned int*)(base + header->lodIndexOffset);
+	return true;
+}
+
+// Get number of meshes in cache
+int getCachedMeshCount(MeshCache &cache) {
+	return cache.header ? (int)cache.header->meshCnt : 0;
+}
+
+// Upload one cached mesh straight from the mapped file
+void createMeshGLFromCache(MeshCache &cache, int meshIndex, MeshGL &mgl, VertexFormat format) {
+	const MeshCacheEntry &e = cache.meshes[meshIndex];
+	createMeshGL(cache.vertices + e.firstVertex, (size_t)e.vertexCnt,
+					cache.indices + e.firstIndex, (size_t)e.indexCnt,
+					mgl, format);
+}
+
+// Build the shared-buffer batch of every cached mesh, reading the mapped sections directly
+void createMeshBatchGLFromCache(MeshCache &cache, MeshBatchGL &batch, VertexFormat format) {
+	int meshCnt = getCachedMeshCount(cache);
+	vector<BatchMeshSource> sources(meshCnt);
+	for(int i = 0; i < meshCnt; i++) {
+		const MeshCacheEntry &e = cache.meshes[i];
+		sources[i].vertices = cache.vertices + e.firstVertex;
+		sources[i].vertCnt = (size_t)e.vertexCnt;
+		sources[i].indices = cache.indices + e.firstIndex;
+		sources[i].indexCnt = (size_t)e.indexCnt;
+		sources[i].lods = cache.lods + e.firstLOD;
+		sources[i].lodCnt = (size_t)e.lodCnt;
+		sources[i].lodIndices = cache.lodIndices + e.firstLODIndex;
+		sources[i].lodIndexCnt = (size_t)e.lodIndexCnt;
+	}
+	createMeshBatchGL(sources, batch, format);
+}
+
+// Copy one cached mesh (and its LODs) back into host memory
+void getMeshFromCache(MeshCache &cache, int meshIndex, Mesh &m) {
+	const MeshCacheEntry &e = cache.meshes[meshIndex];
+	m.vertices.assign(cache.vertices + e.firstVertex, cache.vertices + e.firstVertex + e.vertexCnt);
+	m.indices.assign(cache.indices + e.firstIndex, cache.indices + e.firstIndex + e.indexCnt);
+	m.lods.assign(cache.lods + e.firstLOD, cache.lods + e.firstLOD + e.lodCnt);
+	m.lodIndices.assign(cache.lodIndices + e.firstLODIndex, cache.lodIndices + e.firstLODIndex + e.lodIndexCnt);
+}
+
+// Rebuild scene graph from cached node data
+void getSceneGraphFromCache(MeshCache &cache, SceneGraph &sg) {
+	cleanupSceneGraph(sg);
+
+	const MeshCacheHeader *header = cache.header;
+	const unsigned char *base = cache.file.data;
+	const int32_t *parents = (const int32_t*)(base + header->nodeParentOffset);
+	const glm::mat4 *localMats = (const glm::mat4*)(base + header->nodeMatrixOffset);
+	const uint32_t *meshStarts = (const uint32_t*)(base + header->nodeMeshStartOffset);
+	const uint32_t *meshCounts = (const uint32_t*)(base + header->nodeMeshCountOffset);
+	const uint32_t *meshIndices = (const uint32_t*)(base + header->nodeMeshIndexOffset);
+
+	sg.parents.assign(parents, parents + header->nodeCnt);
+	sg.localMats.assign(localMats, localMats + header->nodeCnt);
+	sg.meshStarts.assign(meshStarts, meshStarts + header->nodeCnt);
+	sg.meshCounts.assign(meshCounts, meshCounts + header->nodeCnt);
+	sg.meshIndices.assign(meshIndices, meshIndices + header->nodeMeshIndexCnt);
+
+	finalizeSceneGraph(sg);
+}
+
+// Close cache
+void closeMeshCache(MeshCache &cache) {
+	unmapFile(cache.file);
+	cache.header = nullptr;
+	cache.meshes = nullptr;
+	cache.vertices = nullptr;
+	cache.indices = nullptr;
+	cache.lods = nullptr;
+	cache.lodIndices = nullptr;
+}
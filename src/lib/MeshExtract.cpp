@@ -0,0 +1,99 @@
+#include "MeshExtract.hpp"
+
+// Count indices up front so the index array is allocated exactly once
+static size_t countMeshIndices(const aiMesh *mesh) {
+	// Common case after aiProcess_Triangulate
+	if(mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE) {
+		return (size_t)mesh->mNumFaces*3;
+	}
+
+	size_t cnt = 0;
+	for(unsigned int i = 0; i < mesh->mNumFaces; i++) {
+		cnt += mesh->mFaces[i].mNumIndices;
+	}
+	return cnt;
+}
+
+// Convert one Assimp mesh into our Mesh format.
+// Buffers are sized exactly up front, and each attribute is copied in its own
+// branch-free loop so the compiler can vectorize the conversions.
+void extractMeshDataFast(const aiMesh *mesh, Mesh &m, glm::vec4 defaultColor) {
+	size_t vertCnt = mesh->mNumVertices;
+	m.vertices.clear();
+	m.indices.clear();
+	m.vertices.resize(vertCnt);
+	m.indices.resize(countMeshIndices(mesh));
+
+	Vertex *verts = m.vertices.data();
+
+	const aiVector3D *positions = mesh->mVertices;
+	for(size_t i = 0; i < vertCnt; i++) {
+		verts[i].position = glm::vec3(positions[i].x, positions[i].y, positions[i].z);
+	}
+
+	if(mesh->HasVertexColors(0)) {
+		const aiColor4D *colors = mesh->mColors[0];
+		for(size_t i = 0; i < vertCnt; i++) {
+			verts[i].color = glm::vec4(colors[i].r, colors[i].g, colors[i].b, colors[i].a);
+		}
+	}
+	else {
+		for(size_t i = 0; i < vertCnt; i++) {
+			verts[i].color = defaultColor;
+		}
+	}
+
+	if(mesh->HasNormals()) {
+		const aiVector3D *normals = mesh->mNormals;
+		for(size_t i = 0; i < vertCnt; i++) {
+			verts[i].normal = glm::vec3(normals[i].x, normals[i].y, normals[i].z);
+		}
+	}
+
+	if(mesh->HasTextureCoords(0)) {
+		const aiVector3D *uvs = mesh->mTextureCoords[0];
+		for(size_t i = 0; i < vertCnt; i++) {
+			verts[i].texcoord = glm::vec2(uvs[i].x, uvs[i].y);
+		}
+	}
+
+	if(mesh->HasTangentsAndBitangents()) {
+		const aiVector3D *tangents = mesh->mTangents;
+		for(size_t i = 0; i < vertCnt; i++) {
+			verts[i].tangent = glm::vec3(tangents[i].x, tangents[i].y, tangents[i].z);
+		}
+	}
+
+	// Faces are read in place (no aiFace copies)
+	unsigned int *out = m.indices.data();
+	if(mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE) {
+		for(unsigned int i = 0; i < mesh->mNumFaces; i++) {
+			const unsigned int *faceIndices = mesh->mFaces[i].mIndices;
+			out[0] = faceIndices[0];
+			out[1] = faceIndices[1];
+			out[2] = faceIndices[2];
+			out += 3;
+		}
+	}
+	else {
+		for(unsigned int i = 0; i < mesh->mNumFaces; i++) {
+			const aiFace &f = mesh->mFaces[i];
+			for(unsigned int j = 0; j < f.mNumIndices; j++) {
+				*out++ = f.mIndices[j];
+			}
+		}
+	}
+}
+
+// Convert every mesh in the scene, spread across the thread pool.
+// No GL calls happen here, so the results can be uploaded afterwards on the context thread.
+void extractAllMeshData(const aiScene *scene, vector<Mesh> &allMeshes, ThreadPool &pool,
+						glm::vec4 defaultColor) {
+	int meshCnt = (int)scene->mNumMeshes;
+	allMeshes.clear();
+	allMeshes.resize(meshCnt);
+
+	parallelFor(pool, meshCnt, [&](int i) {
+		extractMeshDataFast(scene->mMeshes[i], allMeshes[i], defaultColor);
+	});
+}
@@ -1,11 +1,152 @@
+#include <cstring>
+#include <algorithm>
 #include "MeshGLData.hpp"
+#include "glm/gtc/packing.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+// Size of one vertex in the given format
+size_t getVertexStride(VertexFormat format) {
+	switch(format) {
+		case VERTEX_FORMAT_PACKED:			return sizeof(PackedVertex);
+		case VERTEX_FORMAT_PACKED_QUANT:	return sizeof(QuantVertex);
+		default:							return sizeof(Vertex);
+	}
+}
+
+// Convert [0,1] color to unorm8
+static void packColor(const glm::vec4 &c, uint8_t out[4]) {
+	glm::vec4 cc = glm::clamp(c, 0.0f, 1.0f)*255.0f + 0.5f;
+	for(int i = 0; i < 4; i++) {
+		out[i] = (uint8_t)cc[i];
+	}
+}
+
+// Attributes shared by PackedVertex and QuantVertex
+template<typename T>
+static void packAttributes(const Vertex &v, T &p) {
+	packColor(v.color, p.color);
+	p.normal = glm::packSnorm3x10_1x2(glm::vec4(v.normal, 0.0f));
+	p.texcoord = glm::packHalf2x16(v.texcoord);
+	p.tangent = glm::packSnorm3x10_1x2(glm::vec4(v.tangent, 0.0f));
+}
+
+// Convert vertices into the raw bytes for the given format
+void packVertices(const Vertex *vertices, size_t vertCnt, VertexFormat format, 
+					vector<unsigned char> &data, glm::mat4 &dequantMat) {
+	data.resize(getVertexStride(format)*vertCnt);
+	dequantMat = glm::mat4(1.0);
+
+	if(format == VERTEX_FORMAT_FULL) {
+		if(vertCnt > 0) memcpy(data.data(), vertices, data.size());
+	}
+	else if(format == VERTEX_FORMAT_PACKED) {
+		PackedVertex *out = (PackedVertex*)data.data();
+		for(size_t i = 0; i < vertCnt; i++) {
+			out[i].position = vertices[i].position;
+			packAttributes(vertices[i], out[i]);
+		}
+	}
+	else {
+		// Quantize positions relative to the bounding box
+		glm::vec3 minP(0,0,0);
+		glm::vec3 maxP(0,0,0);
+		if(vertCnt > 0) {
+			minP = maxP = vertices[0].position;
+		}
+		for(size_t i = 1; i < vertCnt; i++) {
+			minP = glm::min(minP, vertices[i].position);
+			maxP = glm::max(maxP, vertices[i].position);
+		}
+
+		glm::vec3 extent = maxP - minP;
+		for(int c = 0; c < 3; c++) {
+			if(extent[c] <= 0.0f) extent[c] = 1.0f;
+		}
+
+		QuantVertex *out = (QuantVertex*)data.data();
+		for(size_t i = 0; i < vertCnt; i++) {
+			glm::vec3 q = (vertices[i].position - minP)/extent;
+			q = glm::clamp(q, 0.0f, 1.0f)*65535.0f + 0.5f;
+			out[i].position[0] = (uint16_t)q.x;
+			out[i].position[1] = (uint16_t)q.y;
+			out[i].position[2] = (uint16_t)q.z;
+			out[i].position[3] = 0;
+			packAttributes(vertices[i], out[i]);
+		}
+
+		// unorm16 comes back as [0,1], so undo the normalization with scale + offset
+		dequantMat = glm::translate(glm::mat4(1.0), minP)*glm::scale(glm::mat4(1.0), extent);
+	}
+}
+
+void packVertices(Mesh &m, VertexFormat format, vector<unsigned char> &data, glm::mat4 &dequantMat) {
+	packVertices(m.vertices.data(), m.vertices.size(), format, data, dequantMat);
+}
+
+// Set up attribute mappings for the currently bound VAO and VBO
+void setupVertexAttributes(VertexFormat format) {
+	GLsizei stride = (GLsizei)getVertexStride(format);
+
+	// Enable the vertex attribute arrays
+	glEnableVertexAttribArray(0);	// position
+	glEnableVertexAttribArray(1);	// color
+	glEnableVertexAttribArray(2);	// normal
+	glEnableVertexAttribArray(3);	// texcoord
+	glEnableVertexAttribArray(4);	// tangent
+
+	// Attribute, # of components, type, normalized?, stride, array buffer offset
+	if(format == VERTEX_FORMAT_FULL) {
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, 
+								(void*)offsetof(Vertex, position));
+		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, 
+								(void*)offsetof(Vertex, color));
+		glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, 
+								(void*)offsetof(Vertex, normal));
+		glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, stride, 
+								(void*)offsetof(Vertex, texcoord));
+		glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, stride, 
+								(void*)offsetof(Vertex, tangent));
+	}
+	else {
+		// Both packed layouts share the attribute offsets after the position
+		if(format == VERTEX_FORMAT_PACKED) {
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, 
+									(void*)offsetof(PackedVertex, position));
+		}
+		else {
+			glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, 
+									(void*)offsetof(QuantVertex, position));
+		}
+
+		size_t base = (format == VERTEX_FORMAT_PACKED) ? offsetof(PackedVertex, color) 
+														: offsetof(QuantVertex, color);
+		glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)base);
+		glVertexAttribPointer(2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)(base + 4));
+		glVertexAttribPointer(3, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)(base + 8));
+		glVertexAttribPointer(4, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)(base + 12));
+	}
+}
+
+// Create OpenGL mesh (VAO) from raw vertex and index arrays
+void createMeshGL(const Vertex *vertices, size_t vertCnt, 
+					const unsigned int *indices, size_t indexCnt,
+					MeshGL &mgl, VertexFormat format) {
+	mgl.format = format;
+	mgl.dequantMat = glm::mat4(1.0);
 
-// Create OpenGL mesh (VAO) from mesh data
-void createMeshGL(Mesh &m, MeshGL &mgl) {
 	// Create Vertex Buffer Object (VBO)
 	glGenBuffers(1, &(mgl.VBO));
 	glBindBuffer(GL_ARRAY_BUFFER, mgl.VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex)*m.vertices.size(), m.vertices.data(), GL_STATIC_DRAW);
+	if(format == VERTEX_FORMAT_FULL) {
+		// Already in GPU layout; upload straight from the source
+		glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex)*vertCnt, vertices, GL_STATIC_DRAW);
+	}
+	else {
+		// Convert vertices to requested layout first
+		vector<unsigned char> vertData;
+		packVertices(vertices, vertCnt, format, vertData, mgl.dequantMat);
+		glBufferData(GL_ARRAY_BUFFER, vertData.size(), vertData.data(), GL_STATIC_DRAW);
+	}
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	
 	// Create Vertex Array Object (VAO)
@@ -14,45 +155,32 @@ void createMeshGL(Mesh &m, MeshGL &mgl) {
 	// Enable VAO
 	glBindVertexArray(mgl.VAO);
 
-	// Enable the first two vertex attribute arrays
-	glEnableVertexAttribArray(0);	// position
-	glEnableVertexAttribArray(1);	// color
-	glEnableVertexAttribArray(2);
-	glEnableVertexAttribArray(3);
-	glEnableVertexAttribArray(4);
-	
 	// Bind the VBO and set up data mappings so that VAO knows how to read it
-	// 0 = pos (3 elements)
-	// 1 = color (4 elements)
 	glBindBuffer(GL_ARRAY_BUFFER, mgl.VBO);	
-
-	// Attribute, # of components, type, normalized?, stride, array buffer offset
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), 
-							(void*)offsetof(Vertex, position));
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), 
-							(void*)offsetof(Vertex, color));
-	glVertexAttribPointer(2, 3, GL_FLOAT, false, sizeof(Vertex), 
-                            (void*)offsetof(Vertex, normal));
-    glVertexAttribPointer(3, 2, GL_FLOAT, false, sizeof(Vertex), 
-                            (void*)offsetof(Vertex, texcoord));
-    glVertexAttribPointer(4, 3, GL_FLOAT, false, sizeof(Vertex), 
-                            (void*)offsetof(Vertex, tangent));
+	setupVertexAttributes(format);
 	
 	// Create Element Buffer Object (EBO)
 	glGenBuffers(1, &(mgl.EBO));
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mgl.EBO);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-		m.indices.size() * sizeof(GLuint),
-		m.indices.data(),
+		indexCnt * sizeof(GLuint),
+		indices,
 		GL_STATIC_DRAW);
 
 	// Set index count
-	mgl.indexCnt = (int)m.indices.size();
+	mgl.indexCnt = (int)indexCnt;
 
 	// Unbind vertex array for now
 	glBindVertexArray(0);
 }
 
+// Create OpenGL mesh (VAO) from mesh data
+void createMeshGL(Mesh &m, MeshGL &mgl, VertexFormat format) {
+	createMeshGL(m.vertices.data(), m.vertices.size(), 
+					m.indices.data(), m.indices.size(), 
+					mgl, format);
+}
+
 // Draw OpenGL mesh
 void drawMesh(MeshGL &mgl) {
 	glBindVertexArray(mgl.VAO);
@@ -76,4 +204,68 @@ void cleanupMesh(MeshGL &mgl) {
 	mgl.VAO = 0;
 
 	mgl.indexCnt = 0;
+	mgl.dequantMat = glm::mat4(1.0);
+}
+
+// Create per-instance transform buffer with room for capacity instances
+void createInstanceBufferGL(InstanceBufferGL &ib, int capacity) {
+	ib.capacity = max(capacity, 1);
+	ib.instanceCnt = 0;
+	glGenBuffers(1, &(ib.buffer));
+	glBindBuffer(GL_ARRAY_BUFFER, ib.buffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::mat4)*ib.capacity, NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Replace all instance transforms (the buffer name never changes, so attached VAOs stay valid)
+void updateInstanceBufferGL(InstanceBufferGL &ib, const glm::mat4 *modelMats, int instanceCnt) {
+	glBindBuffer(GL_ARRAY_BUFFER, ib.buffer);
+	if(instanceCnt > ib.capacity) {
+		ib.capacity = max(instanceCnt, ib.capacity*2);
+	}
+	// Orphan first so the driver doesn't wait for draws still reading last frame's data
+	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::mat4)*ib.capacity, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(glm::mat4)*instanceCnt, modelMats);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	ib.instanceCnt = instanceCnt;
+}
+
+// Add the instance matrix attribute (one column per location, advancing once per instance) to the mesh's VAO
+void attachInstanceBuffer(MeshGL &mgl, InstanceBufferGL &ib) {
+	glBindVertexArray(mgl.VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, ib.buffer);
+	for(int col = 0; col < 4; col++) {
+		GLuint loc = INSTANCE_MODEL_MAT_LOCATION + col;
+		glEnableVertexAttribArray(loc);
+		glVertexAttribPointer(loc, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), 
+								(void*)(sizeof(glm::vec4)*col));
+		glVertexAttribDivisor(loc, 1);
+	}
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Draw every instance with one call; matrices come in through the attribute (see attachInstanceBuffer())
+void drawMeshInstanced(MeshGL &mgl, InstanceBufferGL &ib) {
+	if(ib.instanceCnt <= 0) return;
+	glBindVertexArray(mgl.VAO);
+	glDrawElementsInstanced(GL_TRIANGLES, mgl.indexCnt, GL_UNSIGNED_INT, (void*)0, ib.instanceCnt);
+	glBindVertexArray(0);
+}
+
+// Same, but the shader reads the matrices from an SSBO (no VAO changes needed)
+void drawMeshInstancedSSBO(MeshGL &mgl, InstanceBufferGL &ib, GLuint binding) {
+	if(ib.instanceCnt <= 0) return;
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, ib.buffer);
+	glBindVertexArray(mgl.VAO);
+	glDrawElementsInstanced(GL_TRIANGLES, mgl.indexCnt, GL_UNSIGNED_INT, (void*)0, ib.instanceCnt);
+	glBindVertexArray(0);
+}
+
+void cleanupInstanceBufferGL(InstanceBufferGL &ib) {
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glDeleteBuffers(1, &(ib.buffer));
+	ib.buffer = 0;
+	ib.capacity = 0;
+	ib.instanceCnt = 0;
 }
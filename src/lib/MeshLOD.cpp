@@ -0,0 +1,313 @@
+#include <cmath>
+#include <numeric>
+#include <unordered_map>
+#include "MeshLOD.hpp"
+
+// Boundary planes are weighted heavily so open edges don't shrink away
+#define MESH_LOD_BOUNDARY_WEIGHT 10.0
+
+// Symmetric 4x4 error quadric (Garland & Heckbert); upper triangle only
+struct Quadric {
+	double a[10] = {};
+};
+
+// Add squared distance to plane (n, d) with a given weight
+static void addPlane(Quadric &q, const glm::vec3 &n, float d, double w) {
+	double p[4] = { n.x, n.y, n.z, d };
+	int k = 0;
+	for(int i = 0; i < 4; i++) {
+		for(int j = i; j < 4; j++) {
+			q.a[k++] += w*p[i]*p[j];
+		}
+	}
+}
+
+static void addQuadric(Quadric &q, const Quadric &other) {
+	for(int i = 0; i < 10; i++) q.a[i] += other.a[i];
+}
+
+// v^T Q v for v = (p, 1)
+static double evalQuadric(const Quadric &q, const glm::vec3 &p) {
+	double v[4] = { p.x, p.y, p.z, 1.0 };
+	double result = 0.0;
+	int k = 0;
+	for(int i = 0; i < 4; i++) {
+		for(int j = i; j < 4; j++) {
+			result += (i == j ? 1.0 : 2.0)*q.a[k++]*v[i]*v[j];
+		}
+	}
+	return max(result, 0.0);
+}
+
+static uint64_t getEdgeKey(unsigned int a, unsigned int b) {
+	if(a > b) swap(a, b);
+	return ((uint64_t)a << 32) | b;
+}
+
+static void countEdges(const vector<unsigned int> &indices, unordered_map<uint64_t, int> &edgeUse) {
+	edgeUse.clear();
+	edgeUse.reserve(indices.size());
+	for(size_t t = 0; t < indices.size(); t += 3) {
+		for(int e = 0; e < 3; e++) {
+			edgeUse[getEdgeKey(indices[t + e], indices[t + (e + 1)%3])]++;
+		}
+	}
+}
+
+// Vertices sharing a position with another vertex sit on a normal/UV seam; moving them would tear the seam open
+static void findSeamVertices(const vector<Vertex> &vertices, vector<unsigned char> &locked) {
+	vector<unsigned int> order(vertices.size());
+	iota(order.begin(), order.end(), 0);
+	auto less = [&](unsigned int a, unsigned int b) {
+		const glm::vec3 &pa = vertices[a].position;
+		const glm::vec3 &pb = vertices[b].position;
+		if(pa.x != pb.x) return pa.x < pb.x;
+		if(pa.y != pb.y) return pa.y < pb.y;
+		return pa.z < pb.z;
+	};
+	sort(order.begin(), order.end(), less);
+
+	locked.assign(vertices.size(), 0);
+	for(size_t i = 1; i < order.size(); i++) {
+		if(vertices[order[i]].position == vertices[order[i - 1]].position) {
+			locked[order[i]] = 1;
+			locked[order[i - 1]] = 1;
+		}
+	}
+}
+
+// Collapsing from -> to must not turn any remaining triangle around "from" upside down
+static bool collapseFlipsTriangle(const vector<Vertex> &vertices, const vector<unsigned int> &indices,
+									const vector<unsigned int> &triStart, const vector<unsigned int> &triList,
+									unsigned int from, unsigned int to) {
+	const glm::vec3 &newPos = vertices[to].position;
+	for(unsigned int i = triStart[from]; i < triStart[from + 1]; i++) {
+		const unsigned int *tri = &indices[triList[i]*3];
+		if(tri[0] == to || tri[1] == to || tri[2] == to) continue;		// Disappears
+
+		glm::vec3 p[3];
+		glm::vec3 q[3];
+		for(int k = 0; k < 3; k++) {
+			p[k] = vertices[tri[k]].position;
+			q[k] = (tri[k] == from) ? newPos : p[k];
+		}
+		glm::vec3 oldN = glm::cross(p[1] - p[0], p[2] - p[0]);
+		glm::vec3 newN = glm::cross(q[1] - q[0], q[2] - q[0]);
+		if(glm::dot(oldN, newN) <= 0.0f) return true;
+	}
+	return false;
+}
+
+struct CollapseCandidate {
+	unsigned int from;
+	unsigned int to;
+	double cost;
+};
+
+// Simplify an index list down to (about) targetIndexCnt indices by collapsing vertices onto
+// their neighbors; no new vertices are created, so the result can share the original vertex buffer.
+// Returns the largest error introduced (object space distance).
+float simplifyMeshIndices(const Mesh &m, const unsigned int *indices, size_t indexCnt,
+							size_t targetIndexCnt, vector<unsigned int> &result) {
+	const vector<Vertex> &vertices = m.vertices;
+	size_t vertCnt = vertices.size();
+	result.assign(indices, indices + indexCnt);
+	if(indexCnt <= targetIndexCnt || vertCnt == 0) return 0.0f;
+
+	vector<unsigned char> locked;
+	findSeamVertices(vertices, locked);
+
+	unordered_map<uint64_t, int> edgeUse;
+	countEdges(result, edgeUse);
+
+	// Face planes, plus perpendicular planes along open boundaries
+	vector<Quadric> quadrics(vertCnt);
+	for(size_t t = 0; t < result.size(); t += 3) {
+		const unsigned int *tri = &result[t];
+		glm::vec3 p0 = vertices[tri[0]].position;
+		glm::vec3 n = glm::cross(vertices[tri[1]].position - p0, vertices[tri[2]].position - p0);
+		float len = glm::length(n);
+		if(len == 0.0f) continue;
+		n /= len;
+		for(int k = 0; k < 3; k++) {
+			addPlane(quadrics[tri[k]], n, -glm::dot(n, p0), 1.0);
+		}
+
+		for(int e = 0; e < 3; e++) {
+			unsigned int a = tri[e];
+			unsigned int b = tri[(e + 1)%3];
+			if(edgeUse[getEdgeKey(a, b)] != 1) continue;
+			glm::vec3 edge = vertices[b].position - vertices[a].position;
+			glm::vec3 bn = glm::cross(edge, n);
+			float bnLen = glm::length(bn);
+			if(bnLen == 0.0f) continue;
+			bn /= bnLen;
+			float d = -glm::dot(bn, vertices[a].position);
+			addPlane(quadrics[a], bn, d, MESH_LOD_BOUNDARY_WEIGHT);
+			addPlane(quadrics[b], bn, d, MESH_LOD_BOUNDARY_WEIGHT);
+		}
+	}
+
+	size_t targetTriCnt = targetIndexCnt/3;
+	double maxCost = 0.0;
+	vector<unsigned char> boundary(vertCnt);
+	vector<unsigned char> touched(vertCnt);
+	vector<unsigned int> remap(vertCnt);
+	vector<unsigned int> triStart(vertCnt + 1);
+	vector<unsigned int> triList;
+	vector<CollapseCandidate> candidates;
+
+	// Each pass collapses the cheapest edges whose neighborhoods don't overlap, then rebuilds
+	while(result.size()/3 > targetTriCnt) {
+		size_t triCnt = result.size()/3;
+
+		countEdges(result, edgeUse);
+		fill(boundary.begin(), boundary.end(), 0);
+		for(auto &e : edgeUse) {
+			if(e.second != 1) continue;
+			boundary[(unsigned int)(e.first >> 32)] = 1;
+			boundary[(unsigned int)(e.first & 0xFFFFFFFF)] = 1;
+		}
+
+		// Vertex -> triangle adjacency
+		fill(triStart.begin(), triStart.end(), 0);
+		for(unsigned int v : result) triStart[v + 1]++;
+		for(size_t v = 0; v < vertCnt; v++) triStart[v + 1] += triStart[v];
+		triList.resize(result.size());
+		vector<unsigned int> fillPos(triStart.begin(), triStart.end() - 1);
+		for(size_t i = 0; i < result.size(); i++) {
+			triList[fillPos[result[i]]++] = (unsigned int)(i/3);
+		}
+
+		// Interior edges show up in two triangles (a->b and b->a), so only take them once;
+		// boundary vertices may only slide along the boundary
+		candidates.clear();
+		for(size_t t = 0; t < result.size(); t += 3) {
+			for(int e = 0; e < 3; e++) {
+				unsigned int a = result[t + e];
+				unsigned int b = result[t + (e + 1)%3];
+				bool boundaryEdge = (edgeUse[getEdgeKey(a, b)] == 1);
+				if(a > b && !boundaryEdge) continue;
+
+				unsigned int ends[2] = { a, b };
+				for(int k = 0; k < 2; k++) {
+					unsigned int from = ends[k];
+					unsigned int to = ends[1 - k];
+					if(locked[from]) continue;
+					if(boundary[from] && !boundaryEdge) continue;
+
+					Quadric q = quadrics[from];
+					addQuadric(q, quadrics[to]);
+					candidates.push_back({ from, to, evalQuadric(q, vertices[to].position) });
+				}
+			}
+		}
+		if(candidates.empty()) break;
+
+		sort(candidates.begin(), candidates.end(),
+				[](const CollapseCandidate &a, const CollapseCandidate &b) { return a.cost < b.cost; });
+
+		fill(touched.begin(), touched.end(), 0);
+		iota(remap.begin(), remap.end(), 0);
+		size_t removeGoal = triCnt - targetTriCnt;
+		size_t removedCnt = 0;
+		int collapseCnt = 0;
+		for(CollapseCandidate &c : candidates) {
+			if(removedCnt >= removeGoal) break;
+			if(touched[c.from] || touched[c.to]) continue;
+			if(collapseFlipsTriangle(vertices, result, triStart, triList, c.from, c.to)) continue;
+
+			// Freeze both one-rings for the rest of this pass (their adjacency is now stale)
+			unsigned int ends[2] = { c.from, c.to };
+			for(unsigned int v : ends) {
+				for(unsigned int i = triStart[v]; i < triStart[v + 1]; i++) {
+					const unsigned int *tri = &result[triList[i]*3];
+					touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+					if(v == c.from && (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to)) removedCnt++;
+				}
+			}
+
+			remap[c.from] = c.to;
+			addQuadric(quadrics[c.to], quadrics[c.from]);
+			maxCost = max(maxCost, c.cost);
+			collapseCnt++;
+		}
+		if(collapseCnt == 0) break;
+
+		// Apply collapses and drop degenerate triangles
+		size_t outCnt = 0;
+		for(size_t t = 0; t < result.size(); t += 3) {
+			unsigned int a = remap[result[t]];
+			unsigned int b = remap[result[t + 1]];
+			unsigned int c = remap[result[t + 2]];
+			if(a == b || b == c || a == c) continue;
+			result[outCnt++] = a;
+			result[outCnt++] = b;
+			result[outCnt++] = c;
+		}
+		result.resize(outCnt);
+	}
+
+	return (float)sqrt(maxCost);
+}
+
+// Build a chain of coarser index lists for one mesh (vertices are shared by all levels)
+void generateMeshLODs(Mesh &m, int maxLODCnt, float reduction) {
+	m.lodIndices.clear();
+	m.lods.clear();
+
+	vector<unsigned int> src = m.indices;
+	vector<unsigned int> dst;
+	float error = 0.0f;
+	for(int i = 0; i < maxLODCnt; i++) {
+		size_t targetIndexCnt = (size_t)((src.size()/3)*reduction)*3;
+		if(targetIndexCnt < MESH_LOD_MIN_TRIANGLES*3) break;
+
+		// Each level starts from the previous one, so errors add up
+		error += simplifyMeshIndices(m, src.data(), src.size(), targetIndexCnt, dst);
+
+		// Not worth a level if it barely got smaller (e.g., everything is on a seam)
+		if(dst.empty() || dst.size() > src.size()*9/10) break;
+
+		MeshLOD lod;
+		lod.firstIndex = (unsigned int)m.lodIndices.size();
+		lod.indexCnt = (unsigned int)dst.size();
+		lod.error = error;
+		m.lods.push_back(lod);
+		m.lodIndices.insert(m.lodIndices.end(), dst.begin(), dst.end());
+		src.swap(dst);
+	}
+}
+
+// Generate LODs for every mesh, spread across the thread pool
+void generateAllMeshLODs(vector<Mesh> &allMeshes, ThreadPool &pool, int maxLODCnt, float reduction) {
+	parallelFor(pool, (int)allMeshes.size(), [&](int i) {
+		generateMeshLODs(allMeshes[i], maxLODCnt, reduction);
+	});
+}
+
+// Largest axis scale of a transform (for scaling object space errors and radii)
+float getMatrixMaxScale(const glm::mat4 &m) {
+	float s2 = max(glm::dot(glm::vec3(m[0]), glm::vec3(m[0])),
+				max(glm::dot(glm::vec3(m[1]), glm::vec3(m[1])), glm::dot(glm::vec3(m[2]), glm::vec3(m[2]))));
+	return sqrt(s2);
+}
+
+// Size in pixels of a view space error at a given distance from the camera
+float getScreenSpaceError(float error, float distance, const glm::mat4 &projMat, float viewportHeight) {
+	// projMat[1][1] is cot(fovY/2) for perspective, 2/height for orthographic projections
+	float pixelsPerUnit = projMat[1][1]*0.5f*viewportHeight;
+	if(projMat[2][3] == 0.0f) return error*pixelsPerUnit;
+	return error*pixelsPerUnit/max(distance, 1e-4f);
+}
+
+// Coarsest level whose projected error stays under maxPixelError (0 = full mesh, i = lods[i-1])
+int selectMeshLOD(const vector<MeshLOD> &lods, float scale, float distance,
+					const glm::mat4 &projMat, float viewportHeight, float maxPixelError) {
+	int lod = 0;
+	for(int i = 0; i < (int)lods.size(); i++) {
+		if(getScreenSpaceError(lods[i].error*scale, distance, projMat, viewportHeight) > maxPixelError) break;
+		lod = i + 1;
+	}
+	return lod;
+}
@@ -0,0 +1,116 @@
+#include "SceneGraph.hpp"
+#include "Utility.hpp"
+
+// Flatten Assimp node tree into contiguous arrays (done once at load time)
+void flattenSceneGraph(aiNode *root, SceneGraph &sg) {
+	cleanupSceneGraph(sg);
+	if(!root) return;
+
+	// Iterative depth-first traversal; children are pushed in reverse
+	// so they come out in their original order.
+	vector<pair<aiNode*, int>> stack;
+	stack.push_back({ root, -1 });
+
+	while(!stack.empty()) {
+		aiNode *node = stack.back().first;
+		int parent = stack.back().second;
+		stack.pop_back();
+
+		int index = (int)sg.parents.size();
+		sg.parents.push_back(parent);
+
+		glm::mat4 localMat;
+		aiMatToGLM4(node->mTransformation, localMat);
+		sg.localMats.push_back(localMat);
+
+		sg.meshStarts.push_back((unsigned int)sg.meshIndices.size());
+		sg.meshCounts.push_back(node->mNumMeshes);
+		for(unsigned int i = 0; i < node->mNumMeshes; i++) {
+			sg.meshIndices.push_back(node->mMeshes[i]);
+		}
+
+		for(int i = (int)node->mNumChildren - 1; i >= 0; i--) {
+			stack.push_back({ node->mChildren[i], index });
+		}
+	}
+
+	finalizeSceneGraph(sg);
+}
+
+// Compute subtree ranges and all matrices once parents, local matrices and mesh lists are filled in
+void finalizeSceneGraph(SceneGraph &sg) {
+	int nodeCnt = (int)sg.parents.size();
+	sg.subtreeEnd.resize(nodeCnt);
+	for(int i = 0; i < nodeCnt; i++) {
+		sg.subtreeEnd[i] = i + 1;
+	}
+
+	// Children always have larger indices than their parent,
+	// so subtree ends can be accumulated in one backwards pass.
+	for(int i = nodeCnt - 1; i > 0; i--) {
+		int p = sg.parents[i];
+		sg.subtreeEnd[p] = max(sg.subtreeEnd[p], sg.subtreeEnd[i]);
+	}
+
+	// Everything needs computing the first time around
+	sg.worldMats.resize(nodeCnt);
+	sg.normalMats.resize(nodeCnt);
+	sg.dirty.assign(nodeCnt, 1);
+	sg.anyDirty = true;
+	updateSceneGraph(sg);
+}
+
+// Change a node's local transform; the node and its subtree are recomputed on next update
+void setLocalTransform(SceneGraph &sg, int nodeIndex, const glm::mat4 &localMat) {
+	sg.localMats.at(nodeIndex) = localMat;
+	sg.dirty.at(nodeIndex) = 1;
+	sg.anyDirty = true;
+}
+
+// Recompute world and normal matrices of dirty nodes in a single linear pass
+void updateSceneGraph(SceneGraph &sg) {
+	if(!sg.anyDirty) return;
+
+	int nodeCnt = (int)sg.parents.size();
+	int i = 0;
+	while(i < nodeCnt) {
+		if(!sg.dirty[i]) {
+			i++;
+			continue;
+		}
+
+		// Whole subtree of a dirty node is stale; parents are always up to date here
+		int end = sg.subtreeEnd[i];
+		for(int j = i; j < end; j++) {
+			int p = sg.parents[j];
+			if(p >= 0)
+				sg.worldMats[j] = sg.worldMats[p] * sg.localMats[j];
+			else
+				sg.worldMats[j] = sg.localMats[j];
+			sg.normalMats[j] = glm::transpose(glm::inverse(glm::mat3(sg.worldMats[j])));
+			sg.dirty[j] = 0;
+		}
+		i = end;
+	}
+
+	sg.anyDirty = false;
+}
+
+// Get number of nodes
+int getNodeCount(SceneGraph &sg) {
+	return (int)sg.parents.size();
+}
+
+// Cleanup scene graph
+void cleanupSceneGraph(SceneGraph &sg) {
+	sg.parents.clear();
+	sg.subtreeEnd.clear();
+	sg.localMats.clear();
+	sg.worldMats.clear();
+	sg.normalMats.clear();
+	sg.meshStarts.clear();
+	sg.meshCounts.clear();
+	sg.meshIndices.clear();
+	sg.dirty.clear();
+	sg.anyDirty = false;
+}
@@ -1,3 +1,5 @@
+#include <cstring>
+#include <cstdio>
 #include "Shader.hpp"
 
 // Read from file and dump in string
@@ -103,6 +105,9 @@ GLuint createAndLinkShaderProgram(std::vector<GLuint> allShaderIDs) {
 	// Create program ID and attach shaders
 	cout << "Linking program..." << endl;
 	GLuint programID = glCreateProgram();
+
+	// Lets the shader cache read the linked binary back (harmless otherwise)
+	glProgramParameteri(programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	for (GLuint &shaderID : allShaderIDs) {
 		glAttachShader(programID, shaderID);
 	}
@@ -163,3 +168,347 @@ GLuint initShaderProgramFromSource(string vertexShaderCode, string fragmentShade
 
 	return programID;
 }
+
+// Same as above, but for a single compute shader
+GLuint initComputeProgramFromSource(string computeShaderCode) {
+	GLuint compID = 0;
+	GLuint programID = 0;
+
+	try {
+		// Create and compile shader
+		cout << "Compute shader: ";
+		compID = createAndCompileShader(computeShaderCode.c_str(), GL_COMPUTE_SHADER);
+
+		// Create and link program
+		programID = createAndLinkShaderProgram({ compID });
+
+		// Delete individual shader
+		glDeleteShader(compID);
+
+		// Success!
+		cout << "Compute program successfully compiled and linked!" << endl;
+	}
+	catch (exception e) {
+		// Cleanup shader, just in case
+		if (compID) glDeleteShader(compID);
+		// Rethrow exception
+		throw e;
+	}
+
+	return programID;
+}
+
+// Insert extra lines (e.g., "#define SOMETHING\n") right after the #version line
+string insertShaderDefines(string shaderCode, string defines) {
+	if(defines.empty()) return shaderCode;
+
+	size_t versionPos = shaderCode.find("#version");
+	if(versionPos == string::npos) return defines + shaderCode;
+
+	size_t lineEnd = shaderCode.find('\n', versionPos);
+	if(lineEnd == string::npos) return shaderCode + "\n" + defines;
+
+	return shaderCode.substr(0, lineEnd + 1) + defines + shaderCode.substr(lineEnd + 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Shader program cache
+////////////////////////////////////////////////////////////////////////////////
+
+static const char SHADER_BINARY_MAGIC[4] = { 'G', 'L', 'P', 'B' };
+
+// On-disk binary header (followed by the driver's program binary)
+struct ShaderBinaryHeader {
+	char magic[4];
+	uint32_t format;
+	uint64_t key;			// Source key (see buildShaderProgram()); a mismatch means the binary is stale
+	uint64_t size;
+};
+
+// 64-bit FNV-1a, continued from a previous hash
+static uint64_t hashString(const string &s, uint64_t hash = 14695981039346656037ULL) {
+	for(unsigned char c : s) {
+		hash ^= c;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+// Guess shader stage from the extension (.vs/.vert, .fs/.frag, .gs/.geom, .comp/.cs)
+GLenum getShaderStageFromFilename(string filename) {
+	string ext = filesystem::path(filename).extension().string();
+	if(ext == ".vs" || ext == ".vert") return GL_VERTEX_SHADER;
+	if(ext == ".fs" || ext == ".frag") return GL_FRAGMENT_SHADER;
+	if(ext == ".gs" || ext == ".geom") return GL_GEOMETRY_SHADER;
+	if(ext == ".comp" || ext == ".cs") return GL_COMPUTE_SHADER;
+	throw runtime_error("Unknown shader stage: " + filename);
+}
+
+static filesystem::file_time_type getFileTime(const string &filename) {
+	error_code ec;
+	filesystem::file_time_type t = filesystem::last_write_time(filename, ec);
+	return ec ? filesystem::file_time_type() : t;
+}
+
+// One file per program (files + stages + defines + driver), not per source version,
+// so edits during hot reload overwrite the program's binary instead of piling up new ones
+static string getShaderBinaryFilename(ShaderCache &cache, uint64_t programKey) {
+	ostringstream name;
+	name << cache.cacheDir << "/" << hex << programKey << ".glbin";
+	return name.str();
+}
+
+// Load a cached binary (0 if missing, stale or rejected by the driver, e.g., after a driver update)
+static GLuint loadShaderBinary(ShaderCache &cache, uint64_t programKey, uint64_t key) {
+	if(!cache.binarySupported) return 0;
+
+	ifstream file(getShaderBinaryFilename(cache, programKey), ios::binary);
+	if(!file) return 0;
+
+	ShaderBinaryHeader header;
+	file.read((char*)&header, sizeof(header));
+	if(!file || memcmp(header.magic, SHADER_BINARY_MAGIC, 4) != 0 || header.key != key || header.size == 0) {
+		return 0;
+	}
+
+	vector<char> data((size_t)header.size);
+	file.read(data.data(), data.size());
+	if(!file) return 0;
+
+	GLuint programID = glCreateProgram();
+	glProgramBinary(programID, (GLenum)header.format, data.data(), (GLsizei)data.size());
+	GLint linkOK = GL_FALSE;
+	glGetProgramiv(programID, GL_LINK_STATUS, &linkOK);
+	if(!linkOK) {
+		glDeleteProgram(programID);
+		return 0;
+	}
+	return programID;
+}
+
+// Store linked binary (temp file + rename, so a crash never leaves a truncated binary)
+static void saveShaderBinary(ShaderCache &cache, uint64_t programKey, uint64_t key, GLuint programID) {
+	if(!cache.binarySupported) return;
+
+	GLint length = 0;
+	glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH, &length);
+	if(length <= 0) return;
+
+	vector<char> data(length);
+	GLenum format = 0;
+	glGetProgramBinary(programID, length, NULL, &format, data.data());
+
+	ShaderBinaryHeader header;
+	memcpy(header.magic, SHADER_BINARY_MAGIC, 4);
+	header.format = format;
+	header.key = key;
+	header.size = (uint64_t)length;
+
+	error_code ec;
+	filesystem::create_directories(cache.cacheDir, ec);
+
+	string filename = getShaderBinaryFilename(cache, programKey);
+	string tempFilename = filename + ".tmp";
+	ofstream file(tempFilename, ios::binary | ios::trunc);
+	if(!file) return;
+	file.write((const char*)&header, sizeof(header));
+	file.write(data.data(), data.size());
+	bool ok = file.good();
+	file.close();
+
+	if(!ok) {
+		remove(tempFilename.c_str());
+		return;
+	}
+	// Replaces the old binary atomically on POSIX; Windows' rename() won't overwrite, so delete first there
+#ifdef _WIN32
+	remove(filename.c_str());
+#endif
+	if(rename(tempFilename.c_str(), filename.c_str()) != 0) {
+		remove(tempFilename.c_str());
+	}
+}
+
+// Build program from sources (binary cache first); throws on compile/link errors
+static GLuint buildShaderProgram(ShaderCache &cache, ShaderProgram &prog) {
+	// programKey names the file; key also covers the sources and says whether it's current
+	vector<string> sources;
+	uint64_t programKey = hashString(cache.driverString);
+	programKey = hashString(prog.defines, programKey);
+	for(size_t i = 0; i < prog.filenames.size(); i++) {
+		programKey = hashString(to_string(prog.stages[i]), programKey);
+		programKey = hashString(prog.filenames[i], programKey);
+	}
+	uint64_t key = programKey;
+	for(size_t i = 0; i < prog.filenames.size(); i++) {
+		sources.push_back(insertShaderDefines(readFileToString(prog.filenames[i]), prog.defines));
+		key = hashString(sources.back(), key);
+	}
+
+	GLuint programID = loadShaderBinary(cache, programKey, key);
+	if(programID) {
+		cache.binaryHitCnt++;
+		return programID;
+	}
+	cache.binaryMissCnt++;
+
+	vector<GLuint> shaderIDs;
+	try {
+		for(size_t i = 0; i < sources.size(); i++) {
+			cout << prog.filenames[i] << ": ";
+			shaderIDs.push_back(createAndCompileShader(sources[i].c_str(), prog.stages[i]));
+		}
+		programID = createAndLinkShaderProgram(shaderIDs);
+	}
+	catch (exception &e) {
+		for(GLuint id : shaderIDs) glDeleteShader(id);
+		throw;
+	}
+	for(GLuint id : shaderIDs) glDeleteShader(id);
+
+	saveShaderBinary(cache, programKey, key, programID);
+	return programID;
+}
+
+// Resolve every active uniform and uniform block once, so lookups never hit the driver
+static void reflectShaderProgram(ShaderProgram &prog) {
+	prog.uniforms.clear();
+	prog.uniformBlocks.clear();
+
+	GLint uniformCnt = 0;
+	GLint maxNameLength = 0;
+	glGetProgramiv(prog.programID, GL_ACTIVE_UNIFORMS, &uniformCnt);
+	glGetProgramiv(prog.programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+	vector<char> name(max(maxNameLength, 1));
+	for(GLint i = 0; i < uniformCnt; i++) {
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(prog.programID, (GLuint)i, (GLsizei)name.size(), NULL, &size, &type, name.data());
+		string uniformName = name.data();
+		GLint location = glGetUniformLocation(prog.programID, uniformName.c_str());
+		if(location < 0) continue;		// Lives in a uniform block
+
+		prog.uniforms[uniformName] = location;
+		size_t bracket = uniformName.rfind("[0]");
+		if(bracket != string::npos && bracket + 3 == uniformName.size()) {
+			prog.uniforms[uniformName.substr(0, bracket)] = location;
+		}
+	}
+
+	GLint blockCnt = 0;
+	glGetProgramiv(prog.programID, GL_ACTIVE_UNIFORM_BLOCKS, &blockCnt);
+	glGetProgramiv(prog.programID, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxNameLength);
+	name.resize(max(maxNameLength, 1));
+	for(GLint i = 0; i < blockCnt; i++) {
+		glGetActiveUniformBlockName(prog.programID, (GLuint)i, (GLsizei)name.size(), NULL, name.data());
+		prog.uniformBlocks[name.data()] = (GLuint)i;
+	}
+}
+
+// Set up cache (needs a current GL context)
+void createShaderCache(ShaderCache &cache, string cacheDir) {
+	cache.cacheDir = cacheDir;
+	cache.programs.clear();
+	cache.binaryHitCnt = 0;
+	cache.binaryMissCnt = 0;
+	cache.lastCheck = chrono::steady_clock::now();
+
+	GLint formatCnt = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCnt);
+	cache.binarySupported = (formatCnt > 0);
+
+	cache.driverString = string((const char*)glGetString(GL_VENDOR)) + "|"
+						+ string((const char*)glGetString(GL_RENDERER)) + "|"
+						+ string((const char*)glGetString(GL_VERSION));
+
+	cout << "Shader cache: " << cacheDir;
+	cout << (cache.binarySupported ? "" : " (no program binary formats; source only)") << endl;
+}
+
+// Load program from shader files (stage taken from extension); returns a handle for the other calls.
+// Throws if the program can't be built the first time.
+int loadShaderProgram(ShaderCache &cache, vector<string> filenames, string defines, bool watch) {
+	ShaderProgram prog;
+	prog.filenames = filenames;
+	prog.defines = defines;
+	prog.watch = watch;
+	for(string &filename : filenames) {
+		prog.stages.push_back(getShaderStageFromFilename(filename));
+		prog.fileTimes.push_back(getFileTime(filename));
+	}
+
+	prog.programID = buildShaderProgram(cache, prog);
+	reflectShaderProgram(prog);
+
+	cache.programs.push_back(prog);
+	return (int)cache.programs.size() - 1;
+}
+
+GLuint getShaderProgramID(ShaderCache &cache, int handle) {
+	return cache.programs.at(handle).programID;
+}
+
+// Changes whenever the program was rebuilt (anything caching locations should refresh)
+int getShaderProgramVersion(ShaderCache &cache, int handle) {
+	return cache.programs.at(handle).version;
+}
+
+// Uniform location from the reflection table (-1 if not active)
+GLint getShaderUniform(ShaderCache &cache, int handle, string name) {
+	ShaderProgram &prog = cache.programs.at(handle);
+	auto it = prog.uniforms.find(name);
+	return (it == prog.uniforms.end()) ? -1 : it->second;
+}
+
+// Uniform block index from the reflection table (GL_INVALID_INDEX if not active)
+GLuint getShaderUniformBlock(ShaderCache &cache, int handle, string name) {
+	ShaderProgram &prog = cache.programs.at(handle);
+	auto it = prog.uniformBlocks.find(name);
+	return (it == prog.uniformBlocks.end()) ? GL_INVALID_INDEX : it->second;
+}
+
+// Rebuild watched programs whose files changed (checked at most every SHADER_RELOAD_INTERVAL).
+// A program that fails to build keeps its old version. Returns true if anything was replaced.
+bool reloadChangedShaders(ShaderCache &cache) {
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	if(chrono::duration<double>(now - cache.lastCheck).count() < SHADER_RELOAD_INTERVAL) return false;
+	cache.lastCheck = now;
+
+	bool anyReloaded = false;
+	for(ShaderProgram &prog : cache.programs) {
+		if(!prog.watch) continue;
+
+		bool changed = false;
+		for(size_t i = 0; i < prog.filenames.size(); i++) {
+			filesystem::file_time_type t = getFileTime(prog.filenames[i]);
+			if(t != prog.fileTimes[i]) {
+				prog.fileTimes[i] = t;
+				changed = true;
+			}
+		}
+		if(!changed) continue;
+
+		try {
+			GLuint programID = buildShaderProgram(cache, prog);
+			glDeleteProgram(prog.programID);
+			prog.programID = programID;
+			prog.version++;
+			reflectShaderProgram(prog);
+			anyReloaded = true;
+			cout << "Reloaded shader program: " << prog.filenames.front() << endl;
+		}
+		catch (exception &e) {
+			cerr << "ERROR: Reload failed, keeping previous program: " << prog.filenames.front() << endl;
+		}
+	}
+	return anyReloaded;
+}
+
+// Delete all programs
+void cleanupShaderCache(ShaderCache &cache) {
+	glUseProgram(0);
+	for(ShaderProgram &prog : cache.programs) {
+		glDeleteProgram(prog.programID);
+	}
+	cache.programs.clear();
+}
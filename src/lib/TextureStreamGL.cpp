@@ -0,0 +1,517 @@
+#include <cstring>
+#include <climits>
+#include "TextureStreamGL.hpp"
+
+// Keep stb_image private to this file (the apps have their own copies)
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// CPU side: mip generation and block compression (run on the worker threads)
+///////////////////////////////////////////////////////////////////////////////
+
+// 2x2 box filter down to 1x1 (odd edges reuse the last row/column)
+void generateMipChain(const unsigned char *rgba, int width, int height, vector<TextureMipData> &mips) {
+	mips.clear();
+	mips.push_back(TextureMipData());
+	mips.back().width = width;
+	mips.back().height = height;
+	mips.back().data.assign(rgba, rgba + (size_t)width*height*4);
+
+	while(mips.back().width > 1 || mips.back().height > 1) {
+		const TextureMipData &src = mips.back();
+		TextureMipData dst;
+		dst.width = max(1, src.width/2);
+		dst.height = max(1, src.height/2);
+		dst.data.resize((size_t)dst.width*dst.height*4);
+
+		for(int y = 0; y < dst.height; y++) {
+			int y0 = min(y*2, src.height - 1);
+			int y1 = min(y*2 + 1, src.height - 1);
+			for(int x = 0; x < dst.width; x++) {
+				int x0 = min(x*2, src.width - 1);
+				int x1 = min(x*2 + 1, src.width - 1);
+				const unsigned char *p00 = &(src.data[((size_t)y0*src.width + x0)*4]);
+				const unsigned char *p01 = &(src.data[((size_t)y0*src.width + x1)*4]);
+				const unsigned char *p10 = &(src.data[((size_t)y1*src.width + x0)*4]);
+				const unsigned char *p11 = &(src.data[((size_t)y1*src.width + x1)*4]);
+				unsigned char *d = &(dst.data[((size_t)y*dst.width + x)*4]);
+				for(int c = 0; c < 4; c++) {
+					d[c] = (unsigned char)((p00[c] + p01[c] + p10[c] + p11[c] + 2)/4);
+				}
+			}
+		}
+		mips.push_back(std::move(dst));
+	}
+}
+
+// Gather a 4x4 block, clamping at the right/top edges of small or odd levels
+static void fetchBlock(const TextureMipData &src, int bx, int by, unsigned char block[16][4]) {
+	for(int y = 0; y < 4; y++) {
+		int sy = min(by*4 + y, src.height - 1);
+		for(int x = 0; x < 4; x++) {
+			int sx = min(bx*4 + x, src.width - 1);
+			memcpy(block[y*4 + x], &(src.data[((size_t)sy*src.width + sx)*4]), 4);
+		}
+	}
+}
+
+static unsigned short packColor565(const int c[3]) {
+	int r = (c[0]*31 + 127)/255;
+	int g = (c[1]*63 + 127)/255;
+	int b = (c[2]*31 + 127)/255;
+	return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+static void unpackColor565(unsigned short v, int c[3]) {
+	int r = (v >> 11) & 31;
+	int g = (v >> 5) & 63;
+	int b = v & 31;
+	c[0] = (r << 3) | (r >> 2);
+	c[1] = (g << 2) | (g >> 4);
+	c[2] = (b << 3) | (b >> 2);
+}
+
+// BC1 color block: bounding-box endpoints (inset a little), always in 4-color mode
+static void encodeBlockBC1(unsigned char block[16][4], unsigned char *out) {
+	int minC[3] = {255, 255, 255};
+	int maxC[3] = {0, 0, 0};
+	for(int i = 0; i < 16; i++) {
+		for(int c = 0; c < 3; c++) {
+			minC[c] = min(minC[c], (int)block[i][c]);
+			maxC[c] = max(maxC[c], (int)block[i][c]);
+		}
+	}
+	for(int c = 0; c < 3; c++) {
+		int inset = (maxC[c] - minC[c])/16;
+		minC[c] += inset;
+		maxC[c] -= inset;
+	}
+
+	unsigned short c0 = packColor565(maxC);
+	unsigned short c1 = packColor565(minC);
+	if(c0 < c1) swap(c0, c1);
+
+	unsigned int indices = 0;
+	if(c0 != c1) {
+		int palette[4][3];
+		unpackColor565(c0, palette[0]);
+		unpackColor565(c1, palette[1]);
+		for(int c = 0; c < 3; c++) {
+			palette[2][c] = (2*palette[0][c] + palette[1][c])/3;
+			palette[3][c] = (palette[0][c] + 2*palette[1][c])/3;
+		}
+
+		for(int i = 0; i < 16; i++) {
+			int best = 0;
+			int bestDist = INT_MAX;
+			for(int p = 0; p < 4; p++) {
+				int dist = 0;
+				for(int c = 0; c < 3; c++) {
+					int d = (int)block[i][c] - palette[p][c];
+					dist += d*d;
+				}
+				if(dist < bestDist) {
+					bestDist = dist;
+					best = p;
+				}
+			}
+			indices |= (unsigned int)best << (i*2);
+		}
+	}
+
+	out[0] = (unsigned char)(c0 & 0xFF);
+	out[1] = (unsigned char)(c0 >> 8);
+	out[2] = (unsigned char)(c1 & 0xFF);
+	out[3] = (unsigned char)(c1 >> 8);
+	for(int i = 0; i < 4; i++) {
+		out[4 + i] = (unsigned char)((indices >> (i*8)) & 0xFF);
+	}
+}
+
+// BC4 single-channel block (also the alpha half of BC3 and each half of BC5), 8-value mode
+static void encodeBlockBC4(unsigned char block[16][4], int channel, unsigned char *out) {
+	int a0 = 0;
+	int a1 = 255;
+	for(int i = 0; i < 16; i++) {
+		a0 = max(a0, (int)block[i][channel]);
+		a1 = min(a1, (int)block[i][channel]);
+	}
+
+	unsigned long long indices = 0;
+	if(a0 != a1) {
+		int range = a0 - a1;
+		for(int i = 0; i < 16; i++) {
+			// t = 0..7 from a1 to a0; palette order is a0, a1, then 6 steps from a0 toward a1
+			int t = ((block[i][channel] - a1)*7 + range/2)/range;
+			int index = (t == 7) ? 0 : ((t == 0) ? 1 : 8 - t);
+			indices |= (unsigned long long)index << (i*3);
+		}
+	}
+
+	out[0] = (unsigned char)a0;
+	out[1] = (unsigned char)a1;
+	for(int i = 0; i < 6; i++) {
+		out[2 + i] = (unsigned char)((indices >> (i*8)) & 0xFF);
+	}
+}
+
+static int getBlockBytes(TextureCompression compression) {
+	return (compression == TEXTURE_COMPRESSION_BC1) ? 8 : 16;
+}
+
+// dst keeps the texel size of src; its data is the blocks, row by row
+void compressTextureMip(const TextureMipData &src, TextureCompression compression, TextureMipData &dst) {
+	int blocksX = (src.width + 3)/4;
+	int blocksY = (src.height + 3)/4;
+	int blockBytes = getBlockBytes(compression);
+
+	dst.width = src.width;
+	dst.height = src.height;
+	dst.data.resize((size_t)blocksX*blocksY*blockBytes);
+
+	unsigned char block[16][4];
+	for(int by = 0; by < blocksY; by++) {
+		for(int bx = 0; bx < blocksX; bx++) {
+			fetchBlock(src, bx, by, block);
+			unsigned char *out = &(dst.data[((size_t)by*blocksX + bx)*blockBytes]);
+			if(compression == TEXTURE_COMPRESSION_BC1) {
+				encodeBlockBC1(block, out);
+			}
+			else if(compression == TEXTURE_COMPRESSION_BC3) {
+				encodeBlockBC4(block, 3, out);
+				encodeBlockBC1(block, out + 8);
+			}
+			else {
+				encodeBlockBC4(block, 0, out);
+				encodeBlockBC4(block, 1, out + 8);
+			}
+		}
+	}
+}
+
+// Decode to RGBA8, bottom row first (as GL expects); safe to call from any thread
+bool loadTextureRGBA(string filename, vector<unsigned char> &rgba, int &width, int &height) {
+	int components;
+	unsigned char *imageData = stbi_load(filename.c_str(), &width, &height, &components, 4);
+	if(!imageData) return false;
+
+	// Flip here instead of stbi_set_flip_vertically_on_load(), which is global state
+	size_t rowBytes = (size_t)width*4;
+	rgba.resize(rowBytes*height);
+	for(int y = 0; y < height; y++) {
+		memcpy(rgba.data() + rowBytes*y, imageData + rowBytes*(height - 1 - y), rowBytes);
+	}
+	stbi_image_free(imageData);
+	return true;
+}
+
+// Worker task: decode, build mips, compress
+static void decodeTextureTask(TextureStreamer *ts, int handle, string filename, TextureCompression compression) {
+	auto decoded = make_shared<DecodedTexture>();
+	decoded->handle = handle;
+	decoded->compression = compression;
+
+	vector<unsigned char> rgba;
+	int width, height;
+	if(loadTextureRGBA(filename, rgba, width, height)) {
+		generateMipChain(rgba.data(), width, height, decoded->mips);
+
+		if(compression != TEXTURE_COMPRESSION_NONE) {
+			for(int i = 0; i < (int)decoded->mips.size(); i++) {
+				TextureMipData blocks;
+				compressTextureMip(decoded->mips.at(i), compression, blocks);
+				decoded->mips.at(i) = std::move(blocks);
+			}
+		}
+		decoded->ok = true;
+	}
+	else {
+		cerr << "ERROR: Texture could not load: " << filename << endl;
+	}
+
+	lock_guard<mutex> guard(ts->lock);
+	ts->finished.push_back(decoded);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GL side (render thread only)
+///////////////////////////////////////////////////////////////////////////////
+
+static GLenum getCompressedFormat(TextureCompression compression) {
+	switch(compression) {
+		case TEXTURE_COMPRESSION_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		case TEXTURE_COMPRESSION_BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		case TEXTURE_COMPRESSION_BC5: return GL_COMPRESSED_RG_RGTC2;
+		default: return GL_RGBA8;
+	}
+}
+
+static string getCompressionName(TextureCompression compression) {
+	switch(compression) {
+		case TEXTURE_COMPRESSION_BC1: return "BC1";
+		case TEXTURE_COMPRESSION_BC3: return "BC3";
+		case TEXTURE_COMPRESSION_BC5: return "BC5";
+		default: return "RGBA8";
+	}
+}
+
+// Rows per upload step: pixel rows, or rows of 4x4 blocks when compressed
+static int getUploadRowCnt(const TextureMipData &mip, TextureCompression compression) {
+	return (compression == TEXTURE_COMPRESSION_NONE) ? mip.height : (mip.height + 3)/4;
+}
+
+static size_t getUploadRowBytes(const TextureMipData &mip, TextureCompression compression) {
+	if(compression == TEXTURE_COMPRESSION_NONE) return (size_t)mip.width*4;
+	return (size_t)((mip.width + 3)/4)*getBlockBytes(compression);
+}
+
+void createTextureStreamer(TextureStreamer &ts, size_t bytesPerFrame) {
+	// A row (or block row) must always fit, or a wide texture would never finish
+	ts.bytesPerFrame = max(bytesPerFrame, (size_t)(256*1024));
+	ts.s3tcSupported = (GLEW_EXT_texture_compression_s3tc != 0);
+
+	glGenBuffers(TEXTURE_STREAM_PBO_CNT, ts.pbos);
+	for(int i = 0; i < TEXTURE_STREAM_PBO_CNT; i++) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ts.pbos[i]);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, ts.bytesPerFrame, NULL, GL_STREAM_DRAW);
+		ts.fences[i] = 0;
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	ts.pboIndex = 0;
+
+	unsigned char gray[4] = {128, 128, 128, 255};
+	glGenTextures(1, &(ts.placeholderTexID));
+	glBindTexture(GL_TEXTURE_2D, ts.placeholderTexID);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, gray);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	createThreadPool(ts.pool, TEXTURE_STREAM_THREAD_CNT);
+	ts.uploadedBytes = 0;
+	ts.pendingCnt = 0;
+
+	cout << "Texture streamer: " << TEXTURE_STREAM_PBO_CNT << " x " << ts.bytesPerFrame << " byte PBOs";
+	cout << (ts.s3tcSupported ? "" : " (no S3TC; BC1/BC3 fall back to RGBA8)") << endl;
+}
+
+// Queue a file for decoding; the returned handle is valid immediately
+int requestTexture(TextureStreamer &ts, string filename, TextureCompression compression) {
+	if(!ts.s3tcSupported && (compression == TEXTURE_COMPRESSION_BC1 || compression == TEXTURE_COMPRESSION_BC3)) {
+		compression = TEXTURE_COMPRESSION_NONE;
+	}
+
+	int handle = (int)ts.textures.size();
+	StreamedTexture st;
+	st.filename = filename;
+	st.compression = compression;
+	ts.textures.push_back(st);
+	ts.pendingCnt++;
+
+	TextureStreamer *tsPtr = &ts;
+	submitTask(ts.pool, [tsPtr, handle, filename, compression]() {
+		decodeTextureTask(tsPtr, handle, filename, compression);
+	});
+	return handle;
+}
+
+// Immutable storage for the whole chain; nothing is sampled until the coarsest level lands
+static void createStreamedTexture(TextureStreamer &ts, StreamedTexture &st, shared_ptr<DecodedTexture> decoded) {
+	st.width = decoded->mips.at(0).width;
+	st.height = decoded->mips.at(0).height;
+	st.mipCnt = (int)decoded->mips.size();
+
+	glGenTextures(1, &(st.texID));
+	glBindTexture(GL_TEXTURE_2D, st.texID);
+	glTexStorage2D(GL_TEXTURE_2D, st.mipCnt, getCompressedFormat(st.compression), st.width, st.height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, st.mipCnt - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, st.mipCnt - 1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	st.pending = decoded;
+	st.uploadLevel = st.mipCnt - 1;
+	st.uploadRow = 0;
+}
+
+// One pending copy out of the current PBO
+struct TextureUploadOp {
+	int handle;
+	int level;
+	int firstRow;
+	int rowCnt;
+	size_t offset;
+	size_t size;
+};
+
+// Pick up decoded textures and spend up to bytesPerFrame uploading them; call once per frame
+void updateTextureStreamer(TextureStreamer &ts) {
+	vector<shared_ptr<DecodedTexture>> decodedList;
+	{
+		lock_guard<mutex> guard(ts.lock);
+		decodedList.swap(ts.finished);
+	}
+
+	for(auto &decoded : decodedList) {
+		StreamedTexture &st = ts.textures.at(decoded->handle);
+		if(!decoded->ok) {
+			st.failed = true;
+			ts.pendingCnt--;
+			continue;
+		}
+		createStreamedTexture(ts, st, decoded);
+		ts.uploadQueue.push_back(decoded->handle);
+	}
+
+	if(ts.uploadQueue.empty()) return;
+
+	// Don't stall on a PBO the GPU is still reading; just try again next frame
+	GLsync &fence = ts.fences[ts.pboIndex];
+	if(fence) {
+		GLenum result = glClientWaitSync(fence, 0, 0);
+		if(result == GL_TIMEOUT_EXPIRED) return;
+		glDeleteSync(fence);
+		fence = 0;
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ts.pbos[ts.pboIndex]);
+	unsigned char *mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, ts.bytesPerFrame,
+												GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if(!mapped) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return;
+	}
+
+	// Copy whole rows, coarsest level first, until the budget runs out
+	vector<TextureUploadOp> ops;
+	size_t used = 0;
+	for(int q = 0; q < (int)ts.uploadQueue.size(); q++) {
+		StreamedTexture &st = ts.textures.at(ts.uploadQueue.at(q));
+		bool budgetFull = false;
+		while(st.uploadLevel >= 0) {
+			const TextureMipData &mip = st.pending->mips.at(st.uploadLevel);
+			int rowTotal = getUploadRowCnt(mip, st.compression);
+			size_t rowBytes = getUploadRowBytes(mip, st.compression);
+			int rowCnt = min(rowTotal - st.uploadRow, (int)((ts.bytesPerFrame - used)/rowBytes));
+			if(rowCnt <= 0) {
+				budgetFull = true;
+				break;
+			}
+
+			TextureUploadOp op;
+			op.handle = ts.uploadQueue.at(q);
+			op.level = st.uploadLevel;
+			op.firstRow = st.uploadRow;
+			op.rowCnt = rowCnt;
+			op.offset = used;
+			op.size = rowBytes*rowCnt;
+			memcpy(mapped + used, mip.data.data() + rowBytes*st.uploadRow, op.size);
+			ops.push_back(op);
+			used += op.size;
+
+			st.uploadRow += rowCnt;
+			if(st.uploadRow == rowTotal) {
+				st.uploadLevel--;
+				st.uploadRow = 0;
+			}
+		}
+		if(budgetFull) break;
+	}
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+	GLint oldAlignment;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &oldAlignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	for(auto &op : ops) {
+		StreamedTexture &st = ts.textures.at(op.handle);
+		const TextureMipData &mip = st.pending->mips.at(op.level);
+		glBindTexture(GL_TEXTURE_2D, st.texID);
+		if(st.compression == TEXTURE_COMPRESSION_NONE) {
+			glTexSubImage2D(GL_TEXTURE_2D, op.level, 0, op.firstRow, mip.width, op.rowCnt,
+							GL_RGBA, GL_UNSIGNED_BYTE, (const void*)op.offset);
+		}
+		else {
+			// Block rows; the last one may run past the level's height
+			int y = op.firstRow*4;
+			int h = min(op.rowCnt*4, mip.height - y);
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, op.level, 0, y, mip.width, h,
+							getCompressedFormat(st.compression), (GLsizei)op.size, (const void*)op.offset);
+		}
+
+		// Level done: let the sampler see it
+		bool levelDone = (st.uploadLevel < op.level);
+		if(levelDone) {
+			st.residentLevel = op.level;
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, op.level);
+		}
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, oldAlignment);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	ts.fences[ts.pboIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	ts.pboIndex = (ts.pboIndex + 1) % TEXTURE_STREAM_PBO_CNT;
+	ts.uploadedBytes += used;
+
+	// Retire finished textures (CPU copies are no longer needed)
+	vector<int> stillUploading;
+	for(int handle : ts.uploadQueue) {
+		StreamedTexture &st = ts.textures.at(handle);
+		if(st.uploadLevel >= 0) {
+			stillUploading.push_back(handle);
+		}
+		else {
+			st.pending.reset();
+			ts.pendingCnt--;
+			cout << "Streamed texture: " << st.filename << " (" << st.width << "x" << st.height << ", ";
+			cout << st.mipCnt << " mips, " << getCompressionName(st.compression) << ")" << endl;
+		}
+	}
+	ts.uploadQueue.swap(stillUploading);
+}
+
+// Texture to bind for a handle: the placeholder until at least one level is resident
+GLuint getStreamedTexture(TextureStreamer &ts, int handle) {
+	if(handle < 0 || handle >= (int)ts.textures.size()) return ts.placeholderTexID;
+	StreamedTexture &st = ts.textures.at(handle);
+	return (st.residentLevel >= 0) ? st.texID : ts.placeholderTexID;
+}
+
+bool isTextureComplete(TextureStreamer &ts, int handle) {
+	if(handle < 0 || handle >= (int)ts.textures.size()) return false;
+	return ts.textures.at(handle).residentLevel == 0;
+}
+
+bool isStreamingDone(TextureStreamer &ts) {
+	return ts.pendingCnt == 0;
+}
+
+void cleanupTextureStreamer(TextureStreamer &ts) {
+	waitForTasks(ts.pool);
+	cleanupThreadPool(ts.pool);
+	ts.finished.clear();
+	ts.uploadQueue.clear();
+
+	for(int i = 0; i < TEXTURE_STREAM_PBO_CNT; i++) {
+		if(ts.fences[i]) glDeleteSync(ts.fences[i]);
+		ts.fences[i] = 0;
+	}
+	glDeleteBuffers(TEXTURE_STREAM_PBO_CNT, ts.pbos);
+
+	for(auto &st : ts.textures) {
+		if(st.texID) glDeleteTextures(1, &(st.texID));
+		st.texID = 0;
+		st.pending.reset();
+	}
+	ts.textures.clear();
+
+	glDeleteTextures(1, &(ts.placeholderTexID));
+	ts.placeholderTexID = 0;
+	ts.pendingCnt = 0;
+}
@@ -0,0 +1,127 @@
+#include "ThreadPool.hpp"
+
+// Number of hardware threads (at least 1)
+int getDefaultThreadCount() {
+	int cnt = (int)thread::hardware_concurrency();
+	return (cnt > 0) ? cnt : 1;
+}
+
+// Worker loop: run tasks until the pool is stopped
+static void threadPoolWorker(ThreadPool *pool) {
+	while(true) {
+		function<void()> task;
+		{
+			unique_lock<mutex> guard(pool->lock);
+			pool->taskReady.wait(guard, [pool] { return pool->stopping || !pool->tasks.empty(); });
+			if(pool->stopping && pool->tasks.empty()) return;
+			task = move(pool->tasks.front());
+			pool->tasks.pop();
+			pool->busyCnt++;
+		}
+
+		task();
+
+		{
+			lock_guard<mutex> guard(pool->lock);
+			pool->busyCnt--;
+			if(pool->busyCnt == 0 && pool->tasks.empty()) {
+				pool->allDone.notify_all();
+			}
+		}
+	}
+}
+
+// Start worker threads (0 = one per hardware thread)
+void createThreadPool(ThreadPool &pool, int threadCnt) {
+	if(threadCnt <= 0) threadCnt = getDefaultThreadCount();
+	pool.stopping = false;
+	for(int i = 0; i < threadCnt; i++) {
+		pool.workers.push_back(thread(threadPoolWorker, &pool));
+	}
+}
+
+// Queue a task
+void submitTask(ThreadPool &pool, function<void()> task) {
+	{
+		lock_guard<mutex> guard(pool.lock);
+		pool.tasks.push(move(task));
+	}
+	pool.taskReady.notify_one();
+}
+
+// Block until every queued task has finished
+void waitForTasks(ThreadPool &pool) {
+	unique_lock<mutex> guard(pool.lock);
+	pool.allDone.wait(guard, [&pool] { return pool.tasks.empty() && pool.busyCnt == 0; });
+}
+
+// Bookkeeping for one parallelFor() call (shared with its helper tasks)
+struct ParallelForState {
+	function<void(int)> func;
+	int count = 0;
+	int chunkSize = 1;
+	int chunkCnt = 0;
+	atomic<int> nextChunk{0};
+	int doneCnt = 0;			// Guarded by lock
+	mutex lock;
+	condition_variable done;
+};
+
+// Claim and run chunks until there are none left
+static void runParallelForChunks(shared_ptr<ParallelForState> state) {
+	while(true) {
+		int chunk = state->nextChunk.fetch_add(1);
+		if(chunk >= state->chunkCnt) return;
+
+		int start = chunk*state->chunkSize;
+		int end = min(start + state->chunkSize, state->count);
+		for(int i = start; i < end; i++) state->func(i);
+
+		lock_guard<mutex> guard(state->lock);
+		state->doneCnt++;
+		if(state->doneCnt == state->chunkCnt) state->done.notify_all();
+	}
+}
+
+// Run func(0..count-1) across the pool and wait for all of them.
+// The range is split into a few contiguous chunks per worker, and the calling
+// thread works on chunks too. It then waits only for chunks that are already running,
+// so this is safe to call from inside a pool task, and it never waits on unrelated work.
+void parallelFor(ThreadPool &pool, int count, function<void(int)> func) {
+	if(count <= 0) return;
+	int workerCnt = (int)pool.workers.size();
+	if(workerCnt == 0 || count == 1) {
+		for(int i = 0; i < count; i++) func(i);
+		return;
+	}
+
+	shared_ptr<ParallelForState> state = make_shared<ParallelForState>();
+	state->func = move(func);
+	state->count = count;
+	int targetChunkCnt = min(count, (workerCnt + 1)*PARALLEL_FOR_CHUNKS_PER_THREAD);
+	state->chunkSize = (count + targetChunkCnt - 1)/targetChunkCnt;
+	state->chunkCnt = (count + state->chunkSize - 1)/state->chunkSize;
+
+	// Helpers that start after every chunk was claimed just return
+	int helperCnt = min(workerCnt, state->chunkCnt - 1);
+	for(int i = 0; i < helperCnt; i++) {
+		submitTask(pool, [state] { runParallelForChunks(state); });
+	}
+	runParallelForChunks(state);
+
+	unique_lock<mutex> guard(state->lock);
+	state->done.wait(guard, [&state] { return state->doneCnt == state->chunkCnt; });
+}
+
+// Finish remaining tasks and join threads
+void cleanupThreadPool(ThreadPool &pool) {
+	{
+		lock_guard<mutex> guard(pool.lock);
+		pool.stopping = true;
+	}
+	pool.taskReady.notify_all();
+	for(thread &t : pool.workers) {
+		t.join();
+	}
+	pool.workers.clear();
+}
@@ -0,0 +1,111 @@
+#include <cstring>
+#include <chrono>
+#include "UniformRingGL.hpp"
+
+static GLsizeiptr alignUniformOffset(GLsizeiptr offset, GLint alignment) {
+	return ((offset + alignment - 1)/alignment)*alignment;
+}
+
+// Create ring with room for bytesPerFrame (plus alignment padding) in each region
+void createUniformRingGL(UniformRingGL &ring, GLsizeiptr bytesPerFrame) {
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &(ring.alignment));
+	ring.alignment = max(ring.alignment, 1);
+	ring.regionSize = alignUniformOffset(bytesPerFrame, ring.alignment);
+	ring.frameIndex = 0;
+	ring.writeOffset = 0;
+	GLsizeiptr totalSize = ring.regionSize*UNIFORM_RING_FRAME_CNT;
+
+	glGenBuffers(1, &(ring.buffer));
+	glBindBuffer(GL_UNIFORM_BUFFER, ring.buffer);
+	if(GLEW_ARB_buffer_storage) {
+		// Coherent, so nothing has to be flushed before the draw that reads it
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_UNIFORM_BUFFER, totalSize, NULL, flags);
+		ring.mapped = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, totalSize, flags);
+	}
+	if(!ring.mapped) {
+		glBufferData(GL_UNIFORM_BUFFER, totalSize, NULL, GL_DYNAMIC_DRAW);
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	cout << "Uniform ring: " << UNIFORM_RING_FRAME_CNT << " x " << ring.regionSize << " bytes";
+	cout << (ring.mapped ? " (persistently mapped)" : " (glBufferSubData)") << endl;
+}
+
+// Move to the next region, waiting until the GPU is done with what was written there last time
+void beginUniformFrame(UniformRingGL &ring) {
+	ring.writeOffset = 0;
+	ring.waitMS = 0.0;
+
+	GLsync &fence = ring.fences[ring.frameIndex];
+	if(!fence) return;
+
+	auto start = chrono::steady_clock::now();
+	GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+	while(true) {
+		GLenum result = glClientWaitSync(fence, flags, 1000000);	// 1 ms
+		if(result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED) break;
+		flags = 0;
+	}
+	ring.waitMS = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+	glDeleteSync(fence);
+	fence = 0;
+}
+
+// Copy a block into the current region; returns its offset in the buffer (for bindUniformRange())
+GLintptr pushUniformData(UniformRingGL &ring, const void *data, GLsizeiptr size) {
+	GLsizeiptr offset = alignUniformOffset(ring.writeOffset, ring.alignment);
+	if(offset + size > ring.regionSize) {
+		cerr << "ERROR: Uniform ring region full (" << ring.regionSize << " bytes)!" << endl;
+		throw runtime_error("Uniform ring region full.");
+	}
+	ring.writeOffset = offset + size;
+
+	GLintptr bufferOffset = ring.regionSize*ring.frameIndex + offset;
+	if(ring.mapped) {
+		memcpy(ring.mapped + bufferOffset, data, size);
+	}
+	else {
+		glBindBuffer(GL_UNIFORM_BUFFER, ring.buffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, bufferOffset, size, data);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+	return bufferOffset;
+}
+
+// Attach part of the ring to a uniform block binding point
+void bindUniformRange(UniformRingGL &ring, GLuint binding, GLintptr offset, GLsizeiptr size) {
+	glBindBufferRange(GL_UNIFORM_BUFFER, binding, ring.buffer, offset, size);
+}
+
+// Both of the above
+GLintptr pushAndBindUniformData(UniformRingGL &ring, GLuint binding, const void *data, GLsizeiptr size) {
+	GLintptr offset = pushUniformData(ring, data, size);
+	bindUniformRange(ring, binding, offset, size);
+	return offset;
+}
+
+// Call after the last draw that reads this frame's region
+void endUniformFrame(UniformRingGL &ring) {
+	if(ring.mapped) {
+		ring.fences[ring.frameIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+	ring.frameIndex = (ring.frameIndex + 1) % UNIFORM_RING_FRAME_CNT;
+}
+
+// Cleanup ring
+void cleanupUniformRingGL(UniformRingGL &ring) {
+	for(int i = 0; i < UNIFORM_RING_FRAME_CNT; i++) {
+		if(ring.fences[i]) glDeleteSync(ring.fences[i]);
+		ring.fences[i] = 0;
+	}
+	if(ring.mapped) {
+		glBindBuffer(GL_UNIFORM_BUFFER, ring.buffer);
+		glUnmapBuffer(GL_UNIFORM_BUFFER);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+	glDeleteBuffers(1, &(ring.buffer));
+	ring.buffer = 0;
+	ring.mapped = nullptr;
+}
@@ -10,15 +10,15 @@
 // GLFW window creation
 ///////////////////////////////////////////////////////////////////////////////
 
-GLFWwindow* createVulkanWindow(const char *windowName, int windowWidth, int windowHeight) {
+GLFWwindow* createVulkanWindow(const char *windowName, int windowWidth, int windowHeight, bool resizable) {
         // Initialize GLFW as usual
         glfwInit();
 
         // Do NOT create an OpenGL context
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 
-        // Disable resizing for now
-        glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+        // Resizing requires recreating the swap chain (see recreateVulkanSwapChain())
+        glfwWindowHint(GLFW_RESIZABLE, resizable ? GLFW_TRUE : GLFW_FALSE);
 
         // Create window
         GLFWwindow *window = glfwCreateWindow(windowWidth, windowHeight, windowName, nullptr, nullptr);
@@ -166,6 +166,17 @@ QueueFamilyIndices findQueueFamilies(vk::PhysicalDevice physicalDevice, vk::Surf
         throw std::runtime_error("Could not find appropriate queues!");
     }
 
+    // Transfer-only family (usually a separate DMA engine on discrete GPUs)
+    for(int i = 0; i < queueFamilies.size(); i++) {
+        vk::QueueFlags flags = queueFamilies[i].queueFlags;
+        if((flags & vk::QueueFlagBits::eTransfer) 
+            && !(flags & vk::QueueFlagBits::eGraphics)
+            && !(flags & vk::QueueFlagBits::eCompute)) {
+            indices.transferFamily = static_cast<uint32_t>(i);
+            break;
+        }
+    }
+
     return indices;
 }
 
@@ -189,6 +200,11 @@ vk::Device createVulkanLogicalDevice(vk::Instance instance, vk::PhysicalDevice p
         queueCreateInfo.push_back(vk::DeviceQueueCreateInfo({}, indices.presentFamily.value(), 1, &queuePriority));
     }
 
+    // Dedicated transfer queue (always a different family, see findQueueFamilies())
+    if(indices.transferFamily.has_value()) {
+        queueCreateInfo.push_back(vk::DeviceQueueCreateInfo({}, indices.transferFamily.value(), 1, &queuePriority));
+    }
+
     // Create LOGICAL device
     vk::DeviceCreateInfo deviceCreateInfo({}, queueCreateInfo, validationLayers, extensions);
     vk::Device device = physicalDevice.createDevice(deviceCreateInfo);
@@ -407,11 +423,23 @@ vk::RenderPass createVulkanRenderPass(vk::Device &device, SwapChainData &swapCha
         nullptr //depthAttachmentRef
     );  
 
+    // Don't write to the image until the presentation engine is done with it
+    // (the image-available semaphore is waited on at the color output stage)
+    vk::SubpassDependency dependency(
+        VK_SUBPASS_EXTERNAL,
+        0,
+        vk::PipelineStageFlagBits::eColorAttachmentOutput,
+        vk::PipelineStageFlagBits::eColorAttachmentOutput,
+        {},
+        vk::AccessFlagBits::eColorAttachmentWrite
+    );
+
     // Make the ACTUAL render pass
     return device.createRenderPass(vk::RenderPassCreateInfo(
         {},
         attachmentDescriptions,
-        subpassDescription
+        subpassDescription,
+        dependency
     ));    
 }
 
@@ -430,22 +458,36 @@ vk::VertexInputBindingDescription getVertexBindingDescription() {
 vector<vk::VertexInputAttributeDescription> getAttributeDescriptions() {
     vector<vk::VertexInputAttributeDescription> attributeDescriptions;
 
+    // Locations match setupVertexAttributes() on the OpenGL side
+
     // POSITION
     attributeDescriptions.push_back(vk::VertexInputAttributeDescription(
         0, // location
         0, // binding
         vk::Format::eR32G32B32Sfloat,  // format
-        offsetof(VulkanVertex, pos) // offset
+        offsetof(VulkanVertex, position) // offset
     ));
 
     // COLOR
     attributeDescriptions.push_back(vk::VertexInputAttributeDescription(
         1, // location
         0, // binding
-        vk::Format::eR32G32B32Sfloat,  // format
+        vk::Format::eR32G32B32A32Sfloat,  // format
         offsetof(VulkanVertex, color) // offset
     ));
 
+    // NORMAL
+    attributeDescriptions.push_back(vk::VertexInputAttributeDescription(
+        2, 0, vk::Format::eR32G32B32Sfloat, offsetof(VulkanVertex, normal)));
+
+    // TEXCOORD
+    attributeDescriptions.push_back(vk::VertexInputAttributeDescription(
+        3, 0, vk::Format::eR32G32Sfloat, offsetof(VulkanVertex, texcoord)));
+
+    // TANGENT
+    attributeDescriptions.push_back(vk::VertexInputAttributeDescription(
+        4, 0, vk::Format::eR32G32B32Sfloat, offsetof(VulkanVertex, tangent)));
+
     return attributeDescriptions;
 };
 
@@ -482,7 +524,10 @@ PipelineData createGraphicsPipelineData(vk::Device &device,
                                         SwapChainData &swapChainData,
                                         vk::RenderPass &renderPass, 
                                         string vertSPVFilename, 
-                                        string fragSPVFilename) {
+                                        string fragSPVFilename,
+                                        vk::PipelineCache sharedCache,
+                                        const vector<vk::DescriptorSetLayout> &setLayouts,
+                                        const vector<vk::PushConstantRange> &pushConstantRanges) {
 
     // Set up data
     PipelineData data;
@@ -557,13 +602,13 @@ PipelineData createGraphicsPipelineData(vk::Device &device,
     // Global blend settings
     vk::PipelineColorBlendStateCreateInfo colorBlending({}, false, vk::LogicOp::eCopy, colorBlendAttachment);
     
-    // Create empty layout for now (will need later for uniform variables)
+    // Layout for uniform variables (descriptor sets) and push constants (may both be empty)
     vk::PipelineLayoutCreateInfo pipelineLayoutInfo(
         {},
-        0,          // setLayoutCount
-        nullptr,    // pSetLayouts
-        0,          // pushConstantRangeCount
-        nullptr     // pPushConstantRanges 
+        static_cast<uint32_t>(setLayouts.size()),           // setLayoutCount
+        setLayouts.data(),                                  // pSetLayouts
+        static_cast<uint32_t>(pushConstantRanges.size()),   // pushConstantRangeCount
+        pushConstantRanges.data()                           // pPushConstantRanges 
     );
     
     // Create the pipeline layout
@@ -572,8 +617,15 @@ PipelineData createGraphicsPipelineData(vk::Device &device,
     // Not doing multisample AA
     vk::PipelineMultisampleStateCreateInfo multisample({}, vk::SampleCountFlagBits::e1);
 
-    // Create pipeline cache
-    data.cache = device.createPipelineCache( vk::PipelineCacheCreateInfo());
+    // Use shared (possibly preloaded) cache if we have one; otherwise create empty pipeline cache
+    if(sharedCache) {
+        data.cache = sharedCache;
+        data.ownsCache = false;
+    }
+    else {
+        data.cache = device.createPipelineCache( vk::PipelineCacheCreateInfo());
+        data.ownsCache = true;
+    }
 
     // CREATE ACTUAL PIPELINE
     vk::GraphicsPipelineCreateInfo pipelineInfo(vk::PipelineCreateFlags(),
@@ -590,7 +642,15 @@ PipelineData createGraphicsPipelineData(vk::Device &device,
                                                 data.pipelineLayout,
                                                 renderPass);    
     
+    auto startTime = chrono::steady_clock::now();
     auto ret = device.createGraphicsPipeline(data.cache, pipelineInfo);
+    double createMS = chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+#ifndef NDEBUG
+    // Debug builds only (same switch as the validation layers); shows whether the cache hit
+    std::cout << "Pipeline created in " << createMS << " ms" << std::endl;
+#else
+    (void)createMS;
+#endif
 
     if (ret.result != vk::Result::eSuccess) {
         throw std::runtime_error("Failed to create graphics pipeline!");
@@ -608,11 +668,114 @@ PipelineData createGraphicsPipelineData(vk::Device &device,
 }
 
 void cleanupGraphicsPipelineData(vk::Device &device, PipelineData &data) {
-    device.destroyPipelineCache(data.cache);
+    if(data.ownsCache) {
+        device.destroyPipelineCache(data.cache);
+    }
     device.destroyPipelineLayout(data.pipelineLayout);
     device.destroyPipeline(data.graphicsPipeline);
 }
 
+// Cache data is only valid for the exact device + driver, so both go in the name
+string getVulkanPipelineCacheFilename(vk::PhysicalDevice &physicalDevice, string baseFilename) {
+    vk::PhysicalDeviceProperties properties = physicalDevice.getProperties();
+    ostringstream name;
+    name << baseFilename << ".";
+    for(int i = 0; i < VK_UUID_SIZE; i++) {
+        name << hex << setw(2) << setfill('0') << (int)properties.pipelineCacheUUID[i];
+    }
+    name << "." << hex << properties.driverVersion << ".pipelinecache";
+    return name.str();
+}
+
+// Check header (VkPipelineCacheHeaderVersionOne) against this device; some drivers don't
+static bool isVulkanPipelineCacheValid(vk::PhysicalDeviceProperties &properties, vector<char> &cacheData) {
+    const size_t headerSize = 16 + VK_UUID_SIZE;
+    if(cacheData.size() < headerSize) return false;
+
+    uint32_t header[4];
+    memcpy(header, cacheData.data(), sizeof(header));
+    return header[0] >= headerSize
+            && header[1] == static_cast<uint32_t>(vk::PipelineCacheHeaderVersion::eOne)
+            && header[2] == properties.vendorID
+            && header[3] == properties.deviceID
+            && memcmp(cacheData.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+// Create pipeline cache, preloaded from disk if a matching file exists
+VulkanPipelineCache createVulkanPipelineCache(vk::PhysicalDevice &physicalDevice, vk::Device &device,
+                                                string baseFilename) {
+    VulkanPipelineCache pipelineCache;
+    pipelineCache.filename = getVulkanPipelineCacheFilename(physicalDevice, baseFilename);
+
+    vector<char> cacheData;
+    ifstream file(pipelineCache.filename, ios::binary | ios::ate);
+    if(file.is_open()) {
+        cacheData.resize((size_t)file.tellg());
+        file.seekg(0);
+        file.read(cacheData.data(), cacheData.size());
+        if(!file) cacheData.clear();
+        file.close();
+    }
+
+    vk::PhysicalDeviceProperties properties = physicalDevice.getProperties();
+    if(!cacheData.empty() && !isVulkanPipelineCacheValid(properties, cacheData)) {
+        cout << "Ignoring stale pipeline cache: " << pipelineCache.filename << endl;
+        cacheData.clear();
+    }
+
+    vk::PipelineCacheCreateInfo cacheInfo;
+    cacheInfo.initialDataSize = cacheData.size();
+    cacheInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+    pipelineCache.cache = device.createPipelineCache(cacheInfo);
+    pipelineCache.loadedBytes = cacheData.size();
+
+    if(pipelineCache.loadedBytes > 0) {
+        cout << "Loaded pipeline cache (" << pipelineCache.loadedBytes << " bytes)" << endl;
+    }
+
+    return pipelineCache;
+}
+
+// Write cache contents to disk (temporary file first, so a crash never leaves half a cache)
+bool saveVulkanPipelineCache(vk::Device &device, VulkanPipelineCache &pipelineCache) {
+    vector<uint8_t> cacheData = device.getPipelineCacheData(pipelineCache.cache);
+    if(cacheData.empty()) return false;
+
+    string tempFilename = pipelineCache.filename + ".tmp";
+    ofstream file(tempFilename, ios::binary | ios::trunc);
+    if(!file) {
+        cerr << "ERROR: Could not write pipeline cache: " << tempFilename << endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(cacheData.data()), cacheData.size());
+    bool ok = file.good();
+    file.close();
+
+    if(!ok) {
+        remove(tempFilename.c_str());
+        return false;
+    }
+
+    // Replaces the old file atomically on POSIX; Windows' rename() won't overwrite, so delete first there
+#ifdef _WIN32
+    remove(pipelineCache.filename.c_str());
+#endif
+    if(rename(tempFilename.c_str(), pipelineCache.filename.c_str()) != 0) {
+        remove(tempFilename.c_str());
+        cerr << "ERROR: Could not rename pipeline cache: " << pipelineCache.filename << endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Saves the cache, then destroys it (destroy all pipelines using it first)
+void cleanupVulkanPipelineCache(vk::Device &device, VulkanPipelineCache &pipelineCache) {
+    saveVulkanPipelineCache(device, pipelineCache);
+    device.destroyPipelineCache(pipelineCache.cache);
+    pipelineCache.cache = vk::PipelineCache();
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Vulkan framebuffers
 ///////////////////////////////////////////////////////////////////////////////
@@ -684,6 +847,210 @@ void cleanupVulkanFence(vk::Device &device, vk::Fence &f) {
     device.destroyFence(f);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Vulkan frame loop
+///////////////////////////////////////////////////////////////////////////////
+
+static double getElapsedMS(chrono::steady_clock::time_point start, chrono::steady_clock::time_point end) {
+    return chrono::duration<double, milli>(end - start).count();
+}
+
+// One semaphore per swap chain image; image fences start out unused
+static void createPerImageSyncObjects(vk::Device &device, SwapChainData &swapChainData, VulkanFrameLoop &loop) {
+    for(auto &s : loop.renderFinished) {
+        cleanupVulkanSemaphore(device, s);
+    }
+    loop.renderFinished.clear();
+
+    for(size_t i = 0; i < swapChainData.images.size(); i++) {
+        loop.renderFinished.push_back(createVulkanSemaphore(device));
+    }
+    loop.imagesInFlight.assign(swapChainData.images.size(), vk::Fence());
+}
+
+VulkanFrameLoop createVulkanFrameLoop(  vk::Device &device, QueueFamilyIndices &indices,
+                                        SwapChainData &swapChainData,
+                                        int framesInFlight) {
+    VulkanFrameLoop loop;
+
+    // Each frame gets its own command buffer from a shared pool
+    loop.commandPool = createVulkanCommandPool(device, indices);
+    vector<vk::CommandBuffer> commandBuffers = device.allocateCommandBuffers(
+        vk::CommandBufferAllocateInfo(loop.commandPool, vk::CommandBufferLevel::ePrimary, 
+                                        static_cast<uint32_t>(framesInFlight)));
+
+    for(int i = 0; i < framesInFlight; i++) {
+        VulkanFrameData frame;
+        frame.commandBuffer = commandBuffers.at(i);
+        frame.imageAvailable = createVulkanSemaphore(device);
+        frame.inFlight = createVulkanFence(device);     // Created signaled, so the first wait returns immediately
+        loop.frames.push_back(frame);
+    }
+
+    createPerImageSyncObjects(device, swapChainData, loop);
+
+    loop.frameStart = chrono::steady_clock::now();
+    return loop;
+}
+
+static void vulkanFramebufferResizeCallback(GLFWwindow *window, int width, int height) {
+    VulkanFrameLoop *loop = reinterpret_cast<VulkanFrameLoop*>(glfwGetWindowUserPointer(window));
+    if(loop) {
+        loop->framebufferResized = true;
+    }
+}
+
+// Flag the loop whenever the window changes size
+// (the loop must outlive the window's callbacks, since GLFW keeps a pointer to it)
+void watchVulkanWindowResize(GLFWwindow *window, VulkanFrameLoop &loop) {
+    glfwSetWindowUserPointer(window, &loop);
+    glfwSetFramebufferSizeCallback(window, vulkanFramebufferResizeCallback);
+}
+
+// Wait for this frame slot, acquire an image, and start recording.
+// Returns false if the swap chain is out of date (recreate it and skip the frame).
+bool beginVulkanFrame(vk::Device &device, SwapChainData &swapChainData, VulkanFrameLoop &loop) {
+    auto now = chrono::steady_clock::now();
+    loop.timings.frameMS = getElapsedMS(loop.frameStart, now);
+    loop.frameStart = now;
+
+    VulkanFrameData &frame = loop.frames.at(loop.currentFrame);
+
+    // Only blocks if the GPU is more than framesInFlight frames behind
+    auto waitStart = chrono::steady_clock::now();
+    if(device.waitForFences(frame.inFlight, true, UINT64_MAX) != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed waiting for frame fence!");
+    }
+    auto acquireStart = chrono::steady_clock::now();
+    loop.timings.fenceWaitMS = getElapsedMS(waitStart, acquireStart);
+
+    // Get next image
+    try {
+        auto result = device.acquireNextImageKHR(swapChainData.chain, UINT64_MAX, frame.imageAvailable, nullptr);
+        loop.imageIndex = result.value;
+        // eSuboptimalKHR still gives us a usable image; recreate after presenting
+    }
+    catch(vk::OutOfDateKHRError&) {
+        return false;
+    }
+    auto acquireEnd = chrono::steady_clock::now();
+    loop.timings.acquireMS = getElapsedMS(acquireStart, acquireEnd);
+
+    // Image may still be in use by an older frame (when there are more images than frames in flight)
+    vk::Fence &imageFence = loop.imagesInFlight.at(loop.imageIndex);
+    if(imageFence && imageFence != frame.inFlight) {
+        if(device.waitForFences(imageFence, true, UINT64_MAX) != vk::Result::eSuccess) {
+            throw std::runtime_error("Failed waiting for image fence!");
+        }
+        // A GPU stall like the frame fence, so it counts as fence wait (not recording)
+        loop.timings.fenceWaitMS += getElapsedMS(acquireEnd, chrono::steady_clock::now());
+    }
+    imageFence = frame.inFlight;
+
+    // Only reset fence once we KNOW we'll submit work (otherwise the next wait would deadlock)
+    device.resetFences(frame.inFlight);
+
+    // Recording time covers only what the caller records (see endVulkanFrame())
+    loop.recordStart = chrono::steady_clock::now();
+    frame.commandBuffer.reset();
+    frame.commandBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+
+    loop.frameStarted = true;
+    return true;
+}
+
+vk::CommandBuffer& getVulkanFrameCommandBuffer(VulkanFrameLoop &loop) {
+    return loop.frames.at(loop.currentFrame).commandBuffer;
+}
+
+// Finish recording, submit and present.
+// Returns false if the swap chain should be recreated.
+bool endVulkanFrame(vk::Device &device, vk::Queue &graphicsQueue, vk::Queue &presentQueue,
+                    SwapChainData &swapChainData, VulkanFrameLoop &loop) {
+    VulkanFrameData &frame = loop.frames.at(loop.currentFrame);
+    vk::Semaphore &renderFinished = loop.renderFinished.at(loop.imageIndex);
+
+    frame.commandBuffer.end();
+
+    auto submitStart = chrono::steady_clock::now();
+    loop.timings.recordMS = getElapsedMS(loop.recordStart, submitStart);
+
+    // Wait for image before writing color; signal renderFinished and the frame fence when done
+    vk::PipelineStageFlags waitStage = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+    vk::SubmitInfo submitInfo(frame.imageAvailable, waitStage, frame.commandBuffer, renderFinished);
+    graphicsQueue.submit(submitInfo, frame.inFlight);
+
+    bool swapChainOK = true;
+    try {
+        vk::PresentInfoKHR presentInfo(renderFinished, swapChainData.chain, loop.imageIndex);
+        vk::Result result = presentQueue.presentKHR(presentInfo);
+        if(result == vk::Result::eSuboptimalKHR) {
+            swapChainOK = false;
+        }
+    }
+    catch(vk::OutOfDateKHRError&) {
+        swapChainOK = false;
+    }
+
+    if(loop.framebufferResized) {
+        swapChainOK = false;
+    }
+
+    loop.timings.submitMS = getElapsedMS(submitStart, chrono::steady_clock::now());
+
+    // Move on to next frame slot
+    loop.currentFrame = (loop.currentFrame + 1) % static_cast<uint32_t>(loop.frames.size());
+    loop.frameStarted = false;
+    loop.frameCnt++;
+
+    return swapChainOK;
+}
+
+// Rebuild swap chain (and framebuffers) after a resize; blocks while the window is minimized
+void recreateVulkanSwapChain(GLFWwindow *window, vk::PhysicalDevice physicalDevice,
+                            vk::Device &device, vk::SurfaceKHR surface, QueueFamilyIndices indices,
+                            SwapChainData &swapChainData, vk::RenderPass &renderPass,
+                            vector<vk::Framebuffer> &framebuffers, VulkanFrameLoop &loop) {
+    int width = 0, height = 0;
+    glfwGetFramebufferSize(window, &width, &height);
+    while((width == 0 || height == 0) && !glfwWindowShouldClose(window)) {
+        glfwWaitEvents();
+        glfwGetFramebufferSize(window, &width, &height);
+    }
+
+    // Nothing may still be using the old images
+    device.waitIdle();
+
+    cleanupVulkanFramebuffers(device, framebuffers);
+    cleanupSwapChainData(device, swapChainData);
+
+    // Assumes the surface format doesn't change, so the render pass (and pipelines) stay valid
+    swapChainData = createSwapChainData(window, physicalDevice, device, surface, indices);
+    framebuffers = createVulkanFramebuffers(device, swapChainData, renderPass);
+
+    createPerImageSyncObjects(device, swapChainData, loop);
+    loop.framebufferResized = false;
+}
+
+void cleanupVulkanFrameLoop(vk::Device &device, VulkanFrameLoop &loop) {
+    device.waitIdle();
+
+    for(auto &frame : loop.frames) {
+        cleanupVulkanSemaphore(device, frame.imageAvailable);
+        cleanupVulkanFence(device, frame.inFlight);
+    }
+    for(auto &s : loop.renderFinished) {
+        cleanupVulkanSemaphore(device, s);
+    }
+
+    // Frees the command buffers too
+    cleanupVulkanCommandPool(device, loop.commandPool);
+
+    loop.frames.clear();
+    loop.renderFinished.clear();
+    loop.imagesInFlight.clear();
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Vulkan mesh
 ///////////////////////////////////////////////////////////////////////////////
@@ -707,13 +1074,22 @@ VulkanBuffer createVulkanBuffer(vk::PhysicalDevice &physicalDevice,
                                 vk::Device &device,
                                 vk::DeviceSize size,
                                 vk::BufferUsageFlags usage,
-                                vk::MemoryPropertyFlags properties) {
+                                vk::MemoryPropertyFlags properties,
+                                const vector<uint32_t> &sharingFamilies) {
 
     // Set up struct
     VulkanBuffer data;
 
     // Create buffer (memory not allocated YET)
-    data.buffer = device.createBuffer(vk::BufferCreateInfo(vk::BufferCreateFlags(), size, usage, vk::SharingMode::eExclusive));
+    // Buffers written on one queue family and read on another are shared concurrently
+    // (simpler than queue family ownership transfers)
+    vk::BufferCreateInfo bufferInfo(vk::BufferCreateFlags(), size, usage, vk::SharingMode::eExclusive);
+    if(sharingFamilies.size() > 1) {
+        bufferInfo.sharingMode = vk::SharingMode::eConcurrent;
+        bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(sharingFamilies.size());
+        bufferInfo.pQueueFamilyIndices = sharingFamilies.data();
+    }
+    data.buffer = device.createBuffer(bufferInfo);
           
     // Get memory requirements
     vk::MemoryRequirements memRequirements = device.getBufferMemoryRequirements(data.buffer);
@@ -733,6 +1109,33 @@ VulkanBuffer createVulkanBuffer(vk::PhysicalDevice &physicalDevice,
     return data;
 }
 
+VulkanBuffer createVulkanBuffer(VulkanAllocator &allocator,
+                                vk::DeviceSize size,
+                                vk::BufferUsageFlags usage,
+                                vk::MemoryPropertyFlags properties,
+                                const vector<uint32_t> &sharingFamilies) {
+    VulkanBuffer data;
+
+    vk::BufferCreateInfo bufferInfo(vk::BufferCreateFlags(), size, usage, vk::SharingMode::eExclusive);
+    if(sharingFamilies.size() > 1) {
+        bufferInfo.sharingMode = vk::SharingMode::eConcurrent;
+        bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(sharingFamilies.size());
+        bufferInfo.pQueueFamilyIndices = sharingFamilies.data();
+    }
+    data.buffer = allocator.device.createBuffer(bufferInfo);
+
+    // Carve space out of a shared block instead of allocating
+    vk::MemoryRequirements memRequirements = allocator.device.getBufferMemoryRequirements(data.buffer);
+    data.allocation = allocateVulkanMemory(allocator, memRequirements, properties);
+    data.memory = data.allocation.memory;
+    data.offset = data.allocation.offset;
+    data.allocator = &allocator;
+
+    allocator.device.bindBufferMemory(data.buffer, data.memory, data.offset);
+
+    return data;
+}
+
 void copyDataToVulkanBuffer(vk::Device &device, vk::DeviceMemory memory, size_t bufferSize, void *hostData) {
     void* data;
     vkMapMemory(device, memory, 0, bufferSize, 0, &data);
@@ -740,6 +1143,19 @@ void copyDataToVulkanBuffer(vk::Device &device, vk::DeviceMemory memory, size_t
     vkUnmapMemory(device, memory);
 }
 
+// Sub-allocated buffers share their memory (which is already mapped), so use this version for them
+void copyDataToVulkanBuffer(vk::Device &device, VulkanBuffer &buffer, size_t bufferSize, void *hostData) {
+    if(buffer.allocator) {
+        if(!buffer.allocation.mapped) {
+            throw std::runtime_error("Buffer memory is not host visible!");
+        }
+        memcpy(buffer.allocation.mapped, hostData, bufferSize);
+    }
+    else {
+        copyDataToVulkanBuffer(device, buffer.memory, bufferSize, hostData);
+    }
+}
+
 VulkanMesh createVulkanMesh(vk::PhysicalDevice &physicalDevice,
                             vk::Device &device, HostMesh &hostMesh) {
     // Set up Vulkan mesh                            
@@ -753,17 +1169,20 @@ VulkanMesh createVulkanMesh(vk::PhysicalDevice &physicalDevice,
         vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
 
     // Copy in data
-    copyDataToVulkanBuffer(device, mesh.vertices.memory, vertBufferSize, hostMesh.vertices.data());      
+    copyDataToVulkanBuffer(device, mesh.vertices, vertBufferSize, hostMesh.vertices.data());      
 
-    // Create index buffer
-    vk::DeviceSize indexBufferSize = sizeof(hostMesh.indices[0]) * hostMesh.indices.size();
+    // Create index buffer (16 or 32 bit, depending on vertex count)
+    vector<unsigned char> indexData;
+    mesh.indexType = chooseVulkanIndexType(hostMesh);
+    packVulkanIndices(hostMesh, mesh.indexType, indexData);
+    vk::DeviceSize indexBufferSize = indexData.size();
     mesh.indices = createVulkanBuffer(
         physicalDevice, device, indexBufferSize,
         vk::BufferUsageFlagBits::eIndexBuffer, 
         vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
 
     // Copy in data
-    copyDataToVulkanBuffer(device, mesh.indices.memory, indexBufferSize, hostMesh.indices.data());
+    copyDataToVulkanBuffer(device, mesh.indices, indexBufferSize, indexData.data());
 
     // Set index count
     mesh.indexCnt = hostMesh.indices.size();
@@ -772,22 +1191,607 @@ VulkanMesh createVulkanMesh(vk::PhysicalDevice &physicalDevice,
     return mesh;
 }
 
+VulkanMesh createVulkanMesh(VulkanAllocator &allocator, HostMesh &hostMesh) {
+    VulkanMesh mesh;
+
+    vk::DeviceSize vertBufferSize = sizeof(hostMesh.vertices[0]) * hostMesh.vertices.size();
+    mesh.vertices = createVulkanBuffer(
+        allocator, vertBufferSize,
+        vk::BufferUsageFlagBits::eVertexBuffer, 
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+    copyDataToVulkanBuffer(allocator.device, mesh.vertices, vertBufferSize, hostMesh.vertices.data());
+
+    vector<unsigned char> indexData;
+    mesh.indexType = chooseVulkanIndexType(hostMesh);
+    packVulkanIndices(hostMesh, mesh.indexType, indexData);
+    vk::DeviceSize indexBufferSize = indexData.size();
+    mesh.indices = createVulkanBuffer(
+        allocator, indexBufferSize,
+        vk::BufferUsageFlagBits::eIndexBuffer, 
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+    copyDataToVulkanBuffer(allocator.device, mesh.indices, indexBufferSize, indexData.data());
+
+    mesh.indexCnt = hostMesh.indices.size();
+
+    return mesh;
+}
+
+// 16-bit indices whenever every vertex is reachable with them (halves index bandwidth)
+vk::IndexType chooseVulkanIndexType(HostMesh &hostMesh) {
+    if(hostMesh.vertices.size() <= 65536) {
+        return vk::IndexType::eUint16;
+    }
+    return vk::IndexType::eUint32;
+}
+
+size_t getVulkanIndexSize(vk::IndexType indexType) {
+    return (indexType == vk::IndexType::eUint16) ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+// Get indices as raw bytes at the given width
+void packVulkanIndices(HostMesh &hostMesh, vk::IndexType indexType, vector<unsigned char> &indexData) {
+    size_t indexCnt = hostMesh.indices.size();
+    indexData.resize(indexCnt * getVulkanIndexSize(indexType));
+
+    if(indexType == vk::IndexType::eUint16) {
+        uint16_t *dst = reinterpret_cast<uint16_t*>(indexData.data());
+        for(size_t i = 0; i < indexCnt; i++) {
+            dst[i] = static_cast<uint16_t>(hostMesh.indices[i]);
+        }
+    }
+    else {
+        memcpy(indexData.data(), hostMesh.indices.data(), indexData.size());
+    }
+}
+
 void drawVulkanMesh(vk::CommandBuffer &commandBuffer, VulkanMesh &mesh) {
-    
+    bindVulkanMesh(commandBuffer, mesh);
+    drawBoundVulkanMesh(commandBuffer, mesh);
+}    
+
+void bindVulkanMesh(vk::CommandBuffer &commandBuffer, VulkanMesh &mesh) {
     vk::Buffer vertexBuffers[] = {mesh.vertices.buffer};
     vk::DeviceSize offsets[] = {0};
     commandBuffer.bindVertexBuffers(0, vertexBuffers, offsets);
-    commandBuffer.bindIndexBuffer(mesh.indices.buffer, 0, vk::IndexType::eUint16);
-    
+    commandBuffer.bindIndexBuffer(mesh.indices.buffer, 0, mesh.indexType);
+}
+
+// Draw again without rebinding (for many copies of the same mesh)
+void drawBoundVulkanMesh(vk::CommandBuffer &commandBuffer, VulkanMesh &mesh) {
     commandBuffer.drawIndexed(static_cast<uint32_t>(mesh.indexCnt), 1, 0, 0, 0);
-}    
+}
 
 void cleanupVulkanBuffer(vk::Device &device, VulkanBuffer &data) {
     device.destroyBuffer(data.buffer);
-    device.freeMemory(data.memory);
+    if(data.allocator) {
+        freeVulkanMemory(*data.allocator, data.allocation);
+    }
+    else {
+        device.freeMemory(data.memory);
+    }
+    data.allocator = nullptr;
 }
 
 void cleanupVulkanMesh(vk::Device &device, VulkanMesh &mesh) {
     cleanupVulkanBuffer(device, mesh.vertices);
     cleanupVulkanBuffer(device, mesh.indices);
 }
+
+///////////////////////////////////////////////////////////////////////////////
+// Vulkan staging uploads
+///////////////////////////////////////////////////////////////////////////////
+
+VulkanUploadContext createVulkanUploadContext(vk::PhysicalDevice &physicalDevice,
+                                                vk::Device &device,
+                                                QueueFamilyIndices &indices,
+                                                bool useTransferQueue,
+                                                VulkanAllocator *allocator) {
+    VulkanUploadContext upload;
+    upload.physicalDevice = physicalDevice;
+    upload.device = device;
+    upload.allocator = allocator;
+
+    // Use the dedicated transfer queue if there is one
+    upload.queueFamily = indices.graphicsFamily.value();
+    if(useTransferQueue && indices.transferFamily.has_value()) {
+        upload.queueFamily = indices.transferFamily.value();
+        upload.sharingFamilies = { indices.graphicsFamily.value(), indices.transferFamily.value() };
+    }
+    upload.queue = device.getQueue(upload.queueFamily, 0);
+
+    // Command buffers here are short-lived
+    upload.commandPool = device.createCommandPool(
+        vk::CommandPoolCreateInfo(
+            vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+            upload.queueFamily));
+    upload.commandBuffer = createVulkanCommandBuffer(device, upload.commandPool);
+    upload.fence = device.createFence(vk::FenceCreateInfo());
+
+    return upload;
+}
+
+// Create device-local buffer now; its contents arrive at the next flushVulkanUploads()
+VulkanBuffer createDeviceLocalBuffer(VulkanUploadContext &upload, const void *hostData,
+                                        vk::DeviceSize size, vk::BufferUsageFlags usage) {
+    VulkanBuffer buffer;
+    if(upload.allocator) {
+        buffer = createVulkanBuffer(
+            *upload.allocator, size,
+            usage | vk::BufferUsageFlagBits::eTransferDst,
+            vk::MemoryPropertyFlagBits::eDeviceLocal,
+            upload.sharingFamilies);
+    }
+    else {
+        buffer = createVulkanBuffer(
+            upload.physicalDevice, upload.device, size,
+            usage | vk::BufferUsageFlagBits::eTransferDst,
+            vk::MemoryPropertyFlagBits::eDeviceLocal,
+            upload.sharingFamilies);
+    }
+
+    // Copy into the staging area (16-byte aligned, so the caller's data can go away immediately)
+    vk::DeviceSize offset = (upload.stagingData.size() + 15) & ~(vk::DeviceSize)15;
+    upload.stagingData.resize(offset + size);
+    memcpy(upload.stagingData.data() + offset, hostData, size);
+
+    VulkanPendingCopy copy;
+    copy.dst = buffer.buffer;
+    copy.stagingOffset = offset;
+    copy.size = size;
+    upload.pendingCopies.push_back(copy);
+
+    return buffer;
+}
+
+VulkanMesh createVulkanMeshDeviceLocal(VulkanUploadContext &upload, HostMesh &hostMesh) {
+    VulkanMesh mesh;
+
+    vk::DeviceSize vertBufferSize = sizeof(hostMesh.vertices[0]) * hostMesh.vertices.size();
+    mesh.vertices = createDeviceLocalBuffer(upload, hostMesh.vertices.data(), vertBufferSize,
+                                            vk::BufferUsageFlagBits::eVertexBuffer);
+
+    vector<unsigned char> indexData;
+    mesh.indexType = chooseVulkanIndexType(hostMesh);
+    packVulkanIndices(hostMesh, mesh.indexType, indexData);
+    mesh.indices = createDeviceLocalBuffer(upload, indexData.data(), indexData.size(),
+                                            vk::BufferUsageFlagBits::eIndexBuffer);
+
+    mesh.indexCnt = hostMesh.indices.size();
+
+    return mesh;
+}
+
+// Submit all pending copies at once and wait for them
+void flushVulkanUploads(VulkanUploadContext &upload) {
+    if(upload.pendingCopies.empty()) return;
+
+    // One host-visible staging buffer for the whole batch
+    VulkanBuffer staging = createVulkanBuffer(
+        upload.physicalDevice, upload.device, upload.stagingData.size(),
+        vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+    copyDataToVulkanBuffer(upload.device, staging, upload.stagingData.size(), upload.stagingData.data());
+
+    // Record copies
+    upload.commandBuffer.reset();
+    upload.commandBuffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    for(auto &copy : upload.pendingCopies) {
+        vk::BufferCopy region(copy.stagingOffset, 0, copy.size);
+        upload.commandBuffer.copyBuffer(staging.buffer, copy.dst, region);
+    }
+    upload.commandBuffer.end();
+
+    // Submit and wait once
+    vk::SubmitInfo submitInfo;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &upload.commandBuffer;
+    upload.queue.submit(submitInfo, upload.fence);
+    if(upload.device.waitForFences(upload.fence, true, UINT64_MAX) != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed waiting for upload fence!");
+    }
+    upload.device.resetFences(upload.fence);
+
+    cleanupVulkanBuffer(upload.device, staging);
+    upload.stagingData.clear();
+    upload.stagingData.shrink_to_fit();
+    upload.pendingCopies.clear();
+}
+
+void cleanupVulkanUploadContext(VulkanUploadContext &upload) {
+    flushVulkanUploads(upload);
+    upload.device.destroyFence(upload.fence);
+    upload.device.destroyCommandPool(upload.commandPool);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Vulkan memory allocator
+///////////////////////////////////////////////////////////////////////////////
+
+static vk::DeviceSize alignVulkanOffset(vk::DeviceSize offset, vk::DeviceSize alignment) {
+    if(alignment <= 1) return offset;
+    return ((offset + alignment - 1) / alignment) * alignment;
+}
+
+VulkanAllocator createVulkanAllocator(vk::PhysicalDevice &physicalDevice, vk::Device &device,
+                                        vk::DeviceSize blockSize) {
+    VulkanAllocator allocator;
+    allocator.physicalDevice = physicalDevice;
+    allocator.device = device;
+    allocator.memProperties = physicalDevice.getMemoryProperties();
+    allocator.blockSize = blockSize;
+    allocator.maxAllocationCnt = physicalDevice.getProperties().limits.maxMemoryAllocationCount;
+    allocator.pools.resize(allocator.memProperties.memoryTypeCount);
+    return allocator;
+}
+
+// Count of live vk::DeviceMemory objects across all pools
+static int getDeviceAllocationCount(VulkanAllocator &allocator) {
+    int cnt = 0;
+    for(auto &pool : allocator.pools) {
+        for(auto &block : pool.blocks) {
+            if(block.memory) cnt++;
+        }
+    }
+    return cnt;
+}
+
+// Allocate a new block (at least minSize) for a memory type; returns its index
+static int createVulkanMemoryBlock(VulkanAllocator &allocator, uint32_t memoryTypeIndex, vk::DeviceSize minSize) {
+    if(getDeviceAllocationCount(allocator) + 1 > (int)allocator.maxAllocationCnt) {
+        throw std::runtime_error("Exceeded maxMemoryAllocationCount!");
+    }
+
+    VulkanMemoryBlock block;
+    block.size = max(allocator.blockSize, minSize);
+    block.memory = allocator.device.allocateMemory(vk::MemoryAllocateInfo(block.size, memoryTypeIndex));
+    block.freeRanges.push_back({0, block.size});
+
+    // Map host-visible blocks once for their whole lifetime (a memory object can only be mapped once)
+    vk::MemoryPropertyFlags flags = allocator.memProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+    if(flags & vk::MemoryPropertyFlagBits::eHostVisible) {
+        block.mapped = allocator.device.mapMemory(block.memory, 0, block.size);
+    }
+
+    // Reuse an empty slot so existing block indices stay valid
+    vector<VulkanMemoryBlock> &blocks = allocator.pools.at(memoryTypeIndex).blocks;
+    for(int i = 0; i < (int)blocks.size(); i++) {
+        if(!blocks[i].memory) {
+            blocks[i] = block;
+            return i;
+        }
+    }
+    blocks.push_back(block);
+    return (int)blocks.size() - 1;
+}
+
+// First fit: returns true (and fills allocation) if the block has room
+static bool allocateFromBlock(VulkanMemoryBlock &block, vk::DeviceSize size, vk::DeviceSize alignment,
+                                VulkanAllocation &allocation) {
+    for(size_t i = 0; i < block.freeRanges.size(); i++) {
+        VulkanMemoryRange range = block.freeRanges[i];
+        vk::DeviceSize start = alignVulkanOffset(range.offset, alignment);
+        vk::DeviceSize end = start + size;
+        if(end > range.offset + range.size) continue;
+
+        // Split range: keep the alignment padding before and the leftover after
+        vector<VulkanMemoryRange> pieces;
+        if(start > range.offset) {
+            pieces.push_back({range.offset, start - range.offset});
+        }
+        if(end < range.offset + range.size) {
+            pieces.push_back({end, range.offset + range.size - end});
+        }
+        block.freeRanges.erase(block.freeRanges.begin() + i);
+        block.freeRanges.insert(block.freeRanges.begin() + i, pieces.begin(), pieces.end());
+
+        allocation.memory = block.memory;
+        allocation.offset = start;
+        allocation.size = size;
+        allocation.mapped = block.mapped ? (static_cast<char*>(block.mapped) + start) : nullptr;
+
+        block.usedBytes += size;
+        block.allocationCnt++;
+        return true;
+    }
+    return false;
+}
+
+VulkanAllocation allocateVulkanMemory(VulkanAllocator &allocator, vk::MemoryRequirements memRequirements,
+                                        vk::MemoryPropertyFlags properties) {
+    VulkanAllocation allocation;
+    allocation.memoryTypeIndex = findMemoryType(allocator.physicalDevice, memRequirements.memoryTypeBits, properties);
+
+    // Only buffers go through here, so bufferImageGranularity doesn't come into play
+    vector<VulkanMemoryBlock> &blocks = allocator.pools.at(allocation.memoryTypeIndex).blocks;
+    for(int i = 0; i < (int)blocks.size(); i++) {
+        if(!blocks[i].memory) continue;
+        if(allocateFromBlock(blocks[i], memRequirements.size, memRequirements.alignment, allocation)) {
+            allocation.blockIndex = i;
+            return allocation;
+        }
+    }
+
+    // No room anywhere: new block (oversized requests get a block of their own)
+    int blockIndex = createVulkanMemoryBlock(allocator, allocation.memoryTypeIndex, memRequirements.size);
+    if(!allocateFromBlock(allocator.pools.at(allocation.memoryTypeIndex).blocks.at(blockIndex),
+                            memRequirements.size, memRequirements.alignment, allocation)) {
+        throw std::runtime_error("Failed to sub-allocate Vulkan memory!");
+    }
+    allocation.blockIndex = blockIndex;
+    return allocation;
+}
+
+// Destroy a block's device memory (its slot is reused later)
+static void releaseVulkanMemoryBlock(VulkanAllocator &allocator, VulkanMemoryBlock &block) {
+    if(block.mapped) {
+        allocator.device.unmapMemory(block.memory);
+    }
+    allocator.device.freeMemory(block.memory);
+    block = VulkanMemoryBlock();
+}
+
+void freeVulkanMemory(VulkanAllocator &allocator, VulkanAllocation &allocation) {
+    if(allocation.blockIndex < 0) return;
+
+    vector<VulkanMemoryBlock> &blocks = allocator.pools.at(allocation.memoryTypeIndex).blocks;
+    VulkanMemoryBlock &block = blocks.at(allocation.blockIndex);
+
+    // Insert range in offset order, then merge with neighbors
+    VulkanMemoryRange freed = {allocation.offset, allocation.size};
+    auto it = lower_bound(block.freeRanges.begin(), block.freeRanges.end(), freed,
+                            [](const VulkanMemoryRange &a, const VulkanMemoryRange &b) { return a.offset < b.offset; });
+    size_t index = it - block.freeRanges.begin();
+    block.freeRanges.insert(it, freed);
+
+    if(index + 1 < block.freeRanges.size()) {
+        VulkanMemoryRange &next = block.freeRanges[index + 1];
+        if(block.freeRanges[index].offset + block.freeRanges[index].size == next.offset) {
+            block.freeRanges[index].size += next.size;
+            block.freeRanges.erase(block.freeRanges.begin() + index + 1);
+        }
+    }
+    if(index > 0) {
+        VulkanMemoryRange &prev = block.freeRanges[index - 1];
+        if(prev.offset + prev.size == block.freeRanges[index].offset) {
+            prev.size += block.freeRanges[index].size;
+            block.freeRanges.erase(block.freeRanges.begin() + index);
+        }
+    }
+
+    block.usedBytes -= allocation.size;
+    block.allocationCnt--;
+
+    // Give empty blocks back to the driver, but keep one per memory type to avoid thrashing
+    if(block.allocationCnt == 0) {
+        int liveBlockCnt = 0;
+        for(auto &b : blocks) {
+            if(b.memory) liveBlockCnt++;
+        }
+        if(liveBlockCnt > 1) {
+            releaseVulkanMemoryBlock(allocator, block);
+        }
+    }
+
+    allocation = VulkanAllocation();
+}
+
+VulkanMemoryStats getVulkanMemoryStats(VulkanAllocator &allocator) {
+    VulkanMemoryStats stats;
+    for(auto &pool : allocator.pools) {
+        for(auto &block : pool.blocks) {
+            if(!block.memory) continue;
+            stats.deviceAllocationCnt++;
+            stats.allocationCnt += block.allocationCnt;
+            stats.reservedBytes += block.size;
+            stats.usedBytes += block.usedBytes;
+            stats.freeRangeCnt += (int)block.freeRanges.size();
+            for(auto &range : block.freeRanges) {
+                stats.largestFreeRange = max(stats.largestFreeRange, range.size);
+            }
+        }
+    }
+    return stats;
+}
+
+void printVulkanMemoryStats(VulkanAllocator &allocator) {
+    VulkanMemoryStats stats = getVulkanMemoryStats(allocator);
+    double mb = 1024.0*1024.0;
+    cout << "Vulkan memory: " << stats.allocationCnt << " allocations in ";
+    cout << stats.deviceAllocationCnt << " blocks (limit " << allocator.maxAllocationCnt << "), ";
+    cout << (stats.usedBytes / mb) << " / " << (stats.reservedBytes / mb) << " MB used, ";
+    cout << stats.freeRangeCnt << " free ranges (largest " << (stats.largestFreeRange / mb) << " MB)" << endl;
+}
+
+// Frees every block (all buffers using them must be destroyed first)
+void cleanupVulkanAllocator(VulkanAllocator &allocator) {
+    for(auto &pool : allocator.pools) {
+        for(auto &block : pool.blocks) {
+            if(!block.memory) continue;
+            if(block.allocationCnt > 0) {
+                cerr << "WARNING: Freeing Vulkan memory block with " << block.allocationCnt << " live allocations" << endl;
+            }
+            releaseVulkanMemoryBlock(allocator, block);
+        }
+        pool.blocks.clear();
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Vulkan uniforms and push constants
+///////////////////////////////////////////////////////////////////////////////
+
+vk::PushConstantRange getVulkanDrawConstantsRange() {
+    return vk::PushConstantRange(vk::ShaderStageFlagBits::eVertex, 0, sizeof(VulkanDrawConstants));
+}
+
+// Push model matrix (and its normal matrix) for the next draws
+void pushVulkanDrawConstants(vk::CommandBuffer &commandBuffer, vk::PipelineLayout &layout,
+                                const glm::mat4 &modelMat) {
+    VulkanDrawConstants constants;
+    constants.modelMat = modelMat;
+    constants.normalMat = glm::transpose(glm::inverse(modelMat));
+    commandBuffer.pushConstants(layout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(constants), &constants);
+}
+
+VulkanUniformRing createVulkanUniformRing(VulkanAllocator &allocator,
+                                            vk::DeviceSize bytesPerFrame,
+                                            const vector<vk::DeviceSize> &bindingSizes,
+                                            vk::ShaderStageFlags stages,
+                                            int framesInFlight) {
+    VulkanUniformRing ring;
+    ring.bindingSizes = bindingSizes;
+    ring.frameCnt = max(1, framesInFlight);
+    ring.alignment = max<vk::DeviceSize>(1,
+                        allocator.physicalDevice.getProperties().limits.minUniformBufferOffsetAlignment);
+    ring.frameSize = ((bytesPerFrame + ring.alignment - 1) / ring.alignment) * ring.alignment;
+
+    // Persistently mapped, so pushing data is just a memcpy
+    ring.buffer = createVulkanBuffer(
+        allocator, ring.frameSize * ring.frameCnt,
+        vk::BufferUsageFlagBits::eUniformBuffer,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+    ring.mapped = static_cast<unsigned char*>(ring.buffer.allocation.mapped);
+
+    // One dynamic uniform buffer per binding; the offset is supplied at bind time
+    vector<vk::DescriptorSetLayoutBinding> layoutBindings;
+    for(uint32_t i = 0; i < bindingSizes.size(); i++) {
+        layoutBindings.push_back(vk::DescriptorSetLayoutBinding(
+            i, vk::DescriptorType::eUniformBufferDynamic, 1, stages));
+    }
+    ring.setLayout = allocator.device.createDescriptorSetLayout(
+        vk::DescriptorSetLayoutCreateInfo({}, layoutBindings));
+
+    vk::DescriptorPoolSize poolSize(vk::DescriptorType::eUniformBufferDynamic,
+                                    static_cast<uint32_t>(bindingSizes.size()));
+    ring.descriptorPool = allocator.device.createDescriptorPool(
+        vk::DescriptorPoolCreateInfo({}, 1, poolSize));
+
+    // Only one set is ever needed, since it never changes
+    ring.descriptorSet = allocator.device.allocateDescriptorSets(
+        vk::DescriptorSetAllocateInfo(ring.descriptorPool, ring.setLayout)).front();
+
+    vector<vk::DescriptorBufferInfo> bufferInfos;
+    for(auto size : bindingSizes) {
+        bufferInfos.push_back(vk::DescriptorBufferInfo(ring.buffer.buffer, 0, size));
+    }
+    vector<vk::WriteDescriptorSet> writes;
+    for(uint32_t i = 0; i < bindingSizes.size(); i++) {
+        writes.push_back(vk::WriteDescriptorSet(ring.descriptorSet, i, 0, 1,
+                                                vk::DescriptorType::eUniformBufferDynamic,
+                                                nullptr, &bufferInfos[i]));
+    }
+    allocator.device.updateDescriptorSets(writes, {});
+
+    return ring;
+}
+
+// Start writing into this frame's region (its previous contents were consumed once the frame's fence signaled)
+void beginVulkanUniformFrame(VulkanUniformRing &ring, int frameIndex) {
+    if(frameIndex < 0 || frameIndex >= ring.frameCnt) {
+        throw std::runtime_error("Uniform ring has fewer frame regions than frames in flight!");
+    }
+    ring.frameStart = ring.frameSize * frameIndex;
+    ring.head = ring.frameStart;
+}
+
+// Copy data into the ring; returns the dynamic offset to bind it with
+uint32_t pushVulkanUniformData(VulkanUniformRing &ring, const void *data, vk::DeviceSize size) {
+    vk::DeviceSize offset = ((ring.head + ring.alignment - 1) / ring.alignment) * ring.alignment;
+    if(offset + size > ring.frameStart + ring.frameSize) {
+        throw std::runtime_error("Uniform ring buffer frame region is full!");
+    }
+    memcpy(ring.mapped + offset, data, size);
+    ring.head = offset + size;
+    return static_cast<uint32_t>(offset);
+}
+
+void bindVulkanUniformRing(vk::CommandBuffer &commandBuffer, vk::PipelineLayout &layout,
+                            VulkanUniformRing &ring, const vector<uint32_t> &dynamicOffsets) {
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout, 0,
+                                        ring.descriptorSet, dynamicOffsets);
+}
+
+void cleanupVulkanUniformRing(vk::Device &device, VulkanUniformRing &ring) {
+    device.destroyDescriptorPool(ring.descriptorPool);
+    device.destroyDescriptorSetLayout(ring.setLayout);
+    cleanupVulkanBuffer(device, ring.buffer);
+    ring.mapped = nullptr;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Vulkan parallel command recording
+///////////////////////////////////////////////////////////////////////////////
+
+VulkanParallelRecorder createVulkanParallelRecorder(vk::Device &device, QueueFamilyIndices &indices,
+                                                    int maxThreadCnt, int framesInFlight) {
+    VulkanParallelRecorder recorder;
+    recorder.partitions.resize(max(1, maxThreadCnt));
+
+    for(auto &partition : recorder.partitions) {
+        for(int i = 0; i < framesInFlight; i++) {
+            // Transient: buffers are re-recorded every frame
+            vk::CommandPool pool = device.createCommandPool(
+                vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eTransient,
+                                            indices.graphicsFamily.value()));
+            partition.commandPools.push_back(pool);
+            partition.secondaries.push_back(device.allocateCommandBuffers(
+                vk::CommandBufferAllocateInfo(pool, vk::CommandBufferLevel::eSecondary, 1)).front());
+        }
+    }
+
+    return recorder;
+}
+
+// Split draws across threadCnt secondary command buffers, record them in parallel,
+// then execute them from the primary (which must be inside a render pass begun
+// with vk::SubpassContents::eSecondaryCommandBuffers)
+void recordVulkanSecondaries(vk::Device &device, ThreadPool &threadPool, VulkanParallelRecorder &recorder,
+                                vk::CommandBuffer &primary, uint32_t frameIndex, int threadCnt,
+                                vk::RenderPass &renderPass, vk::Framebuffer &framebuffer,
+                                int drawCnt, VulkanRecordFunc recordDraws) {
+    threadCnt = max(1, min(threadCnt, (int)recorder.partitions.size()));
+
+    vk::CommandBufferInheritanceInfo inheritance(renderPass, 0, framebuffer);
+
+    auto recordPartition = [&](int t) {
+        VulkanRecordPartition &partition = recorder.partitions[t];
+
+        // This frame's fence has signaled, so the whole pool can be reset at once
+        device.resetCommandPool(partition.commandPools.at(frameIndex));
+
+        vk::CommandBuffer &commandBuffer = partition.secondaries.at(frameIndex);
+        commandBuffer.begin(vk::CommandBufferBeginInfo(
+            vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+            &inheritance));
+
+        int first = (int)((long long)drawCnt * t / threadCnt);
+        int last = (int)((long long)drawCnt * (t + 1) / threadCnt);
+        recordDraws(commandBuffer, first, last);
+
+        commandBuffer.end();
+    };
+
+    // No point going through the pool for a single partition
+    if(threadCnt == 1) {
+        recordPartition(0);
+    }
+    else {
+        parallelFor(threadPool, threadCnt, recordPartition);
+    }
+
+    vector<vk::CommandBuffer> secondaries;
+    for(int t = 0; t < threadCnt; t++) {
+        secondaries.push_back(recorder.partitions[t].secondaries.at(frameIndex));
+    }
+    primary.executeCommands(secondaries);
+}
+
+void cleanupVulkanParallelRecorder(vk::Device &device, VulkanParallelRecorder &recorder) {
+    // Destroying a pool frees its command buffers
+    for(auto &partition : recorder.partitions) {
+        for(auto &pool : partition.commandPools) {
+            device.destroyCommandPool(pool);
+        }
+    }
+    recorder.partitions.clear();
+}
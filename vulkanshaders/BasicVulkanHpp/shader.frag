@@ -1,9 +1,19 @@
 #version 450
 
 layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 fragPos;
+layout(location = 2) in vec3 fragNormal;
+
+layout(set = 0, binding = 1) uniform LightUBO {
+    vec4 pos;
+    vec4 color;
+} light;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = vec4(fragColor, 1.0);
+    vec3 N = normalize(fragNormal);
+    vec3 L = normalize(vec3(light.pos) - fragPos);
+    float diffuse = abs(dot(N, L));
+    outColor = vec4(fragColor * vec3(light.color) * (0.2 + 0.8*diffuse), 1.0);
 } 
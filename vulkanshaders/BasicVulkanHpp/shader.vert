@@ -1,11 +1,27 @@
 #version 450
 
 layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inColor;
+layout(location = 1) in vec4 inColor;
+layout(location = 2) in vec3 inNormal;
+
+layout(set = 0, binding = 0) uniform CameraUBO {
+    mat4 viewMat;
+    mat4 projMat;
+} camera;
+
+layout(push_constant) uniform DrawConstants {
+    mat4 modelMat;
+    mat4 normalMat;
+} draw;
 
 layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragPos;
+layout(location = 2) out vec3 fragNormal;
 
 void main() {
-    gl_Position = vec4(inPosition, 1.0);
-    fragColor = inColor;
+    vec4 viewPos = camera.viewMat * draw.modelMat * vec4(inPosition, 1.0);
+    gl_Position = camera.projMat * viewPos;
+    fragColor = vec3(inColor);
+    fragPos = vec3(viewPos);
+    fragNormal = mat3(camera.viewMat) * mat3(draw.normalMat) * inNormal;
 } 